@@ -0,0 +1,162 @@
+/* Бенчмарк AI на модели платы: скачок тока на канале 1 и время до 63% и 90% скачка в токе канала
+ * (aiData.current, по нему модуль CAN заполняет userData.dataCHxCHy), выборки в секунду по каналам
+ * и загрузка процессора для каждой настройки фильтров, принимаемой по CAN: filterAvgSize
+ * 2..SIZE_ARRAY_AVERAGE-1 при экспоненте по умолчанию и набор filterExpCurrent при среднем по умолчанию.
+ * Настройки фильтров задаются как мастером: через режим калибровки в ожидании команды.
+ * Отчет в JSON - в файл из первого аргумента или в stdout, для сравнения версий прошивки.
+ * Загрузка процессора на хосте - время хоста на миллисекунду модели, сравнима только на одной машине. */
+#include <stdio.h>
+
+#include "sim.h"
+#include "ai.c"
+
+/* Канал со скачком. */
+#define BENCH_CH							0
+/* Коды АЦП до и после скачка, остальные каналы - на середине диапазона. */
+#define BENCH_CODE_FROM						ADC_IDEAL_MA4
+#define BENCH_CODE_TO						ADC_IDEAL_MA20
+#define BENCH_CODE_OTHER					ADC_IDEAL_MA12
+/* Время на загрузку калибровки, смену настроек фильтров, их установление и запись отклика, мс. */
+#define BENCH_BOOT_MS						1000
+#define BENCH_MODE_MS						100
+#define BENCH_SETTLE_MS						3000
+#define BENCH_TRACE_MS						5000
+
+/* Значения filterExpCurrent в наборе. */
+const float benchExp[] = { 0.01f, 0.02f, 0.05f, 0.1f, 0.2f, 0.5f, 1.0f };
+
+/* Текущий код АЦП канала со скачком. */
+uint16_t benchCode = BENCH_CODE_FROM;
+
+/* Отклик канала по миллисекундам после скачка. */
+int32_t benchCurrent[BENCH_TRACE_MS];
+
+/**
+  * @brief  Источник АЦП: канал узнается по конфигу, отправленному в АЦП.
+  */
+uint16_t benchAdcSource( const uint8_t* config )
+{
+	return memcmp( config, aiData[BENCH_CH].config, 2 ) ? BENCH_CODE_OTHER : benchCode;
+}
+
+/**
+  * @brief  Время пересечения доли percent скачка от from к значению в конце записи.
+  * @retval время после скачка, мс, -1 - не пересек за BENCH_TRACE_MS.
+  */
+int32_t benchCrossing( const int32_t* trace, int32_t from, uint8_t percent )
+{
+	int32_t span = trace[BENCH_TRACE_MS - 1] - from;
+	int32_t sign = ( span > 0 ) ? 1 : -1;
+
+	if ( !span )
+	{
+		return -1;
+	}
+	for ( int32_t time = 0; time < BENCH_TRACE_MS; time++ )
+	{
+		if ( ( (int64_t)( trace[time] - from ) * sign * 100 ) >= ( (int64_t)span * sign * percent ) )
+		{
+			return time + 1;
+		}
+	}
+	return -1;
+}
+
+/**
+  * @brief  Вывод времени в JSON: null, если порог не пройден.
+  */
+void benchPrintTime( FILE* out, const char* name, int32_t time )
+{
+	if ( time < 0 )
+	{
+		fprintf( out, "\"%s\": null", name );
+	}
+	else
+	{
+		fprintf( out, "\"%s\": %d", name, time );
+	}
+}
+
+/**
+  * @brief  Прогон одной настройки фильтров: загрузка, настройка, установление, скачок и запись отклика.
+  * @param  avgSize:	filterAvgSize по CAN.
+  * @param  exp:		filterExpCurrent по CAN.
+  */
+void benchRun( FILE* out, uint8_t avgSize, float exp, uint8_t isFirst )
+{
+	int32_t currentFrom;
+	AiBenchStat stat;
+
+	simFlashClear();
+	simBoot();
+	simAdcSetSource( benchAdcSource );
+	benchCode = BENCH_CODE_FROM;
+	simMain( BENCH_BOOT_MS * 1000 );
+	/* Фильтры всех каналов (канал калибровки не выбран) настраиваются в ожидании команды калибровки */
+	userData.aiMode = AI_CALIBRATION;
+	userData.calibrationMode = CALIBRATION_WAIT;
+	userData.calibrationCh = CALIBRATION_NO_CHANNEL;
+	userData.filterAvgSize = avgSize;
+	userData.filterExpCurrent = exp;
+	simMain( BENCH_MODE_MS * 1000 );
+	userData.aiMode = AI_WORKING;
+	simMain( BENCH_SETTLE_MS * 1000 );
+
+	currentFrom = aiData[BENCH_CH].current;
+	benchCode = BENCH_CODE_TO;
+	for ( uint32_t time = 0; time < BENCH_TRACE_MS; time++ )
+	{
+		simMain( 1000 );
+		benchCurrent[time] = aiData[BENCH_CH].current;
+	}
+
+	fprintf( out, "%s\n    { \"filter_avg_size\": %u, \"filter_avg_applied\": %u, \"filter_exp\": %g, ",
+			isFirst ? "" : ",", avgSize, aiData[BENCH_CH].filterAvgSize, exp );
+	benchPrintTime( out, "current_latency63_ms", benchCrossing( benchCurrent, currentFrom, 63 ) );
+	fprintf( out, ", " );
+	benchPrintTime( out, "current_latency90_ms", benchCrossing( benchCurrent, currentFrom, 90 ) );
+	aiGetBenchStat( BENCH_CH, &stat );
+	fprintf( out, ", \"fw_latency63_ms\": %u, \"fw_latency90_ms\": %u, \"samples_per_sec\": [",
+			stat.latency63, stat.latency90 );
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		aiGetBenchStat( ch, &stat );
+		fprintf( out, "%s%u", ch ? ", " : "", stat.sampleRate );
+	}
+	fprintf( out, "], \"host_load_permille\": %u }", schedGetLoad() );
+}
+
+int main( int argc, char** argv )
+{
+	FILE* out = stdout;
+	uint8_t isFirst = 1;
+
+	if ( argc > 1 )
+	{
+		out = fopen( argv[1], "w" );
+		if ( !out )
+		{
+			perror( argv[1] );
+			return 1;
+		}
+	}
+
+	fprintf( out, "{\n  \"channel\": %u, \"code_from\": %u, \"code_to\": %u, \"sim_step_us\": %u,\n  \"runs\": [",
+			BENCH_CH + 1, BENCH_CODE_FROM, BENCH_CODE_TO, SIM_STEP_US );
+	for ( uint16_t avgSize = 2; avgSize < SIZE_ARRAY_AVERAGE; avgSize++ )
+	{
+		benchRun( out, avgSize, DEFAULT_FILTER_EXP, isFirst );
+		isFirst = 0;
+	}
+	for ( uint8_t i = 0; i < ( sizeof(benchExp) / sizeof(benchExp[0]) ); i++ )
+	{
+		benchRun( out, DEFAULT_FILTER_AVERAGE_SIZE, benchExp[i], 0 );
+	}
+	fprintf( out, "\n  ]\n}\n" );
+
+	if ( out != stdout )
+	{
+		fclose( out );
+	}
+	return 0;
+}
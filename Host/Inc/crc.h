@@ -0,0 +1,19 @@
+/* Подмена crc.h CubeMX: блок CRC STM32 (CRC-32, полином 0x04C11DB7, 32-битные слова без отражения,
+ * начальное значение 0xFFFFFFFF). Реализация - Host/Src/simcrc.c. */
+#ifndef __CRC_H__
+#define __CRC_H__
+
+#include "main.h"
+
+typedef struct
+{
+	/* Текущее значение регистра данных. */
+	uint32_t DR;
+} CRC_HandleTypeDef;
+
+extern CRC_HandleTypeDef hcrc;
+
+uint32_t HAL_CRC_Calculate( CRC_HandleTypeDef* hcrc, uint32_t* pBuffer, uint32_t BufferLength );
+uint32_t HAL_CRC_Accumulate( CRC_HandleTypeDef* hcrc, uint32_t* pBuffer, uint32_t BufferLength );
+
+#endif /* __CRC_H__ */
@@ -0,0 +1,22 @@
+/* Подмена драйвера SPI-флешки проекта. Модель флешки в ОЗУ - Host/Src/simflash.c. */
+#ifndef INC_FLASH_H_
+#define INC_FLASH_H_
+
+#include <stdint.h>
+
+/* Состояние флешки. */
+enum
+{
+	FLASH_BUSY		= 0,	// Идет операция
+	FLASH_FREE_R	= 1,	// Свободна, запись запрещена
+	FLASH_FREE_RW	= 2,	// Свободна, запись разрешена (до окончания следующей записи или очистки)
+};
+
+uint8_t flashGetStatus( void );
+void flashSetWriteMode( void );
+void flashReadData( uint32_t address, uint16_t size );
+void flashGetReadedData( uint8_t* buff );
+void flashWriteData( uint32_t address, uint8_t* data, uint16_t size );
+void flashEraseSector( uint32_t address );
+
+#endif /* INC_FLASH_H_ */
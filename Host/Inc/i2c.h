@@ -0,0 +1,28 @@
+/* Подмена i2c.h CubeMX: I2C1 - расширитель портов XL9535. Модель - Host/Src/simi2c.c. */
+#ifndef __I2C_H__
+#define __I2C_H__
+
+#include "main.h"
+
+typedef enum
+{
+	HAL_I2C_STATE_RESET		= 0x00U,
+	HAL_I2C_STATE_READY		= 0x20U,
+	HAL_I2C_STATE_BUSY_TX	= 0x21U,
+} HAL_I2C_StateTypeDef;
+
+typedef struct
+{
+	volatile HAL_I2C_StateTypeDef State;
+} I2C_HandleTypeDef;
+
+extern I2C_HandleTypeDef hi2c1;
+
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady( I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint32_t Trials, uint32_t Timeout );
+HAL_StatusTypeDef HAL_I2C_Master_Transmit( I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout );
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA( I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size );
+HAL_I2C_StateTypeDef HAL_I2C_GetState( I2C_HandleTypeDef* hi2c );
+void HAL_I2C_MasterTxCpltCallback( I2C_HandleTypeDef* hi2c );
+void HAL_I2C_ErrorCallback( I2C_HandleTypeDef* hi2c );
+
+#endif /* __I2C_H__ */
@@ -0,0 +1,90 @@
+/* Подмена main.h CubeMX для сборки модулей User на хосте: типы и функции HAL, которые используют
+ * модули, и пины платы. Поведение периферии моделируется в Host/Src, управление моделью - sim.h. */
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum
+{
+	HAL_OK			= 0x00U,
+	HAL_ERROR		= 0x01U,
+	HAL_BUSY		= 0x02U,
+	HAL_TIMEOUT		= 0x03U,
+} HAL_StatusTypeDef;
+
+/* ________________________ GPIO ________________________ */
+/* Порт: только выходной регистр. */
+typedef struct
+{
+	volatile uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef enum
+{
+	GPIO_PIN_RESET	= 0,
+	GPIO_PIN_SET	= 1,
+} GPIO_PinState;
+
+extern GPIO_TypeDef simGpioA;
+extern GPIO_TypeDef simGpioB;
+
+#define GPIOA								( &simGpioA )
+#define GPIOB								( &simGpioB )
+
+#define GPIO_PIN_0							( (uint16_t)0x0001 )
+#define GPIO_PIN_1							( (uint16_t)0x0002 )
+#define GPIO_PIN_2							( (uint16_t)0x0004 )
+#define GPIO_PIN_4							( (uint16_t)0x0010 )
+#define GPIO_PIN_8							( (uint16_t)0x0100 )
+
+/* Пины платы. */
+#define LED_STATUS_Pin						GPIO_PIN_0
+#define LED_STATUS_GPIO_Port				GPIOA
+#define LED_RUN_Pin							GPIO_PIN_1
+#define LED_RUN_GPIO_Port					GPIOA
+#define LED_ALARM_Pin						GPIO_PIN_2
+#define LED_ALARM_GPIO_Port					GPIOA
+#define ADC_CS_Pin							GPIO_PIN_4
+#define ADC_CS_GPIO_Port					GPIOA
+#define UART_RTS_Pin						GPIO_PIN_8
+#define UART_RTS_GPIO_Port					GPIOA
+#define MUX_0_Pin							GPIO_PIN_0
+#define MUX_0_GPIO_Port						GPIOB
+#define MUX_1_Pin							GPIO_PIN_1
+#define MUX_1_GPIO_Port						GPIOB
+#define MUX_2_Pin							GPIO_PIN_2
+#define MUX_2_GPIO_Port						GPIOB
+
+void HAL_GPIO_WritePin( GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState );
+
+/* ________________________ DMA ________________________ */
+typedef struct
+{
+	/* Кол-во оставшихся передач. */
+	volatile uint32_t NDTR;
+} DMA_Stream_TypeDef;
+
+typedef struct
+{
+	uint32_t Mode;
+} DMA_InitTypeDef;
+
+typedef struct
+{
+	DMA_Stream_TypeDef* Instance;
+	DMA_InitTypeDef Init;
+} DMA_HandleTypeDef;
+
+#define DMA_NORMAL							0x00000000U
+#define DMA_CIRCULAR						0x00000100U
+
+#define __HAL_DMA_GET_COUNTER( __HANDLE__ )	( ( __HANDLE__ )->Instance->NDTR )
+
+HAL_StatusTypeDef HAL_DMA_Init( DMA_HandleTypeDef* hdma );
+
+/* ________________________ SYSTEM ________________________ */
+uint32_t HAL_GetTick( void );
+
+#endif /* __MAIN_H */
@@ -0,0 +1,49 @@
+/* Подмена данных обмена модуля с мастером CAN (объектный словарь): поля, которые используют модули User. */
+#ifndef INC_MODULEDATA_H_
+#define INC_MODULEDATA_H_
+
+#include <stdint.h>
+
+#include "setting.h"
+
+/* Размер буфера кадра HART в словах. */
+#define MODULEDATA_HART_WORDS				( ( SIZE_HART_BUFF + 3 ) / 4 )
+
+typedef struct UserData
+{
+	uint8_t aiMode;
+	uint8_t calibrationMode;
+	uint8_t calibrationCh;
+	uint16_t calibrationMa;
+	uint8_t filterAvgSize;
+	float filterExpCurrent;
+
+	uint16_t dataCH1CH2[4];
+	uint16_t dataCH3CH4[4];
+	uint16_t dataCH5CH6[4];
+
+	uint8_t hartFlagTxEn[AI_CH_NUM];
+	uint8_t hartFlagRxEn[AI_CH_NUM];
+	uint8_t hartFlagTxCompleted[AI_CH_NUM];
+	uint8_t hartFlagRxCompleted[AI_CH_NUM];
+
+	uint32_t rxBuffCH1[MODULEDATA_HART_WORDS];
+	uint32_t rxBuffCH2[MODULEDATA_HART_WORDS];
+	uint32_t rxBuffCH3[MODULEDATA_HART_WORDS];
+	uint32_t rxBuffCH4[MODULEDATA_HART_WORDS];
+	uint32_t rxBuffCH5[MODULEDATA_HART_WORDS];
+	uint32_t rxBuffCH6[MODULEDATA_HART_WORDS];
+	uint32_t txBuffCH1[MODULEDATA_HART_WORDS];
+	uint32_t txBuffCH2[MODULEDATA_HART_WORDS];
+	uint32_t txBuffCH3[MODULEDATA_HART_WORDS];
+	uint32_t txBuffCH4[MODULEDATA_HART_WORDS];
+	uint32_t txBuffCH5[MODULEDATA_HART_WORDS];
+	uint32_t txBuffCH6[MODULEDATA_HART_WORDS];
+
+	uint16_t sizeRxBuffer[AI_CH_NUM];
+	uint16_t sizeTxBuffer[AI_CH_NUM];
+} UserData;
+
+extern UserData userData;
+
+#endif /* INC_MODULEDATA_H_ */
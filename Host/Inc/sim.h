@@ -0,0 +1,121 @@
+/* Модель платы для сборки модулей User на хосте: время, периферия HAL, флешка, HART-устройства.
+ * Прерывания вызываются из simRun в том же потоке, между шагами модели код модулей не прерывается. */
+#ifndef INC_SIM_H_
+#define INC_SIM_H_
+
+#include <stdint.h>
+
+/* ________________________ TIME ________________________ */
+/* Шаг модели, мкс. */
+#define SIM_STEP_US							50
+/* Период тика таймаутов HART (TIM5), мкс. */
+#define SIM_TIM5_PERIOD_US					10000
+/* Период тика сканирования АЦП (TIM2), мкс. */
+#define SIM_TIM2_PERIOD_US					100
+
+/* Сброс модели: время, выходы, периферия и счетчики. Модели флешки и устройств HART не сбрасываются. */
+void simReset( void );
+/* Продвижение модели на us мкс: таймеры, обмены, флешка. */
+void simRun( uint32_t us );
+/* Запуск прошивки как в main.c: сброс модели, инициализация модулей и планировщика, запуск TIM2. */
+void simBoot( void );
+/* Главный цикл прошивки на us мкс: проход планировщика на каждом шаге модели. */
+void simMain( uint32_t us );
+/* Время модели, мкс. */
+uint64_t simGetTimeUs( void );
+/* Установка времени HAL_GetTick (для проверки переполнения счетчика), мс. */
+void simSetTick( uint32_t tick );
+/* Кол-во отправленных PDO4. */
+uint32_t simGetPdoCount( void );
+
+/* ________________________ ADC ________________________ */
+/* Источник кода АЦП по конфигу канала (два байта, отправленные в АЦП). */
+typedef uint16_t ( *SimAdcSource )( const uint8_t* config );
+
+/* Источник выборок АЦП, 0 - всегда код 0. Выборка конфига приходит через AI_ADC_PIPELINE_DEPTH обменов. */
+void simAdcSetSource( SimAdcSource source );
+/* Следующие count запусков обмена с АЦП возвращают HAL_BUSY без завершения. */
+void simAdcSetBusy( uint32_t count );
+
+/* ________________________ I2C ________________________ */
+/* Кол-во передач DMA на расширитель. */
+uint32_t simI2cGetTxCount( void );
+/* Выходные регистры расширителя (порт 0, порт 1), как их записал модуль. */
+const uint8_t* simI2cGetOutput( void );
+/* Ответ расширителя: 1 - NACK на следующие передачи, 0 - ACK. */
+void simI2cSetNack( uint8_t isNack );
+
+/* ________________________ FLASH ________________________ */
+/* Размер модели флешки, байт. */
+#define SIM_FLASH_SIZE						0x10000
+/* Размер сектора модели флешки, байт. */
+#define SIM_FLASH_SECTOR_SIZE				4096
+/* Время операций модели флешки, мкс. */
+#define SIM_FLASH_READ_US					200
+#define SIM_FLASH_WRITE_US					700
+#define SIM_FLASH_ERASE_US					45000
+
+/* Очистка всей флешки в 0xFF, питание включено. */
+void simFlashClear( void );
+/* Память флешки (для снимков и порчи данных в тестах). */
+uint8_t* simFlashMemory( void );
+/* Пропадание питания: незавершенная операция выполняется только на первые done байт,
+ * до simFlashPowerOn флешка занята и команды не выполняет. */
+void simFlashPowerCut( uint16_t done );
+void simFlashPowerOn( void );
+/* Сбой следующей записи страницы: байт offset страницы остается незаписанным (флешка об этом не сообщает). */
+void simFlashWriteFault( uint16_t offset );
+/* Кол-во запущенных операций записи и очистки. */
+uint32_t simFlashGetWriteCount( void );
+uint32_t simFlashGetEraseCount( void );
+
+/* ________________________ HART ________________________ */
+/* Время передачи байта по линии HART (1200 бод, 11 бит), мкс. */
+#define SIM_UART_BYTE_US					9167
+/* Кол-во байт преамбулы ответа устройства. */
+#define SIM_HART_PREAMBLE					5
+/* Номер канала, не выбранного мультиплексором. */
+#define SIM_HART_NO_CHANNEL					0xFF
+
+/* HART-устройство на канале. */
+typedef struct SimHartDevice
+{
+	/* Флаг, что устройство подключено. */
+	uint8_t isPresent;
+	/* Длинный адрес: код производителя (младшие 6 бит), тип и ID устройства. */
+	uint8_t address[5];
+	/* Второй байт статуса в ответах. */
+	uint8_t status;
+	/* Кол-во байт данных ответа на команды, кроме 0. */
+	uint8_t dataSize;
+	/* Время от конца запроса до начала ответа, мкс. */
+	uint32_t latencyUs;
+	/* Кол-во следующих запросов, на которые устройство не отвечает. */
+	uint32_t silentCnt;
+} SimHartDevice;
+
+void simHartSetDevice( uint8_t channel, const SimHartDevice* device );
+SimHartDevice* simHartGetDevice( uint8_t channel );
+/* Канал, выбранный мультиплексором (куда ушел запрос и откуда принимается ответ), SIM_HART_NO_CHANNEL - передача. */
+uint8_t simHartChannel( void );
+/* Кол-во запросов, на которые ответило устройство канала. */
+uint32_t simHartGetAnswerCount( uint8_t channel );
+/* Кол-во байт, переданных модулем в линию. */
+uint32_t simUartGetTxBytes( void );
+/* Смещение записи в кольце приема (для подгонки конца кадра к концу кольца). */
+uint16_t simUartGetRingHead( void );
+/* Ошибка UART с остановкой приема (как переполнение): вызывается HAL_UART_ErrorCallback. */
+void simUartError( void );
+
+/* ________________________ STEP ________________________ */
+/* Шаги моделей периферии и их сброс, вызываются из simRun и simReset. */
+void simTimStep( uint32_t us );
+void simUartStep( uint32_t us );
+void simI2cStep( uint32_t us );
+void simFlashStep( uint32_t us );
+void simTimReset( void );
+void simSpiReset( void );
+void simUartReset( void );
+void simI2cReset( void );
+
+#endif /* INC_SIM_H_ */
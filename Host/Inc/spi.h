@@ -0,0 +1,22 @@
+/* Подмена spi.h CubeMX: SPI1 - АЦП, SPI2 - флешка. Модель АЦП - Host/Src/simspi.c. */
+#ifndef __SPI_H__
+#define __SPI_H__
+
+#include "main.h"
+
+typedef struct
+{
+	/* Кол-во запущенных обменов. */
+	uint32_t transferCnt;
+} SPI_HandleTypeDef;
+
+extern SPI_HandleTypeDef hspi1;
+extern SPI_HandleTypeDef hspi2;
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA( SPI_HandleTypeDef* hspi, uint8_t* pTxData, uint8_t* pRxData, uint16_t Size );
+HAL_StatusTypeDef HAL_SPI_Abort( SPI_HandleTypeDef* hspi );
+void HAL_SPI_TxRxCpltCallback( SPI_HandleTypeDef* hspi );
+void HAL_SPI_TxCpltCallback( SPI_HandleTypeDef* hspi );
+void HAL_SPI_RxCpltCallback( SPI_HandleTypeDef* hspi );
+
+#endif /* __SPI_H__ */
@@ -0,0 +1,24 @@
+/* Подмена tim.h CubeMX: TIM5 - тик таймаутов HART, TIM2 - тик сканирования АЦП. Модель - Host/Src/simtim.c. */
+#ifndef __TIM_H__
+#define __TIM_H__
+
+#include "main.h"
+
+typedef struct
+{
+	/* Период, мкс. */
+	uint32_t period;
+	/* Флаг, что таймер запущен. */
+	uint8_t isRunning;
+	/* Время до следующего переполнения, мкс. */
+	uint32_t remain;
+} TIM_HandleTypeDef;
+
+extern TIM_HandleTypeDef htim2;
+extern TIM_HandleTypeDef htim5;
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT( TIM_HandleTypeDef* htim );
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT( TIM_HandleTypeDef* htim );
+void HAL_TIM_PeriodElapsedCallback( TIM_HandleTypeDef* htim );
+
+#endif /* __TIM_H__ */
@@ -0,0 +1,34 @@
+/* Подмена usart.h CubeMX: USART1 - HART-модем. Модель модема и устройств - Host/Src/simuart.c. */
+#ifndef __USART_H__
+#define __USART_H__
+
+#include "main.h"
+
+#define HAL_UART_STATE_READY				0x20U
+#define HAL_UART_STATE_BUSY_TX				0x21U
+#define HAL_UART_STATE_BUSY_RX				0x22U
+
+/* Событие приема по кольцу. */
+typedef uint32_t HAL_UART_RxEventTypeTypeDef;
+#define HAL_UART_RXEVENT_TC					0x00U
+#define HAL_UART_RXEVENT_HT					0x01U
+#define HAL_UART_RXEVENT_IDLE				0x02U
+
+typedef struct
+{
+	DMA_HandleTypeDef* hdmarx;
+	volatile uint32_t gState;
+	volatile uint32_t RxState;
+	volatile HAL_UART_RxEventTypeTypeDef RxEventType;
+} UART_HandleTypeDef;
+
+extern UART_HandleTypeDef huart1;
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT( UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size );
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA( UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size );
+HAL_UART_RxEventTypeTypeDef HAL_UARTEx_GetRxEventType( UART_HandleTypeDef* huart );
+void HAL_UART_TxCpltCallback( UART_HandleTypeDef* huart );
+void HAL_UART_ErrorCallback( UART_HandleTypeDef* huart );
+void HAL_UARTEx_RxEventCallback( UART_HandleTypeDef* huart, uint16_t Size );
+
+#endif /* __USART_H__ */
@@ -0,0 +1,7 @@
+/* Подмена CAN-модуля проекта: PDO4 только подсчитываются (Host/Src/simmain.c). */
+#ifndef INC_USERCAN_H_
+#define INC_USERCAN_H_
+
+void usercanSendPDO4( void );
+
+#endif /* INC_USERCAN_H_ */
@@ -0,0 +1,24 @@
+#include "crc.h"
+
+/* Блок CRC STM32: CRC-32 MPEG-2 по 32-битным словам, старшим битом вперед. */
+
+CRC_HandleTypeDef hcrc = {};
+
+uint32_t HAL_CRC_Accumulate( CRC_HandleTypeDef* hcrc, uint32_t* pBuffer, uint32_t BufferLength )
+{
+	for ( uint32_t i = 0; i < BufferLength; i++ )
+	{
+		hcrc->DR ^= pBuffer[i];
+		for ( uint8_t bit = 0; bit < 32; bit++ )
+		{
+			hcrc->DR = ( hcrc->DR & 0x80000000 ) ? ( ( hcrc->DR << 1 ) ^ 0x04C11DB7 ) : ( hcrc->DR << 1 );
+		}
+	}
+	return hcrc->DR;
+}
+
+uint32_t HAL_CRC_Calculate( CRC_HandleTypeDef* hcrc, uint32_t* pBuffer, uint32_t BufferLength )
+{
+	hcrc->DR = 0xFFFFFFFF;
+	return HAL_CRC_Accumulate( hcrc, pBuffer, BufferLength );
+}
@@ -0,0 +1,205 @@
+#include "sim.h"
+
+#include "flash.h"
+#include "string.h"
+
+/* Модель SPI NOR-флешки в ОЗУ: запись только сбрасывает биты, очистка сектора ставит 0xFF,
+ * запись и очистка выполняются только после разрешения записи и снимают его. */
+
+/* Операция флешки. */
+typedef enum
+{
+	SIM_FLASH_NONE		= 0,	// Нет операции
+	SIM_FLASH_READ		= 1,	// Чтение
+	SIM_FLASH_WRITE		= 2,	// Запись страницы
+	SIM_FLASH_ERASE		= 3,	// Очистка сектора
+} SIM_FLASH_OPERATION;
+
+typedef struct SimFlash
+{
+	/* Память. */
+	uint8_t memory[SIM_FLASH_SIZE];
+	/* Данные операции: записываемые или прочитанные. */
+	uint8_t buff[SIM_FLASH_SECTOR_SIZE];
+	/* Текущая операция SIM_FLASH_OPERATION. */
+	uint8_t operation;
+	/* Адрес и размер текущей (последней) операции. */
+	uint32_t address;
+	uint16_t size;
+	/* Время до завершения операции, мкс. */
+	uint32_t remain;
+	/* Флаг разрешения записи. */
+	uint8_t isWriteEnabled;
+	/* Флаг, что питание пропало. */
+	uint8_t isPowerOff;
+	/* Флаг сбоя следующей записи и байт страницы, который при ней не записывается. */
+	uint8_t isWriteFault;
+	uint16_t faultOffset;
+	/* Кол-во запущенных операций записи и очистки. */
+	uint32_t writeCnt;
+	uint32_t eraseCnt;
+} SimFlash;
+
+SimFlash simFlash = {};
+
+/* ________________________ FUNCTION'S PROTOTYPE ________________________ */
+uint8_t simFlashStart( uint8_t operation, uint32_t address, uint16_t size, uint32_t time );
+void simFlashApply( uint16_t done );
+
+/**
+  * @brief  Запуск операции флешки.
+  * @retval 1 - операция запущена, 0 - флешка занята или адрес вне памяти.
+  */
+uint8_t simFlashStart( uint8_t operation, uint32_t address, uint16_t size, uint32_t time )
+{
+	if ( ( flashGetStatus() == FLASH_BUSY ) || ( size > SIM_FLASH_SECTOR_SIZE ) || ( ( address + size ) > SIM_FLASH_SIZE ) )
+	{
+		return 0;
+	}
+	simFlash.operation = operation;
+	simFlash.address = address;
+	simFlash.size = size;
+	simFlash.remain = time;
+	return 1;
+}
+
+/**
+  * @brief  Выполнение текущей операции на первые done байт.
+  */
+void simFlashApply( uint16_t done )
+{
+	if ( done > simFlash.size )
+	{
+		done = simFlash.size;
+	}
+	switch ( simFlash.operation )
+	{
+		case SIM_FLASH_READ:
+			memcpy( simFlash.buff, &simFlash.memory[simFlash.address], done );
+			break;
+		case SIM_FLASH_WRITE:
+			for ( uint16_t i = 0; i < done; i++ )
+			{
+				if ( !simFlash.isWriteFault || ( i != simFlash.faultOffset ) )
+				{
+					simFlash.memory[simFlash.address + i] &= simFlash.buff[i];
+				}
+			}
+			simFlash.isWriteFault = 0;
+			simFlash.isWriteEnabled = 0;
+			break;
+		case SIM_FLASH_ERASE:
+			memset( &simFlash.memory[simFlash.address], 0xFF, done );
+			simFlash.isWriteEnabled = 0;
+			break;
+	}
+	simFlash.operation = SIM_FLASH_NONE;
+}
+
+uint8_t flashGetStatus( void )
+{
+	if ( simFlash.isPowerOff || ( simFlash.operation != SIM_FLASH_NONE ) )
+	{
+		return FLASH_BUSY;
+	}
+	return simFlash.isWriteEnabled ? FLASH_FREE_RW : FLASH_FREE_R;
+}
+
+void flashSetWriteMode( void )
+{
+	if ( flashGetStatus() != FLASH_BUSY )
+	{
+		simFlash.isWriteEnabled = 1;
+	}
+}
+
+void flashReadData( uint32_t address, uint16_t size )
+{
+	simFlashStart( SIM_FLASH_READ, address, size, SIM_FLASH_READ_US );
+}
+
+void flashGetReadedData( uint8_t* buff )
+{
+	memcpy( buff, simFlash.buff, simFlash.size );
+}
+
+void flashWriteData( uint32_t address, uint8_t* data, uint16_t size )
+{
+	if ( !simFlash.isWriteEnabled || !simFlashStart( SIM_FLASH_WRITE, address, size, SIM_FLASH_WRITE_US ) )
+	{
+		return;
+	}
+	memcpy( simFlash.buff, data, size );
+	simFlash.writeCnt++;
+}
+
+void flashEraseSector( uint32_t address )
+{
+	address -= address % SIM_FLASH_SECTOR_SIZE;
+	if ( !simFlash.isWriteEnabled || !simFlashStart( SIM_FLASH_ERASE, address, SIM_FLASH_SECTOR_SIZE, SIM_FLASH_ERASE_US ) )
+	{
+		return;
+	}
+	simFlash.eraseCnt++;
+}
+
+void simFlashStep( uint32_t us )
+{
+	if ( simFlash.isPowerOff || ( simFlash.operation == SIM_FLASH_NONE ) )
+	{
+		return;
+	}
+	if ( simFlash.remain > us )
+	{
+		simFlash.remain -= us;
+		return;
+	}
+	simFlashApply( simFlash.size );
+}
+
+void simFlashClear( void )
+{
+	memset( simFlash.memory, 0xFF, sizeof(simFlash.memory) );
+	simFlash.operation = SIM_FLASH_NONE;
+	simFlash.isWriteEnabled = 0;
+	simFlash.isPowerOff = 0;
+	simFlash.isWriteFault = 0;
+	simFlash.writeCnt = 0;
+	simFlash.eraseCnt = 0;
+}
+
+uint8_t* simFlashMemory( void )
+{
+	return simFlash.memory;
+}
+
+void simFlashPowerCut( uint16_t done )
+{
+	if ( simFlash.operation != SIM_FLASH_NONE )
+	{
+		simFlashApply( done );
+	}
+	simFlash.isWriteEnabled = 0;
+	simFlash.isPowerOff = 1;
+}
+
+void simFlashPowerOn( void )
+{
+	simFlash.isPowerOff = 0;
+}
+
+void simFlashWriteFault( uint16_t offset )
+{
+	simFlash.isWriteFault = 1;
+	simFlash.faultOffset = offset;
+}
+
+uint32_t simFlashGetWriteCount( void )
+{
+	return simFlash.writeCnt;
+}
+
+uint32_t simFlashGetEraseCount( void )
+{
+	return simFlash.eraseCnt;
+}
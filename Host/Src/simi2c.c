@@ -0,0 +1,133 @@
+#include "sim.h"
+
+#include "i2c.h"
+#include "setting.h"
+#include "string.h"
+
+/* Модель I2C1 с расширителем XL9535: первый байт передачи - номер регистра, дальше запись
+ * с автоинкрементом. Регистры 2, 3 - выходные порты. */
+
+/* Время передачи байта по I2C (400 кГц, 9 бит), мкс. */
+#define SIM_I2C_BYTE_US						23
+/* Кол-во регистров расширителя. */
+#define SIM_I2C_REG_NUM						8
+/* Первый выходной регистр. */
+#define SIM_I2C_REG_OUTPUT					2
+
+I2C_HandleTypeDef hi2c1 = {};
+
+typedef struct SimI2c
+{
+	/* Регистры расширителя. */
+	uint8_t reg[SIM_I2C_REG_NUM];
+	/* Данные передачи DMA. */
+	uint8_t buff[SIM_I2C_REG_NUM + 1];
+	uint16_t size;
+	/* Время до завершения передачи DMA, мкс. */
+	uint32_t remain;
+	/* Флаг ответа NACK. */
+	uint8_t isNack;
+	/* Кол-во передач DMA. */
+	uint32_t txCnt;
+} SimI2c;
+
+SimI2c simI2c = {};
+
+/* ________________________ FUNCTION'S PROTOTYPE ________________________ */
+void simI2cWrite( const uint8_t* data, uint16_t size );
+
+/**
+  * @brief  Запись в регистры расширителя.
+  */
+void simI2cWrite( const uint8_t* data, uint16_t size )
+{
+	for ( uint16_t i = 1; i < size; i++ )
+	{
+		simI2c.reg[( data[0] + i - 1 ) % SIM_I2C_REG_NUM] = data[i];
+	}
+}
+
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady( I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint32_t Trials, uint32_t Timeout )
+{
+	return ( ( DevAddress == XL9535_I2C_ADDRESS ) && !simI2c.isNack ) ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit( I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout )
+{
+	if ( hi2c->State != HAL_I2C_STATE_READY )
+	{
+		return HAL_BUSY;
+	}
+	if ( ( DevAddress != XL9535_I2C_ADDRESS ) || simI2c.isNack )
+	{
+		return HAL_ERROR;
+	}
+	simI2cWrite( pData, Size );
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA( I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size )
+{
+	if ( hi2c->State != HAL_I2C_STATE_READY )
+	{
+		return HAL_BUSY;
+	}
+	if ( ( DevAddress != XL9535_I2C_ADDRESS ) || ( Size > sizeof(simI2c.buff) ) )
+	{
+		return HAL_ERROR;
+	}
+	memcpy( simI2c.buff, pData, Size );
+	simI2c.size = Size;
+	/* Адрес и данные. */
+	simI2c.remain = ( Size + 1 ) * SIM_I2C_BYTE_US;
+	simI2c.txCnt++;
+	hi2c->State = HAL_I2C_STATE_BUSY_TX;
+	return HAL_OK;
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState( I2C_HandleTypeDef* hi2c )
+{
+	return hi2c->State;
+}
+
+void simI2cStep( uint32_t us )
+{
+	if ( hi2c1.State != HAL_I2C_STATE_BUSY_TX )
+	{
+		return;
+	}
+	if ( simI2c.remain > us )
+	{
+		simI2c.remain -= us;
+		return;
+	}
+	hi2c1.State = HAL_I2C_STATE_READY;
+	if ( simI2c.isNack )
+	{
+		HAL_I2C_ErrorCallback( &hi2c1 );
+		return;
+	}
+	simI2cWrite( simI2c.buff, simI2c.size );
+	HAL_I2C_MasterTxCpltCallback( &hi2c1 );
+}
+
+void simI2cReset( void )
+{
+	memset( &simI2c, 0, sizeof(simI2c) );
+	hi2c1.State = HAL_I2C_STATE_READY;
+}
+
+uint32_t simI2cGetTxCount( void )
+{
+	return simI2c.txCnt;
+}
+
+const uint8_t* simI2cGetOutput( void )
+{
+	return &simI2c.reg[SIM_I2C_REG_OUTPUT];
+}
+
+void simI2cSetNack( uint8_t isNack )
+{
+	simI2c.isNack = isNack;
+}
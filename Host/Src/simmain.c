@@ -0,0 +1,126 @@
+#include "sim.h"
+
+#include "main.h"
+#include "tim.h"
+#include "moduledata.h"
+#include "usercan.h"
+#include "string.h"
+
+#include "ai.h"
+#include "hart.h"
+#include "led.h"
+#include "sched.h"
+
+/* Роль main.c прошивки: время HAL, выходы GPIO, прерывания таймеров, объектный словарь. */
+
+GPIO_TypeDef simGpioA = {};
+GPIO_TypeDef simGpioB = {};
+
+UserData userData = {};
+
+/* Время модели, мкс. */
+uint64_t simTimeUs = 0;
+/* Смещение HAL_GetTick относительно времени модели, мс. */
+uint32_t simTickOffset = 0;
+/* Кол-во отправленных PDO4. */
+uint32_t simPdoCnt = 0;
+
+void simReset( void )
+{
+	simTimeUs = 0;
+	simTickOffset = 0;
+	simPdoCnt = 0;
+	simGpioA.ODR = 0;
+	simGpioB.ODR = 0;
+	memset( &userData, 0, sizeof(userData) );
+	simTimReset();
+	simSpiReset();
+	simUartReset();
+	simI2cReset();
+}
+
+void simRun( uint32_t us )
+{
+	for ( uint32_t time = 0; time < us; time += SIM_STEP_US )
+	{
+		simTimeUs += SIM_STEP_US;
+		simFlashStep( SIM_STEP_US );
+		simI2cStep( SIM_STEP_US );
+		simUartStep( SIM_STEP_US );
+		simTimStep( SIM_STEP_US );
+	}
+}
+
+void simBoot( void )
+{
+	simReset();
+	ledInit();
+	aiInit();
+	hartInit();
+	schedInit();
+	HAL_TIM_Base_Start_IT( &htim2 );
+}
+
+void simMain( uint32_t us )
+{
+	for ( uint32_t time = 0; time < us; time += SIM_STEP_US )
+	{
+		schedRun();
+		simRun( SIM_STEP_US );
+	}
+}
+
+uint64_t simGetTimeUs( void )
+{
+	return simTimeUs;
+}
+
+void simSetTick( uint32_t tick )
+{
+	simTickOffset = tick - (uint32_t)( simTimeUs / 1000 );
+}
+
+uint32_t simGetPdoCount( void )
+{
+	return simPdoCnt;
+}
+
+uint32_t HAL_GetTick( void )
+{
+	return (uint32_t)( simTimeUs / 1000 ) + simTickOffset;
+}
+
+void HAL_GPIO_WritePin( GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState )
+{
+	if ( PinState != GPIO_PIN_RESET )
+	{
+		GPIOx->ODR |= GPIO_Pin;
+	}
+	else
+	{
+		GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+	}
+}
+
+HAL_StatusTypeDef HAL_DMA_Init( DMA_HandleTypeDef* hdma )
+{
+	return HAL_OK;
+}
+
+void usercanSendPDO4( void )
+{
+	simPdoCnt++;
+}
+
+void HAL_TIM_PeriodElapsedCallback( TIM_HandleTypeDef* htim )
+{
+	if ( htim == &htim5 )
+	{
+		hartTimeout();
+	}
+	else
+	if ( htim == &htim2 )
+	{
+		aiScanTick();
+	}
+}
@@ -0,0 +1,69 @@
+#include "sim.h"
+
+#include "spi.h"
+#include "setting.h"
+#include "string.h"
+
+/* Модель АЦП на SPI1: выборка по конфигу канала выдается через AI_ADC_PIPELINE_DEPTH обменов.
+ * Обмен из двух байт короче шага модели, поэтому завершается сразу, из той же функции запуска
+ * (как прерывание DMA, пришедшее после возврата из HAL). SPI2 (флешка) заменен моделью флешки. */
+
+SPI_HandleTypeDef hspi1 = {};
+SPI_HandleTypeDef hspi2 = {};
+
+/* Источник выборок. */
+SimAdcSource simAdcSource = 0;
+/* Конфиги последних обменов, по кругу. */
+uint8_t simAdcConfig[AI_ADC_PIPELINE_DEPTH + 1][2] = {};
+/* Кол-во следующих запусков обмена, которые вернут HAL_BUSY. */
+uint32_t simAdcBusyCnt = 0;
+
+void simAdcSetSource( SimAdcSource source )
+{
+	simAdcSource = source;
+}
+
+void simAdcSetBusy( uint32_t count )
+{
+	simAdcBusyCnt = count;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA( SPI_HandleTypeDef* hspi, uint8_t* pTxData, uint8_t* pRxData, uint16_t Size )
+{
+	uint8_t* config;
+	uint16_t sample;
+
+	if ( ( hspi != &hspi1 ) || ( Size != 2 ) )
+	{
+		return HAL_ERROR;
+	}
+	if ( simAdcBusyCnt )
+	{
+		/* Обмен не запущен, завершения не будет. */
+		simAdcBusyCnt--;
+		return HAL_BUSY;
+	}
+	config = simAdcConfig[hspi->transferCnt % ( AI_ADC_PIPELINE_DEPTH + 1 )];
+	memcpy( config, pTxData, 2 );
+	hspi->transferCnt++;
+	/* Выборка конфига, отправленного AI_ADC_PIPELINE_DEPTH обменов назад. */
+	config = simAdcConfig[hspi->transferCnt % ( AI_ADC_PIPELINE_DEPTH + 1 )];
+	sample = ( simAdcSource && ( hspi->transferCnt > AI_ADC_PIPELINE_DEPTH ) ) ? simAdcSource( config ) : 0;
+	pRxData[0] = sample >> 8;
+	pRxData[1] = sample & 0xFF;
+	HAL_SPI_TxRxCpltCallback( hspi );
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Abort( SPI_HandleTypeDef* hspi )
+{
+	/* Обмены модели завершаются сразу, прерывать нечего. */
+	return HAL_OK;
+}
+
+void simSpiReset( void )
+{
+	hspi1.transferCnt = 0;
+	simAdcBusyCnt = 0;
+	memset( simAdcConfig, 0, sizeof(simAdcConfig) );
+}
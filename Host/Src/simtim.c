@@ -0,0 +1,51 @@
+#include "sim.h"
+
+#include "tim.h"
+
+/* Модель таймеров: прерывание по переполнению каждые period мкс, пока таймер запущен. */
+
+TIM_HandleTypeDef htim2 = { SIM_TIM2_PERIOD_US };
+TIM_HandleTypeDef htim5 = { SIM_TIM5_PERIOD_US };
+
+/* Таймеры в порядке приоритета прерываний. */
+TIM_HandleTypeDef* const simTim[] = { &htim2, &htim5 };
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT( TIM_HandleTypeDef* htim )
+{
+	/* Счет начинается с нуля. */
+	htim->remain = htim->period;
+	htim->isRunning = 1;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT( TIM_HandleTypeDef* htim )
+{
+	htim->isRunning = 0;
+	return HAL_OK;
+}
+
+void simTimStep( uint32_t us )
+{
+	for ( uint8_t i = 0; i < ( sizeof(simTim) / sizeof(simTim[0]) ); i++ )
+	{
+		TIM_HandleTypeDef* htim = simTim[i];
+
+		if ( !htim->isRunning )
+		{
+			continue;
+		}
+		if ( htim->remain > us )
+		{
+			htim->remain -= us;
+			continue;
+		}
+		htim->remain = htim->period;
+		HAL_TIM_PeriodElapsedCallback( htim );
+	}
+}
+
+void simTimReset( void )
+{
+	htim2.isRunning = 0;
+	htim5.isRunning = 0;
+}
@@ -0,0 +1,373 @@
+#include "sim.h"
+
+#include "usart.h"
+#include "main.h"
+#include "setting.h"
+#include "hartframe.h"
+#include "string.h"
+
+/* Модель HART-модема на USART1 и устройств на каналах. Запрос разбирается, когда после передачи
+ * поднят UART_RTS. Отвечает устройство канала, выбранного мультиплексором через latencyUs
+ * после запроса; байты ответа попадают в кольцо приема, пока мультиплексор выбирает этот канал.
+ * События кольца как у HAL: половина, конец кольца и пауза (IDLE), если 0 < NDTR < размера кольца. */
+
+/* Время ожидания ответа на запрос, после него запрос забывается, мкс. */
+#define SIM_HART_ANSWER_EXPIRE_US			2000000
+/* Размер ответа: преамбула, разделитель, адрес, команда, счетчик, данные, сумма. */
+#define SIM_HART_ANSWER_SIZE				( SIM_HART_PREAMBLE + HART_REQUEST_SIZE + 2 + 255 )
+/* Значения мультиплексора для каналов. */
+const uint8_t simHartMux[AI_CH_NUM] = { 0b011, 0b010, 0b000, 0b110, 0b101, 0b100 };
+
+DMA_Stream_TypeDef simUartStreamRx = {};
+DMA_HandleTypeDef simUartDmaRx = { &simUartStreamRx };
+UART_HandleTypeDef huart1 = { &simUartDmaRx, HAL_UART_STATE_READY, HAL_UART_STATE_READY };
+
+typedef struct SimUart
+{
+	/* Передача модуля. */
+	const uint8_t* txData;
+	uint16_t txSize;
+	uint32_t txRemain;
+	/* Переданные байты с последнего запроса. */
+	uint8_t request[SIZE_HART_BUFF + HART_PREAMBLE_TX];
+	uint16_t requestSize;
+	uint32_t txBytes;
+
+	/* Кольцо приема. */
+	uint8_t* ring;
+	uint16_t ringSize;
+	uint16_t ringPos;
+	/* Время до события IDLE после последнего принятого байта, 0 - события нет, мкс. */
+	uint32_t idleRemain;
+
+	/* Разобранный запрос, ожидающий ответа. */
+	uint8_t isRequest;
+	uint8_t address[HART_LONG_ADDR_SIZE];
+	uint8_t addressSize;
+	uint8_t command;
+	/* Время с конца запроса, мкс. */
+	uint32_t requestAge;
+
+	/* Ответ устройства. */
+	uint8_t answer[SIM_HART_ANSWER_SIZE];
+	uint16_t answerSize;
+	uint16_t answerPos;
+	uint8_t answerCh;
+	/* Время до следующего байта ответа, мкс. */
+	uint32_t answerRemain;
+
+	SimHartDevice device[AI_CH_NUM];
+	uint32_t answerCnt[AI_CH_NUM];
+} SimUart;
+
+SimUart simUart = { .answerCh = SIM_HART_NO_CHANNEL };
+
+/* ________________________ FUNCTION'S PROTOTYPE ________________________ */
+uint8_t simHartIsAddressed( const SimHartDevice* device );
+void simHartRequest( void );
+void simHartAnswer( uint8_t channel );
+void simUartReceive( uint8_t byte );
+
+/**
+  * @brief  Канал, выбранный мультиплексором.
+  * @retval номер канала, SIM_HART_NO_CHANNEL - канал не выбран (передача).
+  */
+uint8_t simHartChannel( void )
+{
+	uint8_t mux = GPIOB->ODR & ( MUX_0_Pin | MUX_1_Pin | MUX_2_Pin );
+
+	for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
+	{
+		if ( simHartMux[channel] == mux )
+		{
+			return channel;
+		}
+	}
+	return SIM_HART_NO_CHANNEL;
+}
+
+/**
+  * @brief  Проверка адреса запроса: короткий адрес 0 или длинный адрес устройства.
+  */
+uint8_t simHartIsAddressed( const SimHartDevice* device )
+{
+	if ( simUart.addressSize == HART_SHORT_ADDR_SIZE )
+	{
+		return ( simUart.address[0] & HART_ADDR_MANUFACTURER_MASK ) == 0;
+	}
+	return ( ( simUart.address[0] & HART_ADDR_MANUFACTURER_MASK ) == ( device->address[0] & HART_ADDR_MANUFACTURER_MASK ) )
+			&& !memcmp( &simUart.address[1], &device->address[1], HART_LONG_ADDR_SIZE - 1 );
+}
+
+/**
+  * @brief  Разбор переданного модулем запроса.
+  */
+void simHartRequest( void )
+{
+	HartFrame frame;
+
+	if ( ( hartFrameDecode( simUart.request, simUart.requestSize, &frame ) != HART_FRAME_OK )
+			|| ( frame.type != HART_FRAME_STX ) )
+	{
+		return;
+	}
+	memcpy( simUart.address, &simUart.request[frame.start + 1], frame.addressSize );
+	simUart.addressSize = frame.addressSize;
+	simUart.command = frame.command;
+	simUart.requestAge = 0;
+	simUart.isRequest = 1;
+}
+
+/**
+  * @brief  Сборка ответа устройства канала на разобранный запрос.
+  */
+void simHartAnswer( uint8_t channel )
+{
+	SimHartDevice* device = &simUart.device[channel];
+	uint8_t* frame = &simUart.answer[SIM_HART_PREAMBLE];
+	uint8_t* data;
+	uint16_t size = 0;
+
+	memset( simUart.answer, HART_PREAMBLE_BYTE, SIM_HART_PREAMBLE );
+	frame[size++] = HART_FRAME_ACK | ( ( simUart.addressSize == HART_LONG_ADDR_SIZE ) ? HART_DELIMITER_LONG_ADDR : 0 );
+	memcpy( &frame[size], simUart.address, simUart.addressSize );
+	size += simUart.addressSize;
+	frame[size++] = simUart.command;
+	frame[size++] = ( simUart.command == 0 ) ? 14 : ( 2 + device->dataSize );
+	data = &frame[size];
+	memset( data, 0, frame[size - 1] );
+	data[1] = device->status;
+	if ( simUart.command == 0 )
+	{
+		/* Команда 0: расширенный код, тип устройства, преамбула, ревизии, флаги, ID устройства. */
+		data[2] = 254;
+		data[3] = device->address[0] & HART_ADDR_MANUFACTURER_MASK;
+		data[4] = device->address[1];
+		data[5] = SIM_HART_PREAMBLE;
+		memcpy( &data[11], &device->address[2], 3 );
+	}
+	else
+	{
+		for ( uint8_t i = 0; i < device->dataSize; i++ )
+		{
+			data[2 + i] = channel + i;
+		}
+	}
+	size += frame[size - 1];
+	simUart.answerSize = SIM_HART_PREAMBLE + hartFrameEncode( frame, size );
+	simUart.answerPos = 0;
+	simUart.answerCh = channel;
+	simUart.answerRemain = SIM_UART_BYTE_US;
+	simUart.answerCnt[channel]++;
+}
+
+/**
+  * @brief  Прием байта в кольцо DMA с событиями половины и конца кольца.
+  */
+void simUartReceive( uint8_t byte )
+{
+	if ( huart1.RxState != HAL_UART_STATE_BUSY_RX )
+	{
+		return;
+	}
+	simUart.ring[simUart.ringPos++] = byte;
+	simUartStreamRx.NDTR = simUart.ringSize - simUart.ringPos;
+	simUart.idleRemain = SIM_UART_BYTE_US;
+	if ( simUart.ringPos == ( simUart.ringSize / 2 ) )
+	{
+		huart1.RxEventType = HAL_UART_RXEVENT_HT;
+		HAL_UARTEx_RxEventCallback( &huart1, simUart.ringSize / 2 );
+	}
+	else
+	if ( simUart.ringPos == simUart.ringSize )
+	{
+		simUart.ringPos = 0;
+		simUartStreamRx.NDTR = simUart.ringSize;
+		huart1.RxEventType = HAL_UART_RXEVENT_TC;
+		HAL_UARTEx_RxEventCallback( &huart1, simUart.ringSize );
+	}
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT( UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size )
+{
+	if ( huart->gState != HAL_UART_STATE_READY )
+	{
+		return HAL_BUSY;
+	}
+	huart->gState = HAL_UART_STATE_BUSY_TX;
+	simUart.txData = pData;
+	simUart.txSize = Size;
+	simUart.txRemain = Size * SIM_UART_BYTE_US;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA( UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size )
+{
+	if ( huart->RxState != HAL_UART_STATE_READY )
+	{
+		return HAL_BUSY;
+	}
+	huart->RxState = HAL_UART_STATE_BUSY_RX;
+	simUart.ring = pData;
+	simUart.ringSize = Size;
+	simUart.ringPos = 0;
+	simUart.idleRemain = 0;
+	simUartStreamRx.NDTR = Size;
+	return HAL_OK;
+}
+
+HAL_UART_RxEventTypeTypeDef HAL_UARTEx_GetRxEventType( UART_HandleTypeDef* huart )
+{
+	return huart->RxEventType;
+}
+
+void simUartStep( uint32_t us )
+{
+	uint8_t channel;
+	uint16_t size;
+
+	/* Передача модуля. */
+	if ( huart1.gState == HAL_UART_STATE_BUSY_TX )
+	{
+		if ( simUart.txRemain > us )
+		{
+			simUart.txRemain -= us;
+		}
+		else
+		{
+			size = simUart.txSize;
+			if ( size > ( sizeof(simUart.request) - simUart.requestSize ) )
+			{
+				size = sizeof(simUart.request) - simUart.requestSize;
+			}
+			memcpy( &simUart.request[simUart.requestSize], simUart.txData, size );
+			simUart.requestSize += size;
+			simUart.txBytes += simUart.txSize;
+			huart1.gState = HAL_UART_STATE_READY;
+			HAL_UART_TxCpltCallback( &huart1 );
+			/* Передача закончена и модем переключен на прием - запрос ушел в линию. */
+			if ( ( huart1.gState == HAL_UART_STATE_READY ) && ( UART_RTS_GPIO_Port->ODR & UART_RTS_Pin ) )
+			{
+				simHartRequest();
+				simUart.requestSize = 0;
+			}
+		}
+	}
+
+	/* Начало ответа устройства выбранного канала. */
+	if ( simUart.isRequest )
+	{
+		simUart.requestAge += us;
+		channel = simHartChannel();
+		if ( simUart.requestAge >= SIM_HART_ANSWER_EXPIRE_US )
+		{
+			simUart.isRequest = 0;
+		}
+		else
+		if ( ( channel != SIM_HART_NO_CHANNEL ) && ( simUart.answerCh == SIM_HART_NO_CHANNEL )
+				&& simUart.device[channel].isPresent && ( simUart.requestAge >= simUart.device[channel].latencyUs ) )
+		{
+			simUart.isRequest = 0;
+			/* Запрос другому адресу или пропущенный устройством остается без ответа. */
+			if ( simHartIsAddressed( &simUart.device[channel] ) )
+			{
+				if ( simUart.device[channel].silentCnt )
+				{
+					simUart.device[channel].silentCnt--;
+				}
+				else
+				{
+					simHartAnswer( channel );
+				}
+			}
+		}
+	}
+
+	/* Байты ответа. */
+	if ( simUart.answerCh != SIM_HART_NO_CHANNEL )
+	{
+		if ( simUart.answerRemain > us )
+		{
+			simUart.answerRemain -= us;
+		}
+		else
+		{
+			simUart.answerRemain = SIM_UART_BYTE_US;
+			/* Байт слышен, только пока мультиплексор выбирает канал устройства. */
+			if ( simHartChannel() == simUart.answerCh )
+			{
+				simUartReceive( simUart.answer[simUart.answerPos] );
+			}
+			if ( ++simUart.answerPos == simUart.answerSize )
+			{
+				simUart.answerCh = SIM_HART_NO_CHANNEL;
+			}
+		}
+	}
+
+	/* Пауза на линии после последнего байта. */
+	if ( simUart.idleRemain )
+	{
+		if ( simUart.idleRemain > us )
+		{
+			simUart.idleRemain -= us;
+		}
+		else
+		/* Следующий байт ответа идет вплотную за предыдущим - паузы нет. */
+		if ( ( simUart.answerCh == SIM_HART_NO_CHANNEL ) || ( simHartChannel() != simUart.answerCh ) )
+		{
+			simUart.idleRemain = 0;
+			if ( ( huart1.RxState == HAL_UART_STATE_BUSY_RX ) && ( simUartStreamRx.NDTR > 0 ) && ( simUartStreamRx.NDTR < simUart.ringSize ) )
+			{
+				huart1.RxEventType = HAL_UART_RXEVENT_IDLE;
+				HAL_UARTEx_RxEventCallback( &huart1, simUart.ringSize - simUartStreamRx.NDTR );
+			}
+		}
+	}
+}
+
+void simUartReset( void )
+{
+	SimHartDevice device[AI_CH_NUM];
+
+	memcpy( device, simUart.device, sizeof(device) );
+	memset( &simUart, 0, sizeof(simUart) );
+	memcpy( simUart.device, device, sizeof(device) );
+	simUart.answerCh = SIM_HART_NO_CHANNEL;
+	simUartStreamRx.NDTR = 0;
+	huart1.gState = HAL_UART_STATE_READY;
+	huart1.RxState = HAL_UART_STATE_READY;
+}
+
+void simHartSetDevice( uint8_t channel, const SimHartDevice* device )
+{
+	simUart.device[channel] = *device;
+}
+
+SimHartDevice* simHartGetDevice( uint8_t channel )
+{
+	return &simUart.device[channel];
+}
+
+uint32_t simHartGetAnswerCount( uint8_t channel )
+{
+	return simUart.answerCnt[channel];
+}
+
+uint32_t simUartGetTxBytes( void )
+{
+	return simUart.txBytes;
+}
+
+uint16_t simUartGetRingHead( void )
+{
+	return simUart.ringPos;
+}
+
+void simUartError( void )
+{
+	/* Прием по кольцу остановлен, незаконченный ответ теряется. */
+	huart1.RxState = HAL_UART_STATE_READY;
+	simUart.idleRemain = 0;
+	HAL_UART_ErrorCallback( &huart1 );
+}
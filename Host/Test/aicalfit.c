@@ -0,0 +1,194 @@
+/* Расчет коэфициентов калибровки: прежний метод (нормальные уравнения по степеням выборки, Крамер)
+ * против QR по приведенной выборке на синтетических кривых - точных, с шумом и плохо обусловленных
+ * (точки калибровки в узком диапазоне кодов). Ошибка - отклонение полинома от эталона в long double. */
+#include "test.h"
+
+#include "ai.c"
+
+/* Кривая калибровки: код АЦП точки = ( ideal - offset ) / gain + bend * ( ideal - ADC_IDEAL_MA12 )^2 + шум. */
+typedef struct TestCurve
+{
+	const char* name;
+	double gain;
+	double offset;
+	double bend;
+	/* Размах шума, коды. */
+	uint16_t noise;
+	/* Допуск ошибки QR, мкА. */
+	double limit;
+} TestCurve;
+
+const TestCurve testCurve[] =
+{
+	{ "linear",			1.1461,		43.66,		0,			0,	1e-3 },
+	{ "quadratic",		1.1461,		43.66,		2e-7,		0,	1e-3 },
+	{ "noise",			0.98,		-120,		-1e-7,		7,	1e-3 },
+	{ "narrow span",	400,		-1.6e7,		0,			0,	1e-3 },
+	{ "narrow noise",	250,		-1e7,		1e-5,		3,	1e-3 },
+};
+
+/* Коды идеального АЦП точек 4..20 мА. */
+const uint16_t testIdeal[SIZE_ARRAY_RANGE_MA] =
+{
+	ADC_IDEAL_MA4, ADC_IDEAL_MA5, ADC_IDEAL_MA6, ADC_IDEAL_MA7, ADC_IDEAL_MA8, ADC_IDEAL_MA9,
+	ADC_IDEAL_MA10, ADC_IDEAL_MA11, ADC_IDEAL_MA12, ADC_IDEAL_MA13, ADC_IDEAL_MA14, ADC_IDEAL_MA15,
+	ADC_IDEAL_MA16, ADC_IDEAL_MA17, ADC_IDEAL_MA18, ADC_IDEAL_MA19, ADC_IDEAL_MA20,
+};
+
+/**
+  * @brief  Прежний расчет: нормальные уравнения по степеням x до x^4, решение по Крамеру.
+  * @retval 1 - решение найдено.
+  */
+uint8_t testNormalEquations( const uint16_t* x, double* coef )
+{
+	double sum_x = 0, sum_x2 = 0, sum_x3 = 0, sum_x4 = 0;
+	double sum_y = 0, sum_xy = 0, sum_x2y = 0;
+
+	for ( uint8_t i = 0; i < SIZE_ARRAY_RANGE_MA; i++ )
+	{
+		sum_x += x[i];
+		sum_x2 += (double)x[i] * x[i];
+		sum_x3 += (double)x[i] * x[i] * x[i];
+		sum_x4 += (double)x[i] * x[i] * x[i] * x[i];
+		sum_y += (double)testIdeal[i];
+		sum_xy += (double)x[i] * testIdeal[i];
+		sum_x2y += (double)x[i] * x[i] * testIdeal[i];
+	}
+	double A = sum_x4, B = sum_x3, C = sum_x2;
+	double D = sum_x3, E = sum_x2, F = sum_x;
+	double G = sum_x2, H = sum_x, I = SIZE_ARRAY_RANGE_MA;
+	double J = sum_x2y, K = sum_xy, L = sum_y;
+	double denominator = A * ( E * I - H * F ) - B * ( D * I - G * F ) + C * ( D * H - E * G );
+
+	if ( denominator == 0 )
+	{
+		return 0;
+	}
+	coef[2] = ( J * ( E * I - H * F ) - K * ( D * I - G * F ) + L * ( D * H - E * G ) ) / denominator;
+	coef[1] = ( A * ( K * I - H * L ) - B * ( J * I - G * L ) + C * ( J * H - K * G ) ) / denominator;
+	coef[0] = ( A * ( E * L - K * F ) - B * ( D * L - J * F ) + C * ( D * K - E * J ) ) / denominator;
+	return 1;
+}
+
+/**
+  * @brief  Эталон: нормальные уравнения в long double по приведенной к [-1, 1] выборке, метод Гаусса.
+  *         Полином возвращается по t = ( x - center ) / scale.
+  */
+void testReference( const uint16_t* x, long double center, long double scale, long double* p )
+{
+	long double a[AI_CALIBRATION_COEF_NUM][AI_CALIBRATION_COEF_NUM + 1] = {};
+
+	for ( uint8_t i = 0; i < SIZE_ARRAY_RANGE_MA; i++ )
+	{
+		long double t = ( x[i] - center ) / scale;
+		long double row[AI_CALIBRATION_COEF_NUM + 1];
+
+		row[0] = 1;
+		for ( uint8_t k = 1; k < AI_CALIBRATION_COEF_NUM; k++ )
+		{
+			row[k] = row[k - 1] * t;
+		}
+		row[AI_CALIBRATION_COEF_NUM] = testIdeal[i];
+		for ( uint8_t r = 0; r < AI_CALIBRATION_COEF_NUM; r++ )
+		{
+			for ( uint8_t c = 0; c <= AI_CALIBRATION_COEF_NUM; c++ )
+			{
+				a[r][c] += row[r] * row[c];
+			}
+		}
+	}
+	for ( uint8_t k = 0; k < AI_CALIBRATION_COEF_NUM; k++ )
+	{
+		for ( uint8_t r = k + 1; r < AI_CALIBRATION_COEF_NUM; r++ )
+		{
+			long double f = a[r][k] / a[k][k];
+			for ( uint8_t c = k; c <= AI_CALIBRATION_COEF_NUM; c++ )
+			{
+				a[r][c] -= f * a[k][c];
+			}
+		}
+	}
+	for ( int8_t k = AI_CALIBRATION_COEF_NUM - 1; k >= 0; k-- )
+	{
+		long double s = a[k][AI_CALIBRATION_COEF_NUM];
+		for ( uint8_t c = k + 1; c < AI_CALIBRATION_COEF_NUM; c++ )
+		{
+			s -= a[k][c] * p[c];
+		}
+		p[k] = s / a[k][k];
+	}
+}
+
+/**
+  * @brief  Макс. отклонение полинома coef (по x, как в aiConvert) от эталона на кодах xMin..xMax, мкА.
+  */
+double testError( const double* coef, uint16_t xMin, uint16_t xMax, long double center, long double scale, const long double* p )
+{
+	double maxError = 0;
+
+	for ( uint32_t x = xMin; x <= xMax; x++ )
+	{
+		double value = ( ( coef[3] * x + coef[2] ) * x + coef[1] ) * x + coef[0];
+		long double t = ( x - center ) / scale;
+		long double reference = 0;
+
+		for ( int8_t k = AI_CALIBRATION_COEF_NUM - 1; k >= 0; k-- )
+		{
+			reference = reference * t + p[k];
+		}
+		double error = fabsl( value - reference ) * CURRENT_STEP;
+		maxError = ( error > maxError ) ? error : maxError;
+	}
+	return maxError;
+}
+
+int main( void )
+{
+	/* Генератор шума (LCG), одинаковый при каждом запуске. */
+	uint32_t seed = 12345;
+
+	for ( uint8_t n = 0; n < ( sizeof(testCurve) / sizeof(testCurve[0]) ); n++ )
+	{
+		const TestCurve* curve = &testCurve[n];
+		uint16_t* x = aiCalibrationData[0].adcValue;
+		uint16_t xMin = 0xFFFF;
+		uint16_t xMax = 0;
+		long double p[AI_CALIBRATION_COEF_NUM];
+		double ne[4] = { 0 };
+		double qr[4];
+		double neError = INFINITY;
+		double qrError;
+
+		for ( uint8_t i = 0; i < SIZE_ARRAY_RANGE_MA; i++ )
+		{
+			double d = (double)testIdeal[i] - ADC_IDEAL_MA12;
+			double value = ( testIdeal[i] - curve->offset ) / curve->gain + curve->bend * d * d;
+
+			seed = seed * 1103515245 + 12345;
+			if ( curve->noise )
+			{
+				value += (int32_t)( ( seed >> 16 ) % ( 2 * curve->noise + 1 ) ) - curve->noise;
+			}
+			x[i] = lround( value );
+			xMin = ( x[i] < xMin ) ? x[i] : xMin;
+			xMax = ( x[i] > xMax ) ? x[i] : xMax;
+		}
+		testReference( x, ( (long double)xMin + xMax ) / 2, ( (long double)xMax - xMin ) / 2, p );
+
+		if ( testNormalEquations( x, ne ) )
+		{
+			neError = testError( ne, xMin, xMax, ( (long double)xMin + xMax ) / 2, ( (long double)xMax - xMin ) / 2, p );
+		}
+		aiCalcCalibration( 0 );
+		qr[0] = aiDataFlash.coefC[0];
+		qr[1] = aiDataFlash.coefB[0];
+		qr[2] = aiDataFlash.coefA[0];
+		qr[3] = aiDataFlash.coefD[0];
+		qrError = testError( qr, xMin, xMax, ( (long double)xMin + xMax ) / 2, ( (long double)xMax - xMin ) / 2, p );
+
+		printf( "%-14s codes %5u..%5u: normal equations %.3g uA, QR %.3g uA\n", curve->name, xMin, xMax, neError, qrError );
+		TEST_CHECK( qrError <= curve->limit, "%s: QR error %.3g uA", curve->name, qrError );
+		TEST_CHECK( qrError <= ( neError + 1e-6 ), "%s: QR %.3g uA worse than normal equations %.3g uA", curve->name, qrError, neError );
+	}
+	return testResult();
+}
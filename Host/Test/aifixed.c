@@ -0,0 +1,68 @@
+/* Перевод выборки в ток в фиксированной точке (AI_CONVERSION_FIXED): на всем диапазоне кодов АЦП,
+ * целых и с дробной частью фильтра, ток совпадает с расчетом в double в пределах ±1 МЗР (1 мкА). */
+#include "test.h"
+
+#define AI_CONVERSION						AI_CONVERSION_FIXED
+#include "ai.c"
+
+/* Шаг перебора выборок с дробной частью, Q(FILTER_FRAC_BITS). */
+#define TEST_FRAC_STRIDE					97
+
+/* Наборы коэфициентов калибровки: по умолчанию и с краев разброса каналов. */
+const double testCoef[][3] =
+{
+	{ DEFAULT_CALIBRATION_COEF_A, DEFAULT_CALIBRATION_COEF_B, DEFAULT_CALIBRATION_COEF_C },
+	{ 2e-7, 0.95, -300 },
+	{ -5e-7, 1.2, 500 },
+	{ 0, 1, 0 },
+};
+
+/**
+  * @brief  Ток в мкА по выборке в double.
+  */
+double testReference( uint8_t channel, uint32_t sample )
+{
+	double x = (double)sample / ( 1UL << FILTER_FRAC_BITS );
+	double current = ( aiData[channel].coefA * x + aiData[channel].coefB ) * x + aiData[channel].coefC;
+
+	current = LOWER_SAMPLE_BIAS + ( current - ADC_IDEAL_MA4 ) * CURRENT_STEP;
+	return ( current > 0 ) ? current : 0;
+}
+
+/**
+  * @brief  Отклонение aiConvert от целой части тока в double.
+  */
+int32_t testError( uint8_t channel, uint32_t sample )
+{
+	return (int32_t)aiConvert( channel, sample ) - (int32_t)floor( testReference( channel, sample ) );
+}
+
+int main( void )
+{
+	int32_t error;
+	int32_t maxError;
+
+	for ( uint8_t set = 0; set < ( sizeof(testCoef) / sizeof(testCoef[0]) ); set++ )
+	{
+		aiData[0].coefA = testCoef[set][0];
+		aiData[0].coefB = testCoef[set][1];
+		aiData[0].coefC = testCoef[set][2];
+		aiData[0].coefD = 0;
+		aiUpdateConversion( 0 );
+
+		maxError = 0;
+		for ( uint32_t code = 0; code <= 0xFFFF; code++ )
+		{
+			error = testError( 0, code << FILTER_FRAC_BITS );
+			maxError = ( abs( error ) > abs( maxError ) ) ? error : maxError;
+		}
+		for ( uint32_t sample = 0; sample <= ( 0xFFFFUL << FILTER_FRAC_BITS ); sample += TEST_FRAC_STRIDE )
+		{
+			error = testError( 0, sample );
+			maxError = ( abs( error ) > abs( maxError ) ) ? error : maxError;
+		}
+		printf( "coef set %u: max error %d LSB\n", set, maxError );
+		TEST_CHECK( abs( maxError ) <= 1, "coef set %u: max error %d LSB", set, maxError );
+	}
+	return testResult();
+}
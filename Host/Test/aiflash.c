@@ -0,0 +1,147 @@
+/* Таймауты флешки при загрузке и сохранении калибровки. Таймаут AI_FLASH_OP_TIMEOUT считается
+ * на каждую операцию: медленная, но отвечающая флешка загружается, зависшая - отбрасывается.
+ * Сохранение после неудачной загрузки сначала загружает журнал и пишет после самой новой записи. */
+#include "test.h"
+#include "sim.h"
+
+#include "ai.c"
+
+/* Кол-во записей журнала перед проверкой: загрузка читает несколько секторов и слотов. */
+#define TEST_RECORD_NUM						20
+/* Пауза между вызовами загрузки "медленной" флешки, мс. */
+#define TEST_SLOW_PERIOD					100
+
+/**
+  * @brief  Перезапуск модуля: загрузка калибровки начинается заново.
+  */
+void testReboot( void )
+{
+	aiReadCalibrationReset();
+	isFlashLoading = 1;
+	flashOpTick = HAL_GetTick();
+}
+
+/**
+  * @brief  Загрузка калибровки с вызовом aiLoadCalibration раз в period мкс.
+  * @retval время загрузки, мс.
+  */
+uint32_t testLoad( uint32_t period )
+{
+	uint64_t start = simGetTimeUs();
+
+	while ( isFlashLoading && ( ( simGetTimeUs() - start ) < 60000000 ) )
+	{
+		aiLoadCalibration();
+		simRun( period );
+	}
+	return ( simGetTimeUs() - start ) / 1000;
+}
+
+/**
+  * @brief  Сохранение калибровки с коэфициентом coefA всех каналов.
+  * @retval время сохранения, мс.
+  */
+uint32_t testSave( double coefA )
+{
+	uint64_t start = simGetTimeUs();
+
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		aiDataFlash.coefA[ch] = coefA;
+		aiDataFlash.coefB[ch] = DEFAULT_CALIBRATION_COEF_B;
+		aiDataFlash.coefC[ch] = DEFAULT_CALIBRATION_COEF_C;
+	}
+	do
+	{
+		aiCalibrationSaveData();
+		simRun( SIM_STEP_US );
+	} while ( isFlashSaving && ( ( simGetTimeUs() - start ) < 60000000 ) );
+	return ( simGetTimeUs() - start ) / 1000;
+}
+
+/**
+  * @brief  Проверка индикации всех каналов.
+  */
+uint8_t testLed( LED_COLOR color, LED_MODE mode )
+{
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		if ( ( aiDataLed[ch].colorWorking != color ) || ( aiDataLed[ch].modeWorking != mode ) )
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main( void )
+{
+	uint32_t time;
+	uint32_t writeCnt;
+
+	simReset();
+	simFlashClear();
+	aiInit();
+	testLoad( SIM_STEP_US );
+	TEST_CHECK( testLed( COLOR_YELLOW, MODE_BLINK ), "empty flash" );
+
+	for ( uint32_t i = 1; i <= TEST_RECORD_NUM; i++ )
+	{
+		testSave( i );
+	}
+	TEST_CHECK( simFlashGetWriteCount() == TEST_RECORD_NUM, "writes %u", simFlashGetWriteCount() );
+
+	/* Медленная флешка: каждая операция быстрее таймаута, вся загрузка - дольше. */
+	testReboot();
+	aiData[0].coefA = 0;
+	time = testLoad( TEST_SLOW_PERIOD * 1000 );
+	TEST_CHECK( time > AI_FLASH_OP_TIMEOUT, "slow load took %u ms", time );
+	TEST_CHECK( testLed( COLOR_GREEN, MODE_ON ), "slow load failed" );
+	TEST_CHECK( aiData[0].coefA == TEST_RECORD_NUM, "slow load coefA %f", aiData[0].coefA );
+
+	/* Флешка зависла посреди загрузки: загрузка завершается через таймаут операции. */
+	testReboot();
+	for ( uint8_t i = 0; i < 10; i++ )
+	{
+		aiLoadCalibration();
+		simRun( SIM_STEP_US );
+	}
+	simFlashPowerCut( 0 );
+	time = testLoad( SIM_STEP_US );
+	TEST_CHECK( !isFlashLoading, "load did not finish" );
+	TEST_CHECK( ( ( time + 10 ) >= AI_FLASH_OP_TIMEOUT ) && ( time <= ( AI_FLASH_OP_TIMEOUT + 10 ) ), "hung load took %u ms", time );
+	TEST_CHECK( testLed( COLOR_RED, MODE_BLINK ), "hung flash not indicated" );
+	TEST_CHECK( journalAppend( (uint8_t*)&aiDataFlash, sizeof(AiDataFlash) ) == JOURNAL_NOT_LOADED, "journal loaded" );
+
+	/* Флешка ожила: сохранение сначала находит самую новую запись и пишет после нее. */
+	simFlashPowerOn();
+	writeCnt = simFlashGetWriteCount();
+	testSave( 100 );
+	TEST_CHECK( simFlashGetWriteCount() == ( writeCnt + 1 ), "writes %u", simFlashGetWriteCount() - writeCnt );
+	testReboot();
+	testLoad( SIM_STEP_US );
+	TEST_CHECK( aiData[0].coefA == 100, "saved after failed load: coefA %f", aiData[0].coefA );
+
+	/* Флешка зависла при сохранении: запись отменяется через таймаут операции, данные не меняются. */
+	simFlashPowerCut( 0 );
+	writeCnt = simFlashGetWriteCount();
+	time = testSave( 200 );
+	TEST_CHECK( !isFlashSaving, "save did not finish" );
+	TEST_CHECK( ( ( time + 10 ) >= AI_FLASH_OP_TIMEOUT ) && ( time <= ( AI_FLASH_OP_TIMEOUT + 10 ) ), "hung save took %u ms", time );
+	TEST_CHECK( testLed( COLOR_RED, MODE_BLINK ), "hung save not indicated" );
+	TEST_CHECK( simFlashGetWriteCount() == writeCnt, "hung flash written" );
+	simFlashPowerOn();
+	testReboot();
+	testLoad( SIM_STEP_US );
+	TEST_CHECK( aiData[0].coefA == 100, "after hung save: coefA %f", aiData[0].coefA );
+
+	/* Слот записался с ошибкой: сохранение заканчивается индикацией ошибки флешки, загружается прошлая запись. */
+	simFlashWriteFault( sizeof(JournalHeader) + offsetof( AiDataFlash, version ) );
+	testSave( 300 );
+	TEST_CHECK( !isFlashSaving, "bad save did not finish" );
+	TEST_CHECK( testLed( COLOR_RED, MODE_BLINK ), "bad save not indicated" );
+	testReboot();
+	testLoad( SIM_STEP_US );
+	TEST_CHECK( aiData[0].coefA == 100, "after bad save: coefA %f", aiData[0].coefA );
+	return testResult();
+}
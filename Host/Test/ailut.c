@@ -0,0 +1,83 @@
+/* Перевод выборки в ток по таблице (AI_CONVERSION_LUT): ошибка линейной интерполяции относительно
+ * расчета в double на каждом коде АЦП, ток aiConvert в пределах ±1 МЗР, объем таблиц в ОЗУ. */
+#include "test.h"
+
+#define AI_CONVERSION						AI_CONVERSION_LUT
+#include "ai.c"
+
+/* Ошибка интерполяции с коэфициентами по умолчанию из setting.h для AI_LUT_SHIFT 10, мкА. */
+#define TEST_LUT_ERROR_10					0.04
+/* Объем таблиц всех каналов при AI_LUT_SHIFT 10, байт. */
+#define TEST_LUT_RAM_10						1560
+
+/* Наборы коэфициентов калибровки: по умолчанию, с краев разброса каналов, кубический. */
+const double testCoef[][4] =
+{
+	{ DEFAULT_CALIBRATION_COEF_A, DEFAULT_CALIBRATION_COEF_B, DEFAULT_CALIBRATION_COEF_C, 0 },
+	{ 2e-7, 0.95, -300, 0 },
+	{ -5e-7, 1.2, 500, 0 },
+	{ -4e-8, 1.1, 40, 2e-13 },
+};
+
+/**
+  * @brief  Ток в мкА по коду АЦП в double (без ограничения нулем).
+  */
+double testReference( uint8_t channel, double x )
+{
+	double current = ( ( aiData[channel].coefD * x + aiData[channel].coefA ) * x + aiData[channel].coefB ) * x + aiData[channel].coefC;
+
+	return LOWER_SAMPLE_BIAS + ( current - ADC_IDEAL_MA4 ) * CURRENT_STEP;
+}
+
+int main( void )
+{
+	/* Ток по таблице с интерполяцией, мкА. */
+	double interpolated;
+	double reference;
+	double error;
+	double maxError;
+	/* Оценка ошибки из setting.h, мкА. */
+	double bound;
+	int32_t lsbError;
+	int32_t maxLsbError;
+	const int32_t* lut = aiData[0].lut;
+
+	printf( "AI_LUT_SHIFT %u: %u nodes, %u bytes of RAM\n", AI_LUT_SHIFT, AI_LUT_SIZE, (unsigned)( sizeof(aiData[0].lut) * AI_CH_NUM ) );
+#if AI_LUT_SHIFT == 10
+	TEST_CHECK( ( sizeof(aiData[0].lut) * AI_CH_NUM ) == TEST_LUT_RAM_10, "LUT RAM %u", (unsigned)( sizeof(aiData[0].lut) * AI_CH_NUM ) );
+#endif
+
+	for ( uint8_t set = 0; set < ( sizeof(testCoef) / sizeof(testCoef[0]) ); set++ )
+	{
+		aiData[0].coefA = testCoef[set][0];
+		aiData[0].coefB = testCoef[set][1];
+		aiData[0].coefC = testCoef[set][2];
+		aiData[0].coefD = testCoef[set][3];
+		aiUpdateConversion( 0 );
+
+		bound = ( fabs( 2 * aiData[0].coefA ) + fabs( 6 * aiData[0].coefD ) * 65535 ) * CURRENT_STEP
+				* ( 1UL << ( 2 * AI_LUT_SHIFT ) ) / 8 + 1.0 / 512;
+		maxError = 0;
+		maxLsbError = 0;
+		for ( uint32_t code = 0; code <= 0xFFFF; code++ )
+		{
+			uint32_t node = code >> AI_LUT_SHIFT;
+			uint32_t frac = code & ( ( 1UL << AI_LUT_SHIFT ) - 1 );
+
+			interpolated = ( lut[node] + (double)( lut[node + 1] - lut[node] ) * frac / ( 1UL << AI_LUT_SHIFT ) ) / 256;
+			reference = testReference( 0, code );
+			error = fabs( interpolated - reference );
+			maxError = ( error > maxError ) ? error : maxError;
+
+			lsbError = (int32_t)aiConvert( 0, code << FILTER_FRAC_BITS ) - (int32_t)floor( ( reference > 0 ) ? reference : 0 );
+			maxLsbError = ( abs( lsbError ) > abs( maxLsbError ) ) ? lsbError : maxLsbError;
+		}
+		printf( "coef set %u: max interpolation error %.4f uA (bound %.4f), aiConvert max error %d LSB\n", set, maxError, bound, maxLsbError );
+		TEST_CHECK( maxError <= bound, "coef set %u: interpolation error %.4f uA, bound %.4f", set, maxError, bound );
+#if AI_LUT_SHIFT == 10
+		TEST_CHECK( ( set != 0 ) || ( maxError < TEST_LUT_ERROR_10 ), "default coefs: interpolation error %.4f uA", maxError );
+#endif
+		TEST_CHECK( abs( maxLsbError ) <= 1, "coef set %u: max error %d LSB", set, maxLsbError );
+	}
+	return testResult();
+}
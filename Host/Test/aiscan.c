@@ -0,0 +1,127 @@
+/* Первый блок после запуска сканирования: слоты первых AI_ADC_PIPELINE_DEPTH каналов остаются
+ * от прошлого сканирования (выборки конвейера АЦП пропускаются), такие каналы помечаются и в
+ * фильтры этот блок не попадает. Следующие блоки полные. Незапущенный обмен с АЦП (HAL_BUSY)
+ * не останавливает сканирование: канал повторяется на следующем шаге. */
+#include "test.h"
+#include "sim.h"
+
+#include "ai.c"
+
+/* Код АЦП канала в модели. */
+#define TEST_CODE( ch )						( ADC_IDEAL_MA4 + 1000 * ( ch ) )
+/* Содержимое буфера от прошлого сканирования. */
+#define TEST_STALE_CODE						0xDEAD
+/* Ток-метка: у каналов, которые aiWorking не обработал, остается. */
+#define TEST_CURRENT_MARK					12345
+/* Кол-во незапущенных обменов с АЦП подряд. */
+#define TEST_SPI_BUSY						3
+
+/**
+  * @brief  Источник АЦП: код по номеру канала в конфиге.
+  */
+uint16_t testAdcSource( const uint8_t* config )
+{
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		if ( !memcmp( config, aiData[ch].config, 2 ) )
+		{
+			return TEST_CODE( ch );
+		}
+	}
+	return 0;
+}
+
+/**
+  * @brief  Работа только периферии и прерываний (без aiWorking), пока не будет готов блок.
+  */
+void testWaitBlock( void )
+{
+	for ( uint32_t time = 0; !aiScanData.isReady && ( time < 1000000 ); time += SIM_STEP_US )
+	{
+		simRun( SIM_STEP_US );
+	}
+	TEST_CHECK( aiScanData.isReady, "no block" );
+}
+
+/**
+  * @brief  Проверка блока: помеченные каналы и выборки остальных каналов.
+  * @param  staleMask:	ожидаемые помеченные каналы.
+  */
+void testBlock( uint8_t staleMask )
+{
+	uint8_t buff = aiScanData.readyBuff;
+
+	TEST_CHECK( aiScanData.staleMask[buff] == staleMask, "stale mask %02X, expected %02X", aiScanData.staleMask[buff], staleMask );
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		uint8_t isStale = ( staleMask >> ch ) & 1;
+
+		/* Слот 0 помеченного канала остается от прошлого сканирования */
+		for ( uint8_t pos = isStale; pos < AI_SCAN_BLOCK_SIZE; pos++ )
+		{
+			TEST_CHECK( aiScanData.buff[buff][ch][pos] == TEST_CODE( ch ), "channel %u pos %u: %04X", ch + 1, pos, aiScanData.buff[buff][ch][pos] );
+		}
+	}
+	/* В фильтры попадают только полные каналы */
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		aiData[ch].current = TEST_CURRENT_MARK;
+	}
+	aiWorking();
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		uint8_t isStale = ( staleMask >> ch ) & 1;
+
+		TEST_CHECK( ( aiData[ch].current == TEST_CURRENT_MARK ) == isStale, "channel %u current %u, stale %u", ch + 1, aiData[ch].current, isStale );
+	}
+	TEST_CHECK( !aiScanData.isReady && !aiScanData.staleMask[buff], "block not released" );
+}
+
+int main( void )
+{
+	uint8_t staleMask = 0;
+
+	simFlashClear();
+	simAdcSetSource( testAdcSource );
+	simBoot();
+	for ( uint8_t ch = 0; ch < AI_ADC_PIPELINE_DEPTH; ch++ )
+	{
+		staleMask |= 1 << aiData[ch].realCh;
+	}
+
+	/* Запуск при инициализации */
+	testWaitBlock();
+	testBlock( staleMask );
+	testWaitBlock();
+	testBlock( 0 );
+
+	/* Перезапуск сканирования: в буферах данные прошлого сканирования */
+	aiScanStop();
+	memset( aiScanData.buff, 0xAD, sizeof(aiScanData.buff) );
+	for ( uint8_t buff = 0; buff < 2; buff++ )
+	{
+		for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+		{
+			aiScanData.buff[buff][ch][0] = TEST_STALE_CODE;
+		}
+	}
+	aiScanStart();
+	testWaitBlock();
+	testBlock( staleMask );
+	testWaitBlock();
+	testBlock( 0 );
+
+	/* Незапущенные обмены: чип-селект поднят, АЦП свободен, блок остается полным */
+	simAdcSetBusy( TEST_SPI_BUSY );
+	for ( uint8_t i = 0; i < TEST_SPI_BUSY; i++ )
+	{
+		simRun( SIM_TIM2_PERIOD_US );
+		TEST_CHECK( !aiScanData.isBusy && ( ADC_CS_GPIO_Port->ODR & ADC_CS_Pin ), "scan stuck after failed start %u", i + 1 );
+	}
+	TEST_CHECK( aiScanData.spiErrorCnt == TEST_SPI_BUSY, "%u SPI errors counted", aiScanData.spiErrorCnt );
+	testWaitBlock();
+	testBlock( 0 );
+	testWaitBlock();
+	testBlock( 0 );
+	return testResult();
+}
@@ -0,0 +1,60 @@
+/* Экспоненциальный фильтр в фиксированной точке: на постоянном входе выход доходит до входа
+ * при любом коэфициенте, снизу и сверху, без мертвой зоны 2^16 / alpha единиц выборки.
+ * Выход отличается от входа не больше чем на 1 МЗР Q(FILTER_FRAC_BITS) только при alpha = 1. */
+#include "test.h"
+
+#include <stdlib.h>
+
+#include "filter.h"
+
+/* Постоянные входы (код АЦП с дробной частью фильтра) и начальные значения выхода. */
+#define TEST_INPUT							( ( 30880UL << FILTER_FRAC_BITS ) + 0x5A )
+#define TEST_FROM_BELOW						0
+#define TEST_FROM_ABOVE						( 0xFFFFUL << FILTER_FRAC_BITS )
+/* Размер блока выборок, как у сканирования АЦП. */
+#define TEST_BLOCK_SIZE						8
+
+/* Коэфициенты: минимальный в Q16, малые и по умолчанию, без фильтрации. */
+const uint32_t testAlpha[] = { 1, 2, FILTER_EXP_Q( 0.001 ), FILTER_EXP_Q( 0.01 ), FILTER_EXP_Q( DEFAULT_FILTER_EXP ), 1UL << 16 };
+
+/**
+  * @brief  Выход фильтра на постоянном входе после установления.
+  * @param  alpha:	коэфициент в Q16.
+  * @param  from:	начальное значение выхода.
+  */
+uint32_t testSettle( uint32_t alpha, uint32_t from )
+{
+	FilterStage stages[FILTER_MAX_STAGES] = { { FILTER_EXP, alpha } };
+	FilterChain chain;
+	uint32_t block[TEST_BLOCK_SIZE];
+	/* Постоянная времени - 2^16 / alpha выборок, 24 постоянных хватает на весь диапазон Q(FILTER_FRAC_BITS). */
+	uint32_t samples = ( 24UL << 16 ) / alpha + TEST_BLOCK_SIZE;
+
+	TEST_CHECK( filterInit( &chain, stages ), "alpha %u rejected", alpha );
+	filterReset( &chain, from );
+	for ( uint32_t n = 0; n < samples; n += TEST_BLOCK_SIZE )
+	{
+		for ( uint8_t i = 0; i < TEST_BLOCK_SIZE; i++ )
+		{
+			block[i] = TEST_INPUT;
+		}
+		filterProcess( &chain, block, TEST_BLOCK_SIZE );
+	}
+	return filterGetOutput( &chain );
+}
+
+int main( void )
+{
+	for ( uint8_t i = 0; i < ( sizeof(testAlpha) / sizeof(testAlpha[0]) ); i++ )
+	{
+		uint32_t alpha = testAlpha[i];
+		uint32_t tolerance = ( alpha == 1 ) ? 1 : 0;
+		int32_t below = (int32_t)testSettle( alpha, TEST_FROM_BELOW ) - (int32_t)TEST_INPUT;
+		int32_t above = (int32_t)testSettle( alpha, TEST_FROM_ABOVE ) - (int32_t)TEST_INPUT;
+
+		printf( "alpha %u/65536: error from below %d, from above %d\n", alpha, below, above );
+		TEST_CHECK( (uint32_t)abs( below ) <= tolerance, "alpha %u from below: error %d", alpha, below );
+		TEST_CHECK( (uint32_t)abs( above ) <= tolerance, "alpha %u from above: error %d", alpha, above );
+	}
+	return testResult();
+}
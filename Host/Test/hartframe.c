@@ -0,0 +1,105 @@
+/* Кодек кадров HART: сборка и разбор запроса с коротким и длинным адресом, ответ с данными,
+ * контрольная сумма, мусор перед преамбулой, обрезанный кадр, неверные сумма и разделитель. */
+#include "test.h"
+
+#include "hartframe.h"
+#include "setting.h"
+#include "string.h"
+
+/* Размер буфера кадра с преамбулой. */
+#define TEST_BUFF_SIZE						( HART_PREAMBLE_TX + SIZE_HART_BUFF )
+
+const uint8_t testShortAddress[HART_SHORT_ADDR_SIZE] = { HART_ADDR_PRIMARY_MASTER | 0 };
+const uint8_t testLongAddress[HART_LONG_ADDR_SIZE] = { HART_ADDR_PRIMARY_MASTER | 0x26, 0x81, 0x10, 0x20, 0x30 };
+
+/**
+  * @brief  Кадр с преамбулой: pre байт мусора, преамбула и кадр от разделителя.
+  * @retval размер кадра в буфере.
+  */
+uint16_t testFrame( uint8_t* buff, uint8_t pre, const uint8_t* frame, uint16_t size )
+{
+	memset( buff, 0x5A, pre );
+	memset( &buff[pre], HART_PREAMBLE_BYTE, HART_PREAMBLE_TX );
+	memcpy( &buff[pre + HART_PREAMBLE_TX], frame, size );
+	return pre + HART_PREAMBLE_TX + size;
+}
+
+int main( void )
+{
+	uint8_t frame[SIZE_HART_BUFF];
+	uint8_t buff[TEST_BUFF_SIZE + 8];
+	HartFrame decoded;
+	uint16_t frameSize;
+	uint16_t size;
+
+	/* Запрос с коротким и длинным адресом: сборка, сумма и разбор обратно. */
+	for ( uint8_t isLong = 0; isLong < 2; isLong++ )
+	{
+		const uint8_t* address = isLong ? testLongAddress : testShortAddress;
+		uint8_t addressSize = isLong ? HART_LONG_ADDR_SIZE : HART_SHORT_ADDR_SIZE;
+
+		frameSize = hartFrameBuild( frame, address, addressSize, 3 );
+		TEST_CHECK( frameSize == ( addressSize + 4 ), "request size %u", frameSize );
+		TEST_CHECK( frameSize <= HART_REQUEST_SIZE, "request longer than HART_REQUEST_SIZE" );
+		TEST_CHECK( hartFrameChecksum( frame, frameSize ) == 0, "checksum of whole frame is not 0" );
+
+		size = testFrame( buff, 0, frame, frameSize );
+		TEST_CHECK( hartFrameDecode( buff, size, &decoded ) == HART_FRAME_OK, "request decode" );
+		TEST_CHECK( decoded.start == HART_PREAMBLE_TX, "start %u", decoded.start );
+		TEST_CHECK( decoded.type == HART_FRAME_STX, "type %u", decoded.type );
+		TEST_CHECK( decoded.addressSize == addressSize, "address size %u", decoded.addressSize );
+		TEST_CHECK( !memcmp( &buff[decoded.start + 1], address, addressSize ), "address" );
+		TEST_CHECK( ( decoded.command == 3 ) && ( decoded.byteCount == 0 ), "command %u, byte count %u", decoded.command, decoded.byteCount );
+		TEST_CHECK( decoded.length == ( frameSize - 1 ), "length %u", decoded.length );
+	}
+
+	/* Ответ с данными: hartFrameEncode дописывает сумму, разбор после мусора перед преамбулой. */
+	frameSize = 0;
+	frame[frameSize++] = HART_FRAME_ACK | HART_DELIMITER_LONG_ADDR;
+	memcpy( &frame[frameSize], testLongAddress, HART_LONG_ADDR_SIZE );
+	frameSize += HART_LONG_ADDR_SIZE;
+	frame[frameSize++] = 1;
+	frame[frameSize++] = 7;
+	for ( uint8_t i = 0; i < 7; i++ )
+	{
+		frame[frameSize++] = 0x10 + i;
+	}
+	TEST_CHECK( hartFrameEncode( frame, frameSize ) == ( frameSize + 1 ), "encode" );
+	TEST_CHECK( frame[frameSize] == hartFrameChecksum( frame, frameSize ), "encoded checksum" );
+	/* Счетчик байт больше, чем данных в кадре - кадр не кодируется. */
+	TEST_CHECK( hartFrameEncode( frame, frameSize - 1 ) == 0, "encode of frame shorter than byte count" );
+	frameSize++;
+
+	size = testFrame( buff, 3, frame, frameSize );
+	TEST_CHECK( hartFrameDecode( buff, size, &decoded ) == HART_FRAME_OK, "answer decode" );
+	TEST_CHECK( decoded.start == ( 3 + HART_PREAMBLE_TX ), "start after garbage %u", decoded.start );
+	TEST_CHECK( ( decoded.type == HART_FRAME_ACK ) && ( decoded.byteCount == 7 ), "answer type %u, byte count %u", decoded.type, decoded.byteCount );
+	TEST_CHECK( buff[decoded.start + decoded.dataOffset + 6] == 0x16, "answer data" );
+
+	/* Кадр, обрезанный на любом байте, - HART_FRAME_SHORT (или нет преамбулы, пока кадр не начался). */
+	for ( uint16_t cut = HART_PREAMBLE_TX + 1; cut < size; cut++ )
+	{
+		HART_FRAME_STATUS status = hartFrameDecode( buff, cut, &decoded );
+		TEST_CHECK( status == ( ( cut <= ( 3 + HART_PREAMBLE_TX ) ) ? HART_FRAME_NO_PREAMBLE : HART_FRAME_SHORT ), "cut at %u: status %u", cut, status );
+	}
+
+	/* Ошибка в любом байте от разделителя до суммы - кадр не принимается как верный. */
+	for ( uint16_t pos = decoded.start; pos < size; pos++ )
+	{
+		buff[pos] ^= 0x04;
+		TEST_CHECK( hartFrameDecode( buff, size, &decoded ) != HART_FRAME_OK, "corrupted byte %u accepted", pos );
+		buff[pos] ^= 0x04;
+	}
+	buff[size - 1] ^= 0xFF;
+	TEST_CHECK( hartFrameDecode( buff, size, &decoded ) == HART_FRAME_BAD_CHECKSUM, "bad checksum" );
+	buff[size - 1] ^= 0xFF;
+
+	/* Неизвестный тип кадра и короткая преамбула. */
+	buff[3 + HART_PREAMBLE_TX] = 0x83;
+	TEST_CHECK( hartFrameDecode( buff, size, &decoded ) == HART_FRAME_BAD_DELIMITER, "bad delimiter" );
+	memset( buff, 0x00, sizeof(buff) );
+	buff[0] = HART_PREAMBLE_BYTE;
+	memcpy( &buff[1], frame, frameSize );
+	TEST_CHECK( hartFrameDecode( buff, frameSize + 1, &decoded ) == HART_FRAME_NO_PREAMBLE, "single preamble byte" );
+	return testResult();
+}
@@ -0,0 +1,101 @@
+/* PDO4 по трассе изменений флагов мастера CAN: изменения, пришедшие за HART_PDO_INTERVAL после
+ * прошлого PDO4, объединяются в один. Кол-во PDO4 сравнивается с моделью объединения и
+ * с кол-вом изменений (столько PDO4 было бы без объединения). Устройств HART нет, флаги
+ * разрешения не выставляются - линия не меняет флаги сама. */
+#include "test.h"
+#include "sim.h"
+
+#include "moduledata.h"
+#include "setting.h"
+
+/* Флаги завершения, которые мастер выставляет и снимает в трассе. */
+#define TEST_FLAG_TX						0
+#define TEST_FLAG_RX						1
+
+/* Изменение флага мастером. */
+typedef struct TestEvent
+{
+	/* Время от начала трассы, мс. */
+	uint32_t time;
+	uint8_t flag;
+	uint8_t channel;
+	uint8_t value;
+} TestEvent;
+
+/* Трасса: пачка по всем каналам, одиночные изменения, длинная пачка раз в 1 мс
+ * и два изменения в один тик. */
+const TestEvent testTrace[] =
+{
+	{ 100, TEST_FLAG_TX, 0, 1 }, { 101, TEST_FLAG_TX, 1, 1 }, { 102, TEST_FLAG_TX, 2, 1 },
+	{ 103, TEST_FLAG_TX, 3, 1 }, { 104, TEST_FLAG_TX, 4, 1 }, { 105, TEST_FLAG_TX, 5, 1 },
+	{ 500, TEST_FLAG_RX, 0, 1 },
+	{ 700, TEST_FLAG_RX, 0, 0 },
+	{ 1000, TEST_FLAG_TX, 0, 0 }, { 1001, TEST_FLAG_RX, 1, 1 }, { 1002, TEST_FLAG_TX, 1, 0 },
+	{ 1003, TEST_FLAG_RX, 2, 1 }, { 1004, TEST_FLAG_TX, 2, 0 }, { 1005, TEST_FLAG_RX, 3, 1 },
+	{ 1006, TEST_FLAG_TX, 3, 0 }, { 1007, TEST_FLAG_RX, 4, 1 }, { 1008, TEST_FLAG_TX, 4, 0 },
+	{ 1009, TEST_FLAG_RX, 5, 1 }, { 1010, TEST_FLAG_TX, 5, 0 }, { 1011, TEST_FLAG_RX, 1, 0 },
+	{ 1012, TEST_FLAG_RX, 2, 0 }, { 1013, TEST_FLAG_RX, 3, 0 }, { 1014, TEST_FLAG_RX, 4, 0 },
+	{ 1015, TEST_FLAG_RX, 5, 0 }, { 1016, TEST_FLAG_TX, 0, 1 }, { 1017, TEST_FLAG_TX, 0, 0 },
+	{ 1500, TEST_FLAG_TX, 3, 1 }, { 1500, TEST_FLAG_RX, 3, 1 },
+};
+
+#define TEST_TRACE_SIZE						( sizeof(testTrace) / sizeof(testTrace[0]) )
+/* Длительность трассы с запасом на последний PDO4, мс. */
+#define TEST_TRACE_TIME						2000
+
+/**
+  * @brief  Выставление флага мастером.
+  * @retval 1 - значение флага изменилось.
+  */
+uint8_t testApply( const TestEvent* event )
+{
+	uint8_t* flags = ( event->flag == TEST_FLAG_TX ) ? userData.hartFlagTxCompleted : userData.hartFlagRxCompleted;
+	uint8_t isChanged = flags[event->channel] != event->value;
+
+	flags[event->channel] = event->value;
+	return isChanged;
+}
+
+int main( void )
+{
+	uint32_t changes = 0;
+	uint32_t expected = 0;
+	uint32_t pdoStart;
+	uint32_t pdo;
+	uint32_t event = 0;
+	/* Модель объединения: изменение ждет PDO4, PDO4 не чаще HART_PDO_INTERVAL */
+	uint8_t isPending = 0;
+	uint32_t lastPdo = 0;
+	uint8_t isSent = 0;
+
+	simFlashClear();
+	simBoot();
+	simMain( 1000000 );
+	pdoStart = simGetPdoCount();
+
+	for ( uint32_t time = 0; time < TEST_TRACE_TIME; time++ )
+	{
+		for ( ; ( event < TEST_TRACE_SIZE ) && ( testTrace[event].time == time ); event++ )
+		{
+			if ( testApply( &testTrace[event] ) )
+			{
+				changes++;
+				isPending = 1;
+			}
+		}
+		if ( isPending && ( !isSent || ( ( time - lastPdo ) >= HART_PDO_INTERVAL ) ) )
+		{
+			isPending = 0;
+			isSent = 1;
+			lastPdo = time;
+			expected++;
+		}
+		simMain( 1000 );
+	}
+	pdo = simGetPdoCount() - pdoStart;
+
+	printf( "flag changes: %u, PDO4 sent: %u, expected: %u\n", changes, pdo, expected );
+	TEST_CHECK( pdo == expected, "PDO4 %u, expected %u", pdo, expected );
+	TEST_CHECK( pdo < changes, "PDO4 %u not coalesced, changes %u", pdo, changes );
+	return testResult();
+}
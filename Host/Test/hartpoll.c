@@ -0,0 +1,142 @@
+/* Циклический опрос HART на модели линии 1200 бод: пропускная способность (транзакций в секунду),
+ * приоритет устройства в аварии без голодания остальных, экспоненциальное увеличение таймаута при молчании устройства
+ * и возврат к измеренному времени ответа, таймаут канала без устройства. */
+#include "test.h"
+#include "sim.h"
+
+#include "hart.h"
+#include "setting.h"
+
+/* Канал устройства в аварии. */
+#define TEST_ALARM_CH						2
+/* Канал без устройства. */
+#define TEST_EMPTY_CH						5
+/* Время на поиск устройств и окно замера, мкс. */
+#define TEST_WARMUP_US						20000000
+#define TEST_WINDOW_US						60000000
+/* Канал, устройство которого замолкает, и кол-во пропущенных им ответов. */
+#define TEST_SILENT_CH						0
+#define TEST_SILENT_CNT						3
+/* Шаг ожидания событий, мкс. */
+#define TEST_POLL_STEP_US					10000
+
+/**
+  * @brief  Сумма транзакций всех каналов.
+  */
+uint32_t testTransactions( uint32_t* channelCnt )
+{
+	uint32_t sum = 0;
+	uint32_t timeouts;
+	uint32_t errors;
+
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		hartGetStatistics( ch, &channelCnt[ch], &timeouts, &errors );
+		sum += channelCnt[ch];
+	}
+	return sum;
+}
+
+/**
+  * @brief  Работа прошивки, пока на канале не наберется count таймаутов (не дольше limitUs).
+  * @retval Таймаут канала, тиков.
+  */
+uint8_t testWaitTimeouts( uint8_t channel, uint32_t count, uint32_t limitUs )
+{
+	uint32_t transactions;
+	uint32_t timeouts;
+	uint32_t errors;
+	uint8_t timeout = hartGetStatistics( channel, &transactions, &timeouts, &errors );
+
+	for ( uint32_t time = 0; ( timeouts < count ) && ( time < limitUs ); time += TEST_POLL_STEP_US )
+	{
+		simMain( TEST_POLL_STEP_US );
+		timeout = hartGetStatistics( channel, &transactions, &timeouts, &errors );
+	}
+	TEST_CHECK( timeouts >= count, "channel %u: %u timeouts, expected %u", channel + 1, timeouts, count );
+	return timeout;
+}
+
+int main( void )
+{
+	SimHartDevice device = { 1, { 0x26, 0x81, 0x10, 0x20, 0x30 }, 0, 8, 30000, 0 };
+	uint32_t start[AI_CH_NUM];
+	uint32_t end[AI_CH_NUM];
+	uint32_t startSum;
+	uint32_t endSum;
+	uint32_t transactions;
+	uint32_t timeouts;
+	uint32_t errors;
+	uint32_t others = 0;
+	uint32_t answers;
+	uint8_t timeout;
+	uint8_t measured;
+	uint8_t data[HART_CACHE_DATA_SIZE];
+	uint8_t size;
+	uint32_t age;
+	double tps;
+
+	simFlashClear();
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		device.isPresent = ( ch != TEST_EMPTY_CH );
+		device.address[4] = ch;
+		device.status = ( ch == TEST_ALARM_CH ) ? 0x01 : 0;
+		simHartSetDevice( ch, &device );
+	}
+	simBoot();
+	simMain( TEST_WARMUP_US );
+
+	/* Пропускная способность и доля устройства в аварии */
+	startSum = testTransactions( start );
+	simMain( TEST_WINDOW_US );
+	endSum = testTransactions( end );
+
+	tps = ( endSum - startSum ) / ( TEST_WINDOW_US / 1e6 );
+	printf( "HART transactions/sec: %.2f\n", tps );
+	TEST_CHECK( tps > 0, "no transactions" );
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		timeout = hartGetStatistics( ch, &transactions, &timeouts, &errors );
+		printf( "channel %u: %u transactions in window, %u timeouts, %u errors, timeout %u ticks\n",
+				ch + 1, end[ch] - start[ch], timeouts, errors, timeout );
+		if ( ch == TEST_EMPTY_CH )
+		{
+			TEST_CHECK( timeout == HART_TIMEOUT_MAX, "empty channel timeout %u", timeout );
+			continue;
+		}
+		/* Линия занята полностью, цикл опроса длиннее HART_CACHE_STALE_TIME: кэш должен обновляться в окне */
+		TEST_CHECK( ( hartGetCache( ch, 1, data, &size, &age ) != HART_CACHE_EMPTY ) && ( age < ( TEST_WINDOW_US / 1000 ) ),
+				"channel %u cache age %u ms", ch + 1, age );
+		TEST_CHECK( errors == 0, "channel %u errors %u", ch + 1, errors );
+		TEST_CHECK( end[ch] > start[ch], "channel %u starved", ch + 1 );
+		if ( ch != TEST_ALARM_CH )
+		{
+			others += end[ch] - start[ch];
+		}
+	}
+	/* Остальные устройства делят линию, устройство в аварии опрашивается чаще каждого из них */
+	TEST_CHECK( ( end[TEST_ALARM_CH] - start[TEST_ALARM_CH] ) * ( AI_CH_NUM - 2 ) > others,
+			"alarm channel %u transactions, others %u", end[TEST_ALARM_CH] - start[TEST_ALARM_CH], others );
+
+	/* Молчание устройства: таймаут удваивается на каждый пропущенный ответ */
+	measured = hartGetStatistics( TEST_SILENT_CH, &transactions, &timeouts, &errors );
+	simHartGetDevice( TEST_SILENT_CH )->silentCnt = TEST_SILENT_CNT;
+	timeout = testWaitTimeouts( TEST_SILENT_CH, timeouts + TEST_SILENT_CNT, TEST_WINDOW_US );
+	printf( "silent channel %u: timeout %u -> %u ticks\n", TEST_SILENT_CH + 1, measured, timeout );
+	TEST_CHECK( timeout == ( ( ( measured << TEST_SILENT_CNT ) < HART_TIMEOUT_MAX ) ? ( measured << TEST_SILENT_CNT ) : HART_TIMEOUT_MAX ),
+			"backoff timeout %u", timeout );
+
+	/* Первый же ответ возвращает таймаут к измеренному времени ответа */
+	answers = simHartGetAnswerCount( TEST_SILENT_CH );
+	for ( uint32_t time = 0; ( simHartGetAnswerCount( TEST_SILENT_CH ) == answers ) && ( time < TEST_WINDOW_US ); time += TEST_POLL_STEP_US )
+	{
+		simMain( TEST_POLL_STEP_US );
+	}
+	simMain( TEST_POLL_STEP_US );
+	timeout = hartGetStatistics( TEST_SILENT_CH, &transactions, &timeouts, &errors );
+	printf( "silent channel %u: timeout after answer %u ticks\n", TEST_SILENT_CH + 1, timeout );
+	TEST_CHECK( ( timeout + 1 ) >= measured && timeout <= ( measured + 1 ), "timeout after answer %u, measured %u", timeout, measured );
+
+	return testResult();
+}
@@ -0,0 +1,157 @@
+/* Прием HART по кольцу DMA: кадр, закончившийся ровно на конце кольца (события IDLE нет,
+ * кадр закрывает пауза HART_FRAME_END_TIMEOUT), и ошибка UART в окне приема (транзакция
+ * завершается сразу с ошибкой, без таймаута, прием по кольцу запускается заново). */
+#include "test.h"
+#include "sim.h"
+
+#include "main.h"
+#include "hart.h"
+#include "setting.h"
+
+/* Канал устройства. */
+#define TEST_CH								0
+/* Размер ответа на циклическую команду без данных: преамбула, разделитель, длинный адрес,
+ * команда, счетчик, статус и контрольная сумма. */
+#define TEST_ANSWER_SIZE					( SIM_HART_PREAMBLE + 1 + 5 + 1 + 1 + 2 + 1 )
+/* Наибольший размер данных ответа при подгонке к концу кольца. */
+#define TEST_DATA_MAX						64
+/* Время на подгонку и ожидание событий, мкс. */
+#define TEST_LIMIT_US						60000000
+
+/**
+  * @brief  Работа прошивки, пока модуль не закончит передачу запроса устройству TEST_CH
+  *         (модем переключен на прием этого канала).
+  * @retval 1 - запрос передан, 0 - не дождались.
+  */
+uint8_t testWaitRequest( void )
+{
+	uint32_t txBytes = simUartGetTxBytes();
+
+	for ( uint32_t time = 0; time < TEST_LIMIT_US; time += SIM_STEP_US )
+	{
+		simMain( SIM_STEP_US );
+		if ( ( simUartGetTxBytes() != txBytes ) && ( UART_RTS_GPIO_Port->ODR & UART_RTS_Pin ) )
+		{
+			if ( simHartChannel() == TEST_CH )
+			{
+				return 1;
+			}
+			txBytes = simUartGetTxBytes();
+		}
+	}
+	return 0;
+}
+
+/**
+  * @brief  Поиск команды, ответ на которую сохранен в кэш последним.
+  */
+uint8_t testLastCommand( uint8_t* size )
+{
+	uint8_t data[HART_CACHE_DATA_SIZE];
+	uint32_t age;
+	uint32_t best = UINT32_MAX;
+	uint8_t command = 0;
+	uint8_t commandSize;
+
+	for ( uint8_t i = 1; i <= 3; i++ )
+	{
+		if ( ( hartGetCache( TEST_CH, i, data, &commandSize, &age ) != HART_CACHE_EMPTY ) && ( age < best ) )
+		{
+			best = age;
+			command = i;
+			*size = commandSize;
+		}
+	}
+	return command;
+}
+
+/**
+  * @brief  Ответ, который заканчивается ровно на конце кольца: размер данных подгоняется под
+  *         свободное место до конца кольца, пока устройство выдерживает паузу перед ответом.
+  */
+void testRingEnd( void )
+{
+	SimHartDevice* device = simHartGetDevice( TEST_CH );
+	uint32_t transactions;
+	uint32_t timeouts;
+	uint32_t errors;
+	uint32_t transactionsBefore;
+	uint32_t timeoutsBefore;
+	uint32_t errorsBefore;
+	uint16_t remain;
+	uint8_t size;
+	uint8_t isDone = 0;
+
+	for ( uint32_t i = 0; ( i < 100 ) && !isDone; i++ )
+	{
+		TEST_CHECK( testWaitRequest(), "no request" );
+		remain = HART_RING_SIZE - simUartGetRingHead();
+		isDone = ( remain >= TEST_ANSWER_SIZE ) && ( ( remain - TEST_ANSWER_SIZE ) <= TEST_DATA_MAX );
+		device->dataSize = isDone ? ( remain - TEST_ANSWER_SIZE ) : TEST_DATA_MAX;
+		hartGetStatistics( TEST_CH, &transactionsBefore, &timeoutsBefore, &errorsBefore );
+
+		/* Ответ: пауза, байты и пауза конца кадра */
+		simMain( device->latencyUs + ( TEST_ANSWER_SIZE + device->dataSize ) * SIM_UART_BYTE_US
+				+ ( HART_FRAME_END_TIMEOUT + 2 ) * SIM_TIM5_PERIOD_US );
+	}
+	TEST_CHECK( isDone, "answer was not aligned to the ring end" );
+	hartGetStatistics( TEST_CH, &transactions, &timeouts, &errors );
+	printf( "ring end: %u data bytes, ring head %u\n", device->dataSize, simUartGetRingHead() );
+	TEST_CHECK( simUartGetRingHead() == 0, "ring head %u", simUartGetRingHead() );
+	TEST_CHECK( transactions == ( transactionsBefore + 1 ), "transactions %u -> %u", transactionsBefore, transactions );
+	TEST_CHECK( ( timeouts == timeoutsBefore ) && ( errors == errorsBefore ), "timeouts %u, errors %u", timeouts, errors );
+	TEST_CHECK( testLastCommand( &size ) && ( size == ( 2 + device->dataSize ) ), "cache size %u", size );
+}
+
+/**
+  * @brief  Ошибка UART в окне приема до ответа устройства.
+  */
+void testError( void )
+{
+	SimHartDevice* device = simHartGetDevice( TEST_CH );
+	uint32_t transactions;
+	uint32_t timeouts;
+	uint32_t errors;
+	uint32_t transactionsBefore;
+	uint32_t timeoutsBefore;
+	uint32_t errorsBefore;
+
+	device->dataSize = 8;
+	TEST_CHECK( testWaitRequest(), "no request" );
+	hartGetStatistics( TEST_CH, &transactionsBefore, &timeoutsBefore, &errorsBefore );
+	simUartError();
+	hartGetStatistics( TEST_CH, &transactions, &timeouts, &errors );
+	TEST_CHECK( errors == ( errorsBefore + 1 ), "errors %u -> %u", errorsBefore, errors );
+	TEST_CHECK( simUartGetRingHead() == 0, "ring not restarted, head %u", simUartGetRingHead() );
+
+	/* Ответ на прерванный запрос транзакции уже не достается, таймаута нет */
+	simMain( device->latencyUs + ( TEST_ANSWER_SIZE + device->dataSize ) * SIM_UART_BYTE_US
+			+ ( HART_FRAME_END_TIMEOUT + 2 ) * SIM_TIM5_PERIOD_US );
+	hartGetStatistics( TEST_CH, &transactions, &timeouts, &errors );
+	TEST_CHECK( transactions == transactionsBefore, "transactions %u -> %u", transactionsBefore, transactions );
+	TEST_CHECK( ( timeouts == timeoutsBefore ) && ( errors == ( errorsBefore + 1 ) ), "timeouts %u, errors %u", timeouts, errors );
+
+	/* Прием по кольцу работает дальше */
+	simMain( 10000000 );
+	hartGetStatistics( TEST_CH, &transactions, &timeouts, &errors );
+	TEST_CHECK( transactions > transactionsBefore, "no transactions after error" );
+	TEST_CHECK( ( timeouts == timeoutsBefore ) && ( errors == ( errorsBefore + 1 ) ), "timeouts %u, errors %u", timeouts, errors );
+}
+
+int main( void )
+{
+	SimHartDevice device = { 1, { 0x26, 0x81, 0x10, 0x20, 0x30 }, 0, 5, 30000, 0 };
+	uint8_t data[HART_CACHE_DATA_SIZE];
+	uint8_t size;
+	uint32_t age;
+
+	simFlashClear();
+	simHartSetDevice( TEST_CH, &device );
+	simBoot();
+	simMain( 10000000 );
+	TEST_CHECK( hartGetCache( TEST_CH, 1, data, &size, &age ) == HART_CACHE_VALID, "device not found" );
+
+	testRingEnd();
+	testError();
+	return testResult();
+}
@@ -0,0 +1,180 @@
+/* Пропадание питания при добавлении записи журнала: на каждом шаге записи (очистка сектора,
+ * запись слота) и при любой доле выполненной операции после перезапуска загружается последняя
+ * или предыдущая запись целиком, а следующая запись добавляется и загружается.
+ * Слот, который записался с ошибкой, обнаруживается чтением обратно: добавление возвращает
+ * JOURNAL_ERROR, следующая запись идет в следующий слот. */
+#include "test.h"
+#include "sim.h"
+
+#include "journal.h"
+#include "flash.h"
+#include "string.h"
+
+/* Размер данных записи. */
+#define TEST_RECORD_SIZE					32
+/* Максимальное кол-во шагов модели на операцию журнала. */
+#define TEST_STEP_MAX						100000
+/* Записи, при добавлении которых пропадает питание: первая, внутри сектора, переход в сектор,
+ * переход через конец журнала со стиранием самого старого сектора. */
+const uint32_t testRecord[] = { 1, 2, JOURNAL_SECTOR_SLOTS + 1, JOURNAL_SECTOR_SLOTS + 2, JOURNAL_SLOT_NUM + 1, 2 * JOURNAL_SLOT_NUM + 3 };
+/* Кол-во выполненных байт операции при пропадании питания. */
+const uint16_t testDone[] = { 0, 1, 16, 24, TEST_RECORD_SIZE, 2048, SIM_FLASH_SECTOR_SIZE };
+
+uint8_t testBase[SIM_FLASH_SIZE];
+
+/**
+  * @brief  Данные записи number.
+  */
+void testFill( uint8_t* data, uint32_t number )
+{
+	for ( uint16_t i = 0; i < TEST_RECORD_SIZE; i++ )
+	{
+		data[i] = number * 7 + i;
+	}
+	memcpy( data, &number, sizeof(number) );
+}
+
+/**
+  * @brief  Возврат флешки к снимку testBase: незавершенная операция отменяется.
+  */
+void testRestore( void )
+{
+	simFlashPowerCut( 0 );
+	simFlashPowerOn();
+	memcpy( simFlashMemory(), testBase, SIM_FLASH_SIZE );
+}
+
+/**
+  * @brief  Загрузка журнала после перезапуска.
+  * @retval номер загруженной записи, 0 - журнал пуст, -1 - ошибка.
+  */
+int64_t testLoad( void )
+{
+	uint8_t data[TEST_RECORD_SIZE];
+	uint8_t expected[TEST_RECORD_SIZE];
+	uint32_t number;
+	JOURNAL_STATUS status = JOURNAL_AT_WORK;
+
+	journalReset();
+	for ( uint32_t step = 0; ( status == JOURNAL_AT_WORK ) && ( step < TEST_STEP_MAX ); step++ )
+	{
+		status = journalLoad( data, sizeof(data) );
+		simRun( SIM_STEP_US );
+	}
+	if ( status == JOURNAL_EMPTY )
+	{
+		return 0;
+	}
+	if ( status != JOURNAL_DONE )
+	{
+		return -1;
+	}
+	memcpy( &number, data, sizeof(number) );
+	testFill( expected, number );
+	return memcmp( data, expected, sizeof(data) ) ? -1 : (int64_t)number;
+}
+
+/**
+  * @brief  Добавление записи number, не больше steps шагов модели.
+  * @retval статус последнего вызова journalAppend.
+  */
+JOURNAL_STATUS testAppend( uint32_t number, uint32_t steps )
+{
+	uint8_t data[TEST_RECORD_SIZE];
+	JOURNAL_STATUS status = JOURNAL_AT_WORK;
+
+	testFill( data, number );
+	for ( uint32_t step = 0; ( status == JOURNAL_AT_WORK ) && ( step < steps ); step++ )
+	{
+		status = journalAppend( data, sizeof(data) );
+		simRun( SIM_STEP_US );
+	}
+	return status;
+}
+
+int main( void )
+{
+	uint32_t number = 0;
+	uint32_t cutCnt = 0;
+	/* Кол-во сбоев, после которых загружена новая запись. */
+	uint32_t newCnt = 0;
+	uint32_t steps;
+	uint32_t writeCnt;
+	uint32_t eraseCnt;
+	uint32_t key;
+	uint32_t lastKey;
+	int64_t loaded;
+
+	simReset();
+	simFlashClear();
+	TEST_CHECK( testLoad() == 0, "journal is not empty" );
+
+	for ( uint8_t i = 0; i < ( sizeof(testRecord) / sizeof(testRecord[0]) ); i++ )
+	{
+		/* Записи до проверяемой - без сбоев. */
+		while ( ( number + 1 ) < testRecord[i] )
+		{
+			TEST_CHECK( testAppend( ++number, TEST_STEP_MAX ) == JOURNAL_DONE, "append %u", number );
+		}
+		memcpy( testBase, simFlashMemory(), SIM_FLASH_SIZE );
+		/* Запись заново с перезапуска на каждом шаге, питание пропадает на шагах, где меняется операция флешки. */
+		lastKey = 0xFFFFFFFF;
+		for ( steps = 1; ; steps++ )
+		{
+			testRestore();
+			TEST_CHECK( testLoad() == number, "load before %u", number + 1 );
+			writeCnt = simFlashGetWriteCount();
+			eraseCnt = simFlashGetEraseCount();
+			if ( testAppend( number + 1, steps ) != JOURNAL_AT_WORK )
+			{
+				break;
+			}
+			key = ( ( simFlashGetWriteCount() - writeCnt ) << 8 ) | ( ( simFlashGetEraseCount() - eraseCnt ) << 4 ) | flashGetStatus();
+			if ( key == lastKey )
+			{
+				continue;
+			}
+			lastKey = key;
+
+			for ( uint8_t done = 0; done < ( sizeof(testDone) / sizeof(testDone[0]) ); done++ )
+			{
+				testRestore();
+				testLoad();
+				testAppend( number + 1, steps );
+				simFlashPowerCut( testDone[done] );
+				simFlashPowerOn();
+				cutCnt++;
+
+				loaded = testLoad();
+				TEST_CHECK( ( loaded == number ) || ( loaded == ( number + 1 ) ),
+						"record %u, step %u, done %u: loaded %lld", number + 1, steps, testDone[done], (long long)loaded );
+				newCnt += ( loaded == ( number + 1 ) );
+				/* Журнал после сбоя пишется дальше. */
+				TEST_CHECK( testAppend( number + 2, TEST_STEP_MAX ) == JOURNAL_DONE, "append after cut" );
+				loaded = testLoad();
+				TEST_CHECK( loaded == ( number + 2 ), "record %u, step %u, done %u: next loaded %lld",
+						number + 1, steps, testDone[done], (long long)loaded );
+			}
+		}
+		testRestore();
+		testLoad();
+		TEST_CHECK( testAppend( number + 1, TEST_STEP_MAX ) == JOURNAL_DONE, "append %u", number + 1 );
+		TEST_CHECK( testLoad() == ( number + 1 ), "record %u without cut", number + 1 );
+		number++;
+	}
+	/* Байт заголовка и байт данных не записались */
+	for ( uint8_t i = 0; i < 2; i++ )
+	{
+		simFlashWriteFault( i ? ( sizeof(JournalHeader) + 1 ) : 0 );
+		TEST_CHECK( testAppend( number + 1, TEST_STEP_MAX ) == JOURNAL_ERROR, "bad slot %u not detected", i );
+		TEST_CHECK( testAppend( number + 2, TEST_STEP_MAX ) == JOURNAL_DONE, "append after bad slot %u", i );
+		loaded = testLoad();
+		TEST_CHECK( loaded == ( number + 2 ), "after bad slot %u loaded %lld", i, (long long)loaded );
+		number += 2;
+	}
+
+	printf( "power cuts: %u, new record loaded: %u\n", cutCnt, newCnt );
+	/* Сбои попали и на незавершенную запись, и после нее. */
+	TEST_CHECK( ( newCnt > 0 ) && ( newCnt < cutCnt ), "all cuts gave the same record" );
+	return testResult();
+}
@@ -0,0 +1,122 @@
+/* Передачи на расширитель XL9535 по модели I2C: одинаковые кадры не передаются, изменения
+ * за LED_DELAY_TRANSMIT уходят одной передачей, мигание - передача на каждую смену состояния,
+ * после NACK кадр передается заново до подтверждения. */
+#include "test.h"
+#include "sim.h"
+
+#include "led.h"
+#include "setting.h"
+
+/* Кол-во проходов ledProcess с одинаковым кадром. */
+#define TEST_FRAMES							1000
+/* Выходы расширителя при всех зеленых и всех красных диодах каналов: бит цвета 0 - порт 0, бит 1 - порт 1. */
+#define TEST_PORT0_GREEN					0x3F
+#define TEST_PORT1_GREEN					0x00
+#define TEST_PORT0_RED						0x00
+#define TEST_PORT1_RED						0x3F
+
+/**
+  * @brief  Проходы ledProcess с периодом задачи планировщика.
+  * @param  passes:	кол-во проходов.
+  * @param  periodUs:	время между проходами, мкс.
+  */
+void testRun( uint32_t passes, uint32_t periodUs )
+{
+	for ( uint32_t i = 0; i < passes; i++ )
+	{
+		ledProcess();
+		simRun( periodUs );
+	}
+}
+
+/**
+  * @brief  Одинаковые кадры: после первой передачи шина не занимается.
+  */
+void testIdentical( void )
+{
+	uint32_t txCnt;
+
+	for ( uint8_t type = LED_CH1; type <= LED_CH6; type++ )
+	{
+		setLedMode( type, MODE_ON, COLOR_GREEN );
+	}
+	testRun( 1, SCHED_PERIOD_LED * 1000 );
+	txCnt = simI2cGetTxCount();
+	testRun( TEST_FRAMES, SCHED_PERIOD_LED * 1000 );
+	printf( "identical frames: %u passes, %u writes in total\n", TEST_FRAMES + 1, simI2cGetTxCount() );
+	TEST_CHECK( txCnt == 1, "first frame: %u writes", txCnt );
+	TEST_CHECK( simI2cGetTxCount() == txCnt, "%u writes for identical frames", simI2cGetTxCount() - txCnt );
+	TEST_CHECK( ledGetTxCount() == simI2cGetTxCount(), "module counted %u writes", ledGetTxCount() );
+	TEST_CHECK( ( simI2cGetOutput()[0] == TEST_PORT0_GREEN ) && ( simI2cGetOutput()[1] == TEST_PORT1_GREEN ),
+			"output %02X %02X", simI2cGetOutput()[0], simI2cGetOutput()[1] );
+}
+
+/**
+  * @brief  Смена цвета всех каналов с шагом 1 мс: первая смена передается сразу,
+  *         остальные - одной передачей через LED_DELAY_TRANSMIT.
+  */
+void testMerge( void )
+{
+	uint32_t txCnt = simI2cGetTxCount();
+
+	for ( uint8_t type = LED_CH1; type <= LED_CH6; type++ )
+	{
+		setLedMode( type, MODE_ON, COLOR_RED );
+		testRun( 1, 1000 );
+	}
+	testRun( 2 * LED_DELAY_TRANSMIT, 1000 );
+	printf( "merged changes: %u writes\n", simI2cGetTxCount() - txCnt );
+	TEST_CHECK( ( simI2cGetTxCount() - txCnt ) == 2, "%u writes for merged changes", simI2cGetTxCount() - txCnt );
+	TEST_CHECK( ( simI2cGetOutput()[0] == TEST_PORT0_RED ) && ( simI2cGetOutput()[1] == TEST_PORT1_RED ),
+			"output %02X %02X", simI2cGetOutput()[0], simI2cGetOutput()[1] );
+}
+
+/**
+  * @brief  Мигание 200/200 мс: передача только на смену состояния.
+  */
+void testBlink( void )
+{
+	uint32_t txCnt;
+
+	setLedMode( LED_CH1, MODE_BLINK, COLOR_RED );
+	testRun( 1, SCHED_PERIOD_LED * 1000 );
+	txCnt = simI2cGetTxCount();
+	testRun( 2000 / SCHED_PERIOD_LED, SCHED_PERIOD_LED * 1000 );
+	printf( "blink 2 s: %u writes\n", simI2cGetTxCount() - txCnt );
+	TEST_CHECK( ( simI2cGetTxCount() - txCnt ) == ( 2000 / 200 ), "%u writes for blink", simI2cGetTxCount() - txCnt );
+	setLedMode( LED_CH1, MODE_ON, COLOR_RED );
+	testRun( 2, SCHED_PERIOD_LED * 1000 );
+}
+
+/**
+  * @brief  NACK: кадр повторяется, пока расширитель его не подтвердит, затем шина свободна.
+  */
+void testNack( void )
+{
+	uint32_t txCnt = simI2cGetTxCount();
+
+	simI2cSetNack( 1 );
+	setLedMode( LED_CH2, MODE_ON, COLOR_GREEN );
+	testRun( 10, SCHED_PERIOD_LED * 1000 );
+	TEST_CHECK( ( simI2cGetTxCount() - txCnt ) >= 2, "%u writes while NACK", simI2cGetTxCount() - txCnt );
+
+	simI2cSetNack( 0 );
+	testRun( 2, SCHED_PERIOD_LED * 1000 );
+	txCnt = simI2cGetTxCount();
+	testRun( TEST_FRAMES, SCHED_PERIOD_LED * 1000 );
+	TEST_CHECK( simI2cGetTxCount() == txCnt, "%u writes after ACK", simI2cGetTxCount() - txCnt );
+	TEST_CHECK( simI2cGetOutput()[0] & ( 1 << 1 ), "output %02X %02X", simI2cGetOutput()[0], simI2cGetOutput()[1] );
+}
+
+int main( void )
+{
+	simReset();
+	simSetTick( 1000 );
+	ledInit();
+
+	testIdentical();
+	testMerge();
+	testBlink();
+	testNack();
+	return testResult();
+}
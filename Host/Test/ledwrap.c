@@ -0,0 +1,53 @@
+/* Мигание диода канала через переполнение HAL_GetTick: фаза шаблона накапливается по разности
+ * тиков, поэтому шаги 200/200 мс не сбиваются, когда счетчик проходит через 0. */
+#include "test.h"
+#include "sim.h"
+
+#include "led.h"
+#include "setting.h"
+
+/* Тик до переполнения при запуске мигания, мс. */
+#define TEST_TICK_BEFORE_WRAP				1000
+/* Время записи, мс. */
+#define TEST_TIME							3000
+/* Шаг мигания MODE_BLINK, мс. */
+#define TEST_BLINK_STEP						200
+
+int main( void )
+{
+	uint8_t state;
+	uint8_t lastState;
+	uint32_t lastChange = 0;
+	uint32_t changes = 0;
+
+	simReset();
+	simSetTick( (uint32_t)( 0 - TEST_TICK_BEFORE_WRAP ) );
+	ledInit();
+	setLedMode( LED_CH1, MODE_BLINK, COLOR_GREEN );
+	ledProcess();
+	simRun( SCHED_PERIOD_LED * 1000 );
+	lastState = simI2cGetOutput()[1] & 1;
+
+	for ( uint32_t time = SCHED_PERIOD_LED; time < TEST_TIME; time += SCHED_PERIOD_LED )
+	{
+		ledProcess();
+		simRun( SCHED_PERIOD_LED * 1000 );
+		state = simI2cGetOutput()[1] & 1;
+		if ( state == lastState )
+		{
+			continue;
+		}
+		/* Между сменами - шаг шаблона с точностью до периода задачи, в том числе через переполнение */
+		if ( changes )
+		{
+			TEST_CHECK( ( ( time - lastChange ) + SCHED_PERIOD_LED >= TEST_BLINK_STEP ) && ( ( time - lastChange ) <= TEST_BLINK_STEP + SCHED_PERIOD_LED ),
+					"step %u ms at %u ms", time - lastChange, time );
+		}
+		lastChange = time;
+		lastState = state;
+		changes++;
+	}
+	printf( "blink across tick wrap: %u changes in %u ms\n", changes, TEST_TIME );
+	TEST_CHECK( ( changes + 1 ) >= ( TEST_TIME / TEST_BLINK_STEP ), "%u changes", changes );
+	return testResult();
+}
@@ -0,0 +1,38 @@
+/* Запуск прошивки на модели: модули инициализируются, планировщик крутит все задачи,
+ * АЦП сканируется, HART-устройство канала 1 находится поиском (первый - через HART_DISCOVERY_PERIOD)
+ * и опрашивается циклическими командами. */
+#include "test.h"
+#include "sim.h"
+
+#include "sched.h"
+#include "hart.h"
+#include "setting.h"
+
+int main( void )
+{
+	SimHartDevice device = { 1, { 0x26, 0x81, 0x10, 0x20, 0x30 }, 0, 4, 20000, 0 };
+	SchedStat stat;
+	uint32_t transactions;
+	uint32_t timeouts;
+	uint32_t errors;
+	uint8_t data[HART_CACHE_DATA_SIZE];
+	uint8_t size;
+	uint32_t age;
+
+	simFlashClear();
+	simHartSetDevice( 0, &device );
+	simBoot();
+	simMain( 10000000 );
+
+	for ( uint8_t task = 0; task < SCHED_TASK_NUM; task++ )
+	{
+		TEST_CHECK( schedGetStat( task, &stat ) && stat.runCnt, "task %u did not run", task );
+	}
+	hartGetStatistics( 0, &transactions, &timeouts, &errors );
+	TEST_CHECK( simHartGetAnswerCount( 0 ) > 0, "device was not polled" );
+	TEST_CHECK( transactions > 0, "transactions %u, timeouts %u, errors %u", transactions, timeouts, errors );
+	TEST_CHECK( errors == 0, "errors %u", errors );
+	TEST_CHECK( hartGetCache( 0, 1, data, &size, &age ) == HART_CACHE_VALID, "no cyclic answer in cache" );
+	TEST_CHECK( size == 2 + device.dataSize, "cache size %u", size );
+	return testResult();
+}
@@ -0,0 +1,28 @@
+/* Проверки тестов Host/Test: тест печатает нарушенные условия и возвращает testResult() из main. */
+#ifndef TEST_TEST_H_
+#define TEST_TEST_H_
+
+#include <stdio.h>
+
+/* Кол-во нарушенных условий. */
+static int testFailCnt = 0;
+
+#define TEST_CHECK( cond, ... )												\
+	do																		\
+	{																		\
+		if ( !( cond ) )													\
+		{																	\
+			testFailCnt++;													\
+			printf( "FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond );		\
+			printf( __VA_ARGS__ );											\
+			printf( "\n" );												\
+		}																	\
+	} while ( 0 )
+
+static inline int testResult( void )
+{
+	printf( "%s\n", testFailCnt ? "FAILED" : "PASSED" );
+	return testFailCnt ? 1 : 0;
+}
+
+#endif /* TEST_TEST_H_ */
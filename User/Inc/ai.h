@@ -3,7 +3,50 @@
 #ifndef INC_AI_H_
 #define INC_AI_H_
 
+#include "filter.h"
+
+/* Замер скорости выборок и отклика канала на скачок входного тока. */
+typedef struct AiBenchStat
+{
+	/* Выходных выборок цепочки фильтров в секунду за последнее окно AI_BENCH_WINDOW. */
+	uint32_t sampleRate;
+	/* Кол-во замеренных скачков. */
+	uint32_t stepCnt;
+	/* Время от скачка в сырых выборках до 63% и 90% скачка в отфильтрованном токе, последний замер, мс. */
+	uint32_t latency63;
+	uint32_t latency90;
+} AiBenchStat;
+
+/* Биты статуса диагностики канала. Биты состояния идут по возрастанию тока. */
+typedef enum
+{
+	AI_DIAG_FALL	= 0x01,	// Обрыв линии (ниже 3.6 мА)
+	AI_DIAG_UNDER	= 0x02,	// Насыщение снизу (3.6..3.8 мА)
+	AI_DIAG_OK		= 0x04,	// Ток в диапазоне измерения (3.8..20.5 мА)
+	AI_DIAG_OVER	= 0x08,	// Насыщение сверху (20.5..21 мА)
+	AI_DIAG_KZ		= 0x10,	// КЗ (21 мА и выше)
+	AI_DIAG_PENDING	= 0x80,	// Ток вышел из зоны текущего состояния, идет подтверждение
+} AI_DIAG_STATUS;
+
 void aiInit( void );
 void aiProcess( void );
+/* Шаг сканирования АЦП, вызывается из прерывания таймера.
+ * Частота выборок одного канала = частота вызова / AI_CH_NUM.
+ * В main.c: после aiInit запустить TIM2 (HAL_TIM_Base_Start_IT( &htim2 )) и вызывать aiScanTick
+ * из HAL_TIM_PeriodElapsedCallback для htim2. Завершение обмена приходит через HAL_SPI_TxRxCpltCallback
+ * (usercallback.c), прерывания DMA SPI1 должны быть включены. */
+void aiScanTick( void );
+/* Результат калибровки точки ma (4..20) канала: среднее, СКО, кол-во выборок.
+ * Возвращает 0, если точка шумная. */
+uint8_t aiGetCalibrationPoint( uint8_t channel, uint8_t ma, uint16_t* adcValue, float* std, uint32_t* count );
+/* Статус набора текущей точки калибровки канала и кол-во набранных выборок. */
+uint8_t aiGetCalibrationStatus( uint8_t channel, uint32_t* count );
+/* Отклонение точки калибровки от полинома последнего расчета коэфициентов. */
+uint8_t aiGetCalibrationResidual( uint8_t channel, uint8_t ma, float* residual );
+uint8_t aiGetBenchStat( uint8_t channel, AiBenchStat* stat );
+/* Статус диагностики канала: бит состояния AI_DIAG_* и AI_DIAG_PENDING, 0 - тока еще не было. */
+uint8_t aiGetDiagStatus( uint8_t channel );
+/* Своя цепочка фильтров канала вместо общей по умолчанию (не сохраняется на флешку). */
+uint8_t aiSetFilterChain( uint8_t channel, const FilterStage* stages );
 
 #endif /* INC_AI_H_ */
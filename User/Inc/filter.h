@@ -0,0 +1,60 @@
+#ifndef INC_FILTER_H_
+#define INC_FILTER_H_
+
+#include <stdint.h>
+
+#include "setting.h"
+
+typedef enum
+{
+	FILTER_NONE		= 0,	// Пустая ступень, конец цепочки
+	FILTER_MEDIAN	= 1,	// Медианный фильтр, параметр - ширина окна (3, 5, 7)
+	FILTER_AVERAGE	= 2,	// Скользящее среднее, параметр - размер окна
+	FILTER_EXP		= 3,	// Экспоненциальный фильтр, параметр - коэфициент в Q16 (1..65536)
+	FILTER_DECIMATE	= 4,	// CIC 1-го порядка (среднее по N и прореживание в N раз), параметр - N
+} FILTER_TYPE;
+
+/* Перевод коэфициента экспоненциального фильтра (0..1] в Q16. */
+#define FILTER_EXP_Q( value )				( (uint32_t)( (value) * 65536.0f + 0.5f ) )
+
+/* Описание ступени цепочки фильтров. */
+typedef struct FilterStage
+{
+	FILTER_TYPE type;
+	uint32_t param;
+} FilterStage;
+
+/* Состояние ступени цепочки фильтров. */
+typedef struct FilterStageState
+{
+	/* Окно медианного фильтра. */
+	uint32_t window[FILTER_MAX_MEDIAN];
+	/* Позиция в окне / счетчик выборок прореживания. */
+	uint16_t pos;
+	/* Смещение окна скользящего среднего в общем буфере цепочки. */
+	uint16_t offset;
+	/* Сумма окна скользящего среднего / накопитель прореживания /
+	 * остаток экспоненциального фильтра ниже выхода (Q16 со знаком). */
+	uint32_t sum;
+	/* Последнее выходное значение ступени. */
+	uint32_t out;
+} FilterStageState;
+
+/* Цепочка фильтров канала. Выборки - коды АЦП в формате Q(FILTER_FRAC_BITS). */
+typedef struct FilterChain
+{
+	FilterStage stage[FILTER_MAX_STAGES];
+	FilterStageState state[FILTER_MAX_STAGES];
+	/* Общий буфер окон скользящего среднего всех ступеней цепочки. */
+	uint32_t avgBuff[SIZE_ARRAY_AVERAGE];
+	/* Последнее выходное значение цепочки. */
+	uint32_t out;
+} FilterChain;
+
+uint8_t filterInit( FilterChain* chain, const FilterStage* stages );
+void filterReset( FilterChain* chain, uint32_t value );
+uint8_t filterSetParam( FilterChain* chain, FILTER_TYPE type, uint32_t param );
+uint16_t filterProcess( FilterChain* chain, uint32_t* block, uint16_t size );
+uint32_t filterGetOutput( const FilterChain* chain );
+
+#endif /* INC_FILTER_H_ */
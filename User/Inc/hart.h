@@ -1,8 +1,31 @@
 #ifndef INC_HART_H_
 #define INC_HART_H_
 
+#include <stdint.h>
+
+/* Приоритеты транзакций HART (меньше - важнее). Burst-сообщения принимаются прослушиванием
+ * свободной линии и в очередь не ставятся. */
+typedef enum
+{
+	HART_PRIORITY_ALARM		= 0,	// Циклический опрос устройства в аварии (HART_ALARM_STATUS_MASK)
+	HART_PRIORITY_MASTER	= 1,	// Запросы мастера CAN
+	HART_PRIORITY_CYCLIC	= 2,	// Циклический опрос
+} HART_PRIORITY;
+
+/* Состояние ответа в кэше циклических команд. */
+typedef enum
+{
+	HART_CACHE_EMPTY		= 0,	// Ответа еще не было
+	HART_CACHE_VALID		= 1,	// Ответ не старше HART_CACHE_STALE_TIME
+	HART_CACHE_STALE		= 2,	// Ответ устарел (устройство перестало отвечать)
+} HART_CACHE_STATUS;
+
 void hartProcess();
 void hartInit();
 void hartTimeout();
+/* Кадры в буферах CAN начинаются с разделителя: в txBuff - без контрольной суммы (дописывается модулем),
+ * в rxBuff - без преамбулы и контрольной суммы (проверяются модулем). */
+uint8_t hartGetStatistics( uint8_t channel, uint32_t* transactions, uint32_t* timeouts, uint32_t* errors );
+HART_CACHE_STATUS hartGetCache( uint8_t channel, uint8_t command, uint8_t* data, uint8_t* size, uint32_t* age );
 
 #endif
@@ -0,0 +1,66 @@
+#ifndef INC_HARTFRAME_H_
+#define INC_HARTFRAME_H_
+
+#include <stdint.h>
+
+/* Байт преамбулы. */
+#define HART_PREAMBLE_BYTE					0xFF
+/* Бит длинного (5 байт) адреса в разделителе. */
+#define HART_DELIMITER_LONG_ADDR			0x80
+/* Маска кол-ва байт расширения в разделителе. */
+#define HART_DELIMITER_EXPANSION_MASK		0x60
+/* Маска типа кадра в разделителе. */
+#define HART_DELIMITER_TYPE_MASK			0x07
+/* Размер короткого адреса. */
+#define HART_SHORT_ADDR_SIZE				1
+/* Размер длинного адреса. */
+#define HART_LONG_ADDR_SIZE					5
+/* Бит первичного мастера в первом байте адреса. */
+#define HART_ADDR_PRIMARY_MASTER			0x80
+/* Маска кода производителя (типа устройства) в первом байте длинного адреса. */
+#define HART_ADDR_MANUFACTURER_MASK			0x3F
+/* Максимальный размер кадра запроса без данных: разделитель, длинный адрес, команда, счетчик байт, сумма. */
+#define HART_REQUEST_SIZE					( HART_LONG_ADDR_SIZE + 4 )
+
+typedef enum
+{
+	HART_FRAME_BACK		= 1,	// Burst-сообщение устройства
+	HART_FRAME_STX		= 2,	// Запрос мастера
+	HART_FRAME_ACK		= 6,	// Ответ устройства
+} HART_FRAME_TYPE;
+
+typedef enum
+{
+	HART_FRAME_OK				= 0,	// Кадр верный
+	HART_FRAME_NO_PREAMBLE		= 1,	// Нет преамбулы (меньше HART_PREAMBLE_MIN байт)
+	HART_FRAME_BAD_DELIMITER	= 2,	// Неизвестный тип кадра
+	HART_FRAME_SHORT			= 3,	// Кадр короче, чем указано в счетчике байт
+	HART_FRAME_BAD_CHECKSUM		= 4,	// Не совпала контрольная сумма
+} HART_FRAME_STATUS;
+
+/* Разобранный кадр: смещения полей в буфере, данные не копируются. */
+typedef struct HartFrame
+{
+	/* Смещение разделителя (размер преамбулы с мусором перед ней). */
+	uint16_t start;
+	/* Размер кадра от разделителя до последнего байта данных (без контрольной суммы). */
+	uint16_t length;
+	/* Тип кадра HART_FRAME_TYPE. */
+	uint8_t type;
+	/* Размер адреса. */
+	uint8_t addressSize;
+	/* Команда. */
+	uint8_t command;
+	/* Счетчик байт данных. */
+	uint8_t byteCount;
+	/* Смещение данных от разделителя. */
+	uint8_t dataOffset;
+} HartFrame;
+
+HART_FRAME_STATUS hartFrameDecode( const uint8_t* buff, uint16_t size, HartFrame* frame );
+uint16_t hartFrameEncode( uint8_t* buff, uint16_t size );
+uint8_t hartFrameChecksum( const uint8_t* buff, uint16_t size );
+uint8_t hartFrameHeader( const uint8_t* buff, uint16_t size, HartFrame* frame );
+uint16_t hartFrameBuild( uint8_t* buff, const uint8_t* address, uint8_t addressSize, uint8_t command );
+
+#endif /* INC_HARTFRAME_H_ */
@@ -0,0 +1,45 @@
+#ifndef INC_JOURNAL_H_
+#define INC_JOURNAL_H_
+
+#include <stdint.h>
+
+#include "setting.h"
+
+/* Признак записи журнала. */
+#define JOURNAL_MAGIC						0x4C4E524A
+/* Кол-во слотов записей в секторе. */
+#define JOURNAL_SECTOR_SLOTS				( JOURNAL_SECTOR_SIZE / JOURNAL_SLOT_SIZE )
+/* Общее кол-во слотов записей журнала. */
+#define JOURNAL_SLOT_NUM					( JOURNAL_SECTOR_SLOTS * JOURNAL_SECTOR_NUM )
+
+typedef enum
+{
+	JOURNAL_AT_WORK		= 0,	// Операция выполняется, вызвать повторно
+	JOURNAL_DONE		= 1,	// Операция завершена
+	JOURNAL_EMPTY		= 2,	// В журнале нет ни одной верной записи
+	JOURNAL_ERROR		= 3,	// Размер данных не помещается в слот или не кратен 4, записанный слот не совпал с данными
+	JOURNAL_NOT_LOADED	= 4,	// Журнал не загружен до конца, место следующей записи неизвестно
+} JOURNAL_STATUS;
+
+/* Заголовок записи журнала, данные записи идут сразу за ним. */
+typedef struct JournalHeader
+{
+	/* Признак записи JOURNAL_MAGIC. */
+	uint32_t magic;
+	/* Порядковый номер записи, растет с каждой записью. */
+	uint32_t sequence;
+	/* Размер данных записи в байтах. */
+	uint16_t length;
+	/* Резерв. */
+	uint16_t reserved;
+	/* CRC данных записи. */
+	uint32_t dataCrc;
+	/* CRC заголовка: номер, размер и CRC данных. Недописанный заголовок не принимается за самую новую запись. */
+	uint32_t crc;
+} JournalHeader;
+
+JOURNAL_STATUS journalLoad( uint8_t* data, uint16_t size );
+JOURNAL_STATUS journalAppend( const uint8_t* data, uint16_t size );
+void journalReset( void );
+
+#endif /* INC_JOURNAL_H_ */
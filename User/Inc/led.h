@@ -25,7 +25,11 @@ typedef enum
 	MODE_TRIPLE	= 3,	// 200ms - ON, 200ms - OFF, 200ms - ON, 200ms - OFF, 200ms - ON, 1000ms - OFF
 	MODE_BLINK	= 4,	// 200ms - ON, 200ms - OFF, Repeat
 	MODE_FLICK	= 5,	// 50ms - ON, 50ms - OFF, Repeat
-	MODE_ON		= 6		// All timer ON
+	MODE_ON		= 6,	// All timer ON
+	MODE_HEARTBEAT	= 7,	// 100ms - ON, 150ms - OFF, 100ms - ON, 650ms - OFF, Repeat
+	MODE_QUADRUPLE	= 8,	// 4 x (200ms - ON, 200ms - OFF), 1000ms - OFF (last OFF), Repeat
+	MODE_QUINTUPLE	= 9,	// 5 x (200ms - ON, 200ms - OFF), 1000ms - OFF (last OFF), Repeat
+	MODE_SEXTUPLE	= 10,	// 6 x (200ms - ON, 200ms - OFF), 1000ms - OFF (last OFF), Repeat
 } LED_MODE;
 
 typedef enum
@@ -41,6 +45,7 @@ typedef enum
 void ledInit( void );
 void ledProcess( void );
 void setLedMode( LED_TYPE type, LED_MODE mode, LED_COLOR color);
+uint32_t ledGetTxCount( void );
 
 
 #endif /* INC_LED_H_ */
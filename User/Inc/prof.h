@@ -0,0 +1,79 @@
+#ifndef INC_PROF_H_
+#define INC_PROF_H_
+
+#include <stdint.h>
+
+#include "setting.h"
+
+/* Участки кода, которые профилируются. */
+typedef enum
+{
+	PROF_AI_WORKING		= 0,	// aiWorking: обработка блока выборок всех каналов
+	PROF_AI_FILTER		= 1,	// filterProcess: цепочка фильтров одного канала
+	PROF_AI_CONVERT		= 2,	// aiConvert: перевод выборки в ток
+	PROF_CALC_MEDIAN	= 3,	// calcMedian: медианное при калибрации
+	PROF_HART_PROCESS	= 4,	// hartProcess
+	PROF_LED_PROCESS	= 5,	// ledProcess
+	PROF_NUM			= 6,
+} PROF_ID;
+
+/* Статистика участка. Время - в тактах DWT на устройстве, в нс на хосте. */
+typedef struct ProfStat
+{
+	/* Кол-во замеров. */
+	uint32_t count;
+	/* Минимальное время. */
+	uint32_t min;
+	/* Максимальное время. */
+	uint32_t max;
+	/* Сумма времени для среднего. */
+	uint64_t sum;
+} ProfStat;
+
+/* Размер записи участка в дампе: кол-во, минимум, максимум, среднее (uint32_t, младшим байтом вперед). */
+#define PROF_DUMP_RECORD_SIZE				16
+
+#if PROF_ENABLE
+
+#if defined( __arm__ )
+#include "main.h"
+#else
+#include <time.h>
+#endif
+
+/* Текущее значение счетчика времени. */
+static inline uint32_t profCycles( void )
+{
+#if defined( __arm__ )
+	return DWT->CYCCNT;
+#else
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint32_t)( ts.tv_sec * 1000000000ULL + ts.tv_nsec );
+#endif
+}
+
+/* Начало и конец участка, пара должна быть в одном блоке кода. */
+#define PROF_BEGIN( id )					uint32_t profStart_##id = profCycles()
+#define PROF_END( id )						profAdd( id, profCycles() - profStart_##id )
+
+void profInit( void );
+void profReset( void );
+void profAdd( PROF_ID id, uint32_t time );
+uint8_t profGet( PROF_ID id, ProfStat* stat );
+uint16_t profDump( uint8_t* buff, uint16_t size );
+
+#else
+
+/* В релизной сборке пробы не компилируются. */
+#define PROF_BEGIN( id )
+#define PROF_END( id )
+#define profInit()
+#define profReset()
+#define profGet( id, stat )					( 0 )
+#define profDump( buff, size )				( 0 )
+
+#endif /* PROF_ENABLE */
+
+#endif /* INC_PROF_H_ */
@@ -0,0 +1,38 @@
+#ifndef INC_SCHED_H_
+#define INC_SCHED_H_
+
+#include <stdint.h>
+
+/* Задачи планировщика в порядке приоритета (меньше - важнее). */
+typedef enum
+{
+	SCHED_TASK_AI		= 0,	// Обработка выборок АЦП и калибрация
+	SCHED_TASK_HART		= 1,	// Обмен HART и флаги мастера CAN
+	SCHED_TASK_LED		= 2,	// Индикация
+	SCHED_TASK_NUM		= 3,
+} SCHED_TASK;
+
+/* Статистика выполнения задачи. */
+typedef struct SchedStat
+{
+	/* Кол-во запусков. */
+	uint32_t runCnt;
+	/* Кол-во запусков, превысивших бюджет. */
+	uint32_t overrunCnt;
+	/* Время последнего выполнения, такты (нс при сборке на хосте). */
+	uint32_t lastCycles;
+	/* Максимальное время выполнения, такты. */
+	uint32_t maxCycles;
+	/* Бюджет, такты. */
+	uint32_t budgetCycles;
+} SchedStat;
+
+/* Главный цикл: после инициализации модулей schedInit(), затем в цикле только schedRun(). */
+void schedInit( void );
+void schedRun( void );
+void schedCounterInit( void );
+void schedTrigger( SCHED_TASK task );
+uint8_t schedGetStat( SCHED_TASK task, SchedStat* stat );
+uint16_t schedGetLoad( void );
+
+#endif /* INC_SCHED_H_ */
@@ -10,8 +10,18 @@
 #define LED_I2C_OFFSET						3
 
 /* ________________________ CALIBRATION ________________________ */
-/* Размер массива под калибрацию. */
+/* Максимальное кол-во выборок точки калибровки. */
 #define SIZE_ARR_CALIBRATION 				100000
+/* Минимальное кол-во выборок точки калибровки до проверки на досрочное завершение. */
+#define CALIBRATION_MIN_SAMPLE				5000
+/* Период проверки на досрочное завершение (в выборках). */
+#define CALIBRATION_CHECK_PERIOD			1000
+/* Допустимая полуширина доверительного интервала среднего точки калибровки (в кодах АЦП). */
+#define CALIBRATION_MEAN_TOLERANCE			0.05
+/* Квадрат квантиля доверительного интервала (3.29^2 - 99.9%). */
+#define CALIBRATION_Z2						10.82
+/* Максимальное СКО выборок точки калибровки (в кодах АЦП), больше - точка шумная. */
+#define CALIBRATION_MAX_STD					20.0
 /* Кол-во неучитывающихся выборок при калибрации. */
 #define NUM_NOT_TAKEN_SAMPLE_CALIBRATION 	10
 /* Максимальный азмер массива под фильтрацию средним тока. */
@@ -22,12 +32,18 @@
 #define SIZE_ARRAY_RANGE_MA					17
 /* Значение калибровочного канала, когда канал не выбран. */
 #define CALIBRATION_NO_CHANNEL				0xFF
+/* Признак маски каналов в номере калибровочного канала: 0x80 | биты каналов 0..5. */
+#define CALIBRATION_CH_MASK_FLAG			0x80
 /* Значение по умолчанию для коэфициента А. */
 #define DEFAULT_CALIBRATION_COEF_A			-4.180287149356397e-008
 /* Значение по умолчанию для коэфициента B. */
 #define DEFAULT_CALIBRATION_COEF_B			1.1461199229165544
 /* Значение по умолчанию для коэфициента C. */
 #define DEFAULT_CALIBRATION_COEF_C			43.661028945484645
+/* Степень калибровочного полинома (1..3). */
+#define AI_CALIBRATION_ORDER				2
+/* Кол-во коэфициентов калибровочного полинома. */
+#define AI_CALIBRATION_COEF_NUM				( AI_CALIBRATION_ORDER + 1 )
 
 /* ________________________ VALUE OF IDEAL ADC ________________________ */
 #define ADC_IDEAL_MA4						16352
@@ -51,10 +67,21 @@
 /* ________________________ AI ________________________ */
 /* Кол-во каналов. */
 #define AI_CH_NUM							6
-/* Значение тока при КЗ. */
-#define CURRENT_KZ_VALUE					20500
-/* Значение тока при обрыве линии. */
-#define CURRENT_FALL_VALUE					3600
+/* Маска всех каналов. */
+#define AI_LED_ALL							( ( 1 << AI_CH_NUM ) - 1 )
+/* Границы диагностики тока по NAMUR NE43, мкА. Значение на границе относится к верхней зоне. */
+/* Ниже - обрыв линии. */
+#define AI_DIAG_FALL_LEVEL					3600
+/* Ниже - насыщение снизу. */
+#define AI_DIAG_UNDER_LEVEL					3800
+/* Не ниже - насыщение сверху. */
+#define AI_DIAG_OVER_LEVEL					20500
+/* Не ниже - КЗ. */
+#define AI_DIAG_KZ_LEVEL					21000
+/* Гистерезис границ диагностики, мкА. Должен быть меньше половины расстояния между границами. */
+#define AI_DIAG_HYSTERESIS					50
+/* Кол-во выходных выборок подряд в новой зоне до смены состояния диагностики. */
+#define AI_DIAG_DEBOUNCE					8
 /* Ток в 4 милиампера. */
 #define MA4									4
 /* Ток в 20 милиамперов. */
@@ -63,8 +90,51 @@
 #define CURRENT_STEP						0.55035773252614199229
 /* Нижняя граница тока 4-20(милиампер) в микроамперах. */
 #define LOWER_SAMPLE_BIAS					4000
+/* Кол-во проходов по всем каналам в одном блоке буфера сканирования. */
+#define AI_SCAN_BLOCK_SIZE					8
+/* Задержка АЦП: выборка N-канала приходит на N+2 обмене. */
+#define AI_ADC_PIPELINE_DEPTH				2
+/* Время ожидания завершения обмена с АЦП при остановке сканирования, после него обмен прерывается, мс. */
+#define AI_SCAN_STOP_TIMEOUT				2
+/* Замер выборок в секунду и отклика каналов (aiGetBenchStat): включен вместе с профилированием,
+ * в релизной сборке замер из aiWorking не компилируется. */
+#define AI_BENCH_ENABLE						PROF_ENABLE
+/* Окно подсчета выходных выборок в секунду по каналам, мс. */
+#define AI_BENCH_WINDOW						1000
+/* Изменение тока по сырому блоку выборок, при котором начинается замер отклика на скачок, мкА. */
+#define AI_STEP_THRESHOLD					1000
+/* Время, за которое отфильтрованный ток должен дойти до 90% скачка, иначе замер отменяется, мс. */
+#define AI_STEP_TIMEOUT						10000
+
+/* Способы вычисления тока по выборке АЦП. */
+/* Калибровочный полином и перевод в мкА в double. */
+#define AI_CONVERSION_DOUBLE				0
+/* Объединенный полином в фиксированной точке (Q48/Q32). */
+#define AI_CONVERSION_FIXED					1
+/* Таблица значений тока по каналу с линейной интерполяцией. */
+#define AI_CONVERSION_LUT					2
+/* Выбранный способ вычисления тока (тесты на хосте задают его до включения модуля). */
+#ifndef AI_CONVERSION
+#define AI_CONVERSION						AI_CONVERSION_LUT
+#endif
+/* Шаг таблицы AI_CONVERSION_LUT в кодах АЦП (степень двойки).
+ * Объем ОЗУ = ( ( 65536 >> AI_LUT_SHIFT ) + 1 ) * 4 * AI_CH_NUM байт.
+ * Ошибка интерполяции относительно double не больше ( |2a| + |6d| * 65535 ) * CURRENT_STEP * 2^( 2 * AI_LUT_SHIFT ) / 8
+ * плюс 1/512 мкА округления узлов. Макс. ошибка на кодах 0..65535 с коэфициентами по умолчанию:
+ * 8 - 6168 байт, < 0.01 мкА; 10 - 1560 байт, < 0.04 мкА; 12 - 408 байт, < 0.5 мкА. */
+#define AI_LUT_SHIFT						10
+/* Размер таблицы AI_CONVERSION_LUT. */
+#define AI_LUT_SIZE							( ( 65536 >> AI_LUT_SHIFT ) + 1 )
 
 /* ________________________ FILTER ________________________ */
+/* Максимальное кол-во ступеней в цепочке фильтров канала. */
+#define FILTER_MAX_STAGES					4
+/* Максимальная ширина окна медианного фильтра. */
+#define FILTER_MAX_MEDIAN					7
+/* Максимальный коэфициент прореживания. */
+#define FILTER_MAX_DECIMATE					64
+/* Кол-во дробных бит выборки в цепочке фильтров. */
+#define FILTER_FRAC_BITS					8
 /* Значение экспонециального фильтра по умолчанию. */
 #define DEFAULT_FILTER_EXP					0.1
 /* Значение фильтра под скользящее среднее по умолчанию. */
@@ -72,14 +142,89 @@
 
 /* ________________________ HART ________________________ */
 #define SIZE_HART_BUFF						284
+/* Размер кольца непрерывного приема HART (больше максимального кадра). */
+#define HART_RING_SIZE						512
+/* Кол-во байт преамбулы передаваемого кадра HART. */
+#define HART_PREAMBLE_TX					5
+/* Минимальное кол-во байт преамбулы принимаемого кадра HART. */
+#define HART_PREAMBLE_MIN					2
+/* Размер очереди транзакций канала HART. */
+#define HART_QUEUE_SIZE						4
+/* Минимальный таймаут ответа устройства HART, в тиках таймера. */
+#define HART_TIMEOUT_MIN					5
+/* Максимальный таймаут ответа устройства HART, в тиках таймера. */
+#define HART_TIMEOUT_MAX					120
+/* Пауза на линии после последнего байта, закрывающая кадр HART без события IDLE, в тиках таймера.
+ * Больше допустимой паузы между символами кадра (1 символ). */
+#define HART_FRAME_END_TIMEOUT				5
+/* Циклические команды, которые модуль опрашивает сам (битовая маска номеров команд 1..3), 0 - опрос выключен. */
+#define HART_CYCLIC_MASK					( ( 1 << 1 ) | ( 1 << 2 ) | ( 1 << 3 ) )
+/* Период опроса циклических команд канала, мс. */
+#define HART_CYCLIC_PERIOD					1000
+/* Период опроса циклических команд канала, устройство которого сообщает аварию, мс. */
+#define HART_CYCLIC_PERIOD_ALARM			250
+/* Биты статуса устройства (второй байт статуса ответа), означающие аварию: неисправность,
+ * насыщение токовой петли, выход PV за пределы. */
+#define HART_ALARM_STATUS_MASK				0x85
+/* Период поиска устройства на канале (команда 0), пока его адрес неизвестен, мс. */
+#define HART_DISCOVERY_PERIOD				5000
+/* Кол-во неудачных опросов подряд, после которого адрес устройства ищется заново. */
+#define HART_CYCLIC_MAX_MISSES				3
+/* Возраст ответа в кэше, после которого он считается устаревшим, мс. */
+#define HART_CACHE_STALE_TIME				3000
+/* Размер данных ответа в кэше (команда 3 - 26 байт со статусом). */
+#define HART_CACHE_DATA_SIZE				32
+/* Время прослушивания свободной линии канала, мс. */
+#define HART_LISTEN_DWELL					100
+/* Время прослушивания канала с burst-устройством (больше периода burst-сообщений), мс. */
+#define HART_LISTEN_DWELL_BURST				1000
+/* Время без burst-сообщений, после которого канал прослушивается как обычный, мс. */
+#define HART_BURST_EXPIRE					5000
+/* Минимальный интервал между PDO4 с флагами HART, изменения внутри интервала уходят одним PDO, мс. */
+#define HART_PDO_INTERVAL					10
 
 /* ________________________ FLASH ________________________ */
 /* Размер буферов флешки: 256 - данные + 4 - команда = 260 байт. */
 #define SIZE_FLASH_BUFFER					260
-/* Максимальное количество обращений к флешке до ошибки чтения. */
-#define FLASH_MAX_ATTEMPT_READ				10000
-/* Адрес, с которого берутся калибровочные данные с флешки. */
+/* Время, которое флешка может быть занята одной операцией (чтение, запись страницы, очистка сектора)
+ * до ошибки флешки, мс. Загрузка журнала - много операций, общее время загрузки не ограничивается. */
+#define AI_FLASH_OP_TIMEOUT					500
+/* Адрес калибровочных данных старого формата (без журнала), читаются, если журнал пуст. */
 #define FLASH_CALIBRATION_ADR				0x00
+/* Размер сектора флешки (минимальный стираемый блок). */
+#define JOURNAL_SECTOR_SIZE					4096
+/* Кол-во секторов в кольце журнала. */
+#define JOURNAL_SECTOR_NUM					4
+/* Размер слота записи журнала (страница флешки). */
+#define JOURNAL_SLOT_SIZE					256
+/* Адрес начала журнала, сразу за сектором данных старого формата. */
+#define JOURNAL_START_ADR					( FLASH_CALIBRATION_ADR + JOURNAL_SECTOR_SIZE )
+/* Версия структуры калибровочных данных на флешке. */
+#define AI_FLASH_VERSION					3
+
+/* ________________________ SCHEDULER ________________________ */
+/* Период задачи AI (если блок выборок не готов раньше), мс. */
+#define SCHED_PERIOD_AI						1
+/* Период задачи HART (если линия не завершила операцию раньше), мс. */
+#define SCHED_PERIOD_HART					1
+/* Период задачи индикации, мс. */
+#define SCHED_PERIOD_LED					10
+/* Бюджет времени выполнения задачи AI, мкс. */
+#define SCHED_BUDGET_AI						300
+/* Бюджет времени выполнения задачи HART, мкс. */
+#define SCHED_BUDGET_HART					100
+/* Бюджет времени выполнения задачи индикации, мкс. */
+#define SCHED_BUDGET_LED					50
+/* Окно подсчета загрузки процессора задачами, мс. */
+#define SCHED_LOAD_WINDOW					1000
+
+/* ________________________ PROFILER ________________________ */
+/* Профилирование участков кода: в отладочной сборке включено, в релизной пробы не компилируются. */
+#ifdef DEBUG
+#define PROF_ENABLE							1
+#else
+#define PROF_ENABLE							0
+#endif
 
 
 
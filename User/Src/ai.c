@@ -9,11 +9,19 @@
 #include "spi.h"
 #include "tim.h"
 #include "led.h"
+#include "filter.h"
+#include "journal.h"
+#include "sched.h"
+#include "prof.h"
 #include "stdlib.h"
 #include "string.h"
 #include "math.h"
 #include "crc.h"
 
+#if ( AI_CALIBRATION_ORDER > 2 ) && ( AI_CONVERSION == AI_CONVERSION_FIXED )
+#error "AI_CONVERSION_FIXED supports AI_CALIBRATION_ORDER up to 2"
+#endif
+
 /* ________________________ ENUM'S ________________________ */
 /* Режимы работы блока AI. */
 enum AI_MODE
@@ -37,6 +45,19 @@ enum CALIBRATION_MODE
 	CALIBRATION_SAVE 			= 	3,
 };
 
+/* Статусы набора точки калибровки канала. */
+enum CALIBRATION_STATUS
+{
+	/* Статус - точка не набирается. */
+	CALIBRATION_STATUS_IDLE		=	0,
+	/* Статус - идет набор выборок. */
+	CALIBRATION_STATUS_SAMPLING	=	1,
+	/* Статус - точка набрана. */
+	CALIBRATION_STATUS_DONE		=	2,
+	/* Статус - точка набрана, но СКО больше CALIBRATION_MAX_STD. */
+	CALIBRATION_STATUS_NOISY	=	3,
+};
+
 /* Статусы флешки */
 typedef enum FLASH_STATUS
 {
@@ -46,19 +67,26 @@ typedef enum FLASH_STATUS
 	FLASH_DONE 					= 	2,
 } FLASH_STATUS;
 
+/* Результат проверки данных, прочитанных с флешки. */
+typedef enum FLASH_DATA_STATUS
+{
+	/* Данные валидны (при необходимости перенесены из старой версии структуры). */
+	FLASH_DATA_VALID 			=   0,
+	/* Данных нет (флешка чистая). */
+	FLASH_DATA_EMPTY 			=   1,
+	/* Данные повреждены (не совпала CRC). */
+	FLASH_DATA_CRC_ERROR 		=   2,
+} FLASH_DATA_STATUS;
+
 /* Операции флешки */
 enum FLASH_OPERATION
 {
-	/* Операция - сохранить. Сохранение данных на флешку. */
-	FLASH_SAVE 					=   1,
 	/* Операция - чтение. Чтение данных в буфер флешки. */
 	FLASH_READ					= 	2,
 	/* Операция - получение прочитанных данных. Чтение данных из буфера RX флешки. */
 	FLASH_GET_READED			=	3,
 	/* Операция - установка W/R режима. */
 	FLASH_WRITE_MODE			=	4,
-	/* Операция - Очистка сектора флешки. */
-	FLASH_ERASE_SECTOR			=	5,
 	/* Операция - вернуться к исходным значениям. Возвращает все переменные в состояние по умолчанию */
 	FLASH_DEFAULT				=	6,
 };
@@ -82,84 +110,173 @@ enum CH_MAP
 void aiSPITxRxCallback( void );
 void aiCalibrationMa( uint8_t channel, uint16_t ma );
 void aiCalibrationSaveData( void );
+void aiCalibrationFinishPoint( uint8_t channel, uint16_t ma );
+void aiCalibrationStop( void );
+uint8_t aiCalibrationMask( uint8_t ch );
 FLASH_STATUS aiReadCalibrationData( void );
+void aiReadCalibrationReset( void );
+uint8_t aiFlashTimeout( void );
+void aiLoadCalibration( void );
 uint16_t calcMedian( uint16_t sample, uint16_t* ptrToArray, uint8_t* pos );
-double calcAverage( uint16_t sample, uint16_t* ptrToArray, uint32_t* ptrToSum, uint8_t* ptrToPos );
 void aiWorking( void );
+uint16_t aiConvert( uint8_t channel, uint32_t sample );
+void aiCheckCurrent( uint8_t channel );
+void aiScanStart( void );
+void aiScanStop( void );
+void aiScanCallback( void );
 void updateLed( void );
 void aiWaitCalibration( void );
 void aiCalcCalibration( uint8_t channel );
+uint8_t aiSolveLeastSquares( double m[][AI_CALIBRATION_COEF_NUM], double* y, double* p );
 void aiUpdateMode( void );
 void aiReset( void );
+void aiUpdateConversion( uint8_t channel );
+uint8_t aiSetFilterExp( uint8_t channel, float value );
+uint8_t aiSetFilterAvgSize( uint8_t channel, uint8_t size );
+#if AI_BENCH_ENABLE
+void aiBenchUpdate( uint8_t channel, uint32_t rawMean, uint16_t outCnt );
+#endif
+FLASH_DATA_STATUS aiCheckFlashData( void );
 
 /* ________________________ VARIABLE ________________________ */
 /* Текущий режим работы блока AI. */
 uint8_t aiMode = AI_WORKING;
-/* Флаг, отправлен ли конфиг на АЦП. */
-uint8_t isConfigSended = 0;
-/* Флаг, получена ли выборка с АЦП. */
-volatile uint8_t isSampleReceived = 0;
-/* Флаг, нужно ли обновить индикацию. */
-uint8_t isLedUpdate = 1;
-/* Размер массива под фильтрацию скользящим средним. */
-uint8_t filterAvgSize = DEFAULT_FILTER_AVERAGE_SIZE;
-/* Значение коэфициента под фильтрацию экспонентой. */
-float filterExpCurrent = DEFAULT_FILTER_EXP;
+/* Маска каналов, индикацию которых нужно обновить. */
+uint8_t ledUpdateMask = AI_LED_ALL;
+/* Последний заданный по CAN размер массива под фильтрацию скользящим средним. */
+uint8_t userFilterAvgSize = 0;
+/* Последний заданный по CAN коэфициент под фильтрацию экспонентой. */
+float userFilterExpCurrent = 0;
 /* Локальная переменная канала под калибровку (нужна для индикации калибровочного канала). */
 uint8_t calibrationCh = CALIBRATION_NO_CHANNEL;
+/* Маска каналов, по которым идет набор выборок калибровки (0 - набор не идет). */
+uint8_t calibrationMask = 0;
+/* Флаг, что идет загрузка калибровочных данных с флешки. */
+uint8_t isFlashLoading = 0;
+/* Время, когда флешка последний раз была свободна, мс. От него отсчитывается таймаут операции. */
+uint32_t flashOpTick = 0;
+/* Операция чтения данных старого формата. */
+uint8_t flashOperation = FLASH_READ;
+/* Флаг, что в журнале записей нет (читаются данные старого формата). */
+uint8_t isJournalEmpty = 0;
 /* Флаг индикации при записи на флешку. */
 uint8_t isSaveLedEnabled = 0;
+/* Флаг, что идет запись на флешку (таймаут операции отсчитывается от начала записи). */
+uint8_t isFlashSaving = 0;
 
 /* ________________________ STRUCT ________________________ */
 typedef struct AiData
 {
 	/* Конфиг канала в АЦП. */
 	uint8_t config[2];
-	/* Выборка АЦП. */
-	uint8_t sample[2];
 	/* Канал с учетом маппинга. */
 	uint8_t realCh;
 	/* Указатель на данные userData. */
 	uint16_t *ptrToUserData;
-	/* Текущая позиция в массиве среднего под фильтрацию. */
-	uint8_t avgCurrentPos;
-	/* Массив среднего под фильтрацию. */
-	uint16_t avgCurrentArr[SIZE_ARRAY_AVERAGE];
-	/* Среднее по всем выборкам. */
-	uint32_t avgCurrent;
-	/* Значение тока с полной точностью. */
-	double currentFull;
+	/* Цепочка фильтров канала. */
+	FilterChain filter;
+	/* Размер массива под фильтрацию скользящим средним. */
+	uint8_t filterAvgSize;
+	/* Значение коэфициента под фильтрацию экспонентой. */
+	float filterExpCurrent;
 	/* Коэфициент калибровки x^2*a. */
 	double coefA;
 	/* Коэфициент калибровки x*b. */
 	double coefB;
 	/* Коэфициент калибровки x+-c. */
 	double coefC;
+	/* Коэфициент калибровки x^3*d. */
+	double coefD;
+#if AI_CONVERSION == AI_CONVERSION_FIXED
+	/* Коэфициент x^2 пересчета выборки в мкА, формат Q48. */
+	int64_t coefAq;
+	/* Коэфициент x пересчета выборки в мкА, формат Q32. */
+	int64_t coefBq;
+	/* Смещение пересчета выборки в мкА, формат Q32. */
+	int64_t coefCq;
+#elif AI_CONVERSION == AI_CONVERSION_LUT
+	/* Таблица тока в мкА (Q8) по кодам АЦП с шагом 2^AI_LUT_SHIFT. */
+	int32_t lut[AI_LUT_SIZE];
+#endif
 	/* Значение тока. */
 	uint16_t current;
-	/* Массив под медианную фильтрацию. */
+	/* Массив под медианную фильтрацию при калибровке. */
 	uint16_t medianCurrentArr[SIZE_ARRAY_MEDIAN];
-	/* Текущая позиция в массиве среднего. */
+	/* Текущая позиция в массиве медианного. */
 	uint8_t medianCurrentPos;
-	/* Флаг короткого замыкания по значению тока. */
-	uint8_t isKZ;
-	/* Флаг, что ток укладывается в рабочий диапазон тока. */
-	uint8_t isOK;
-	/* Флаг, что обрыв линии по току. */
-	uint8_t isFall;
+	/* Состояние диагностики, бит AI_DIAG_* (0 - тока еще не было). */
+	uint8_t diagState;
+	/* Зона тока, ожидающая подтверждения. */
+	uint8_t diagPending;
+	/* Кол-во выборок подряд в зоне diagPending. */
+	uint8_t diagCnt;
 } AiData;
 
+/* Потоковая статистика выборок. Суммы считаются от первой выборки в целых числах, поэтому точны. */
+typedef struct AiCalibrationStat
+{
+	/* Кол-во выборок. */
+	uint32_t count;
+	/* Первая выборка, от которой считаются отклонения. */
+	uint16_t origin;
+	/* Минимальная выборка. */
+	uint16_t min;
+	/* Максимальная выборка. */
+	uint16_t max;
+	/* Сумма отклонений от первой выборки. */
+	int64_t sum;
+	/* Сумма квадратов отклонений от первой выборки. */
+	uint64_t sumSq;
+} AiCalibrationStat;
+
 typedef struct AiCalibrationData
 {
-	/* Сумма всех выборок на определенное значение тока при одной калибровке. */
-	double sumCalibration;
+	/* Статистика выборок на определенное значение тока при одной калибровке. */
+	AiCalibrationStat stat;
 	/* Среднее значение выборок. */
 	uint16_t adcValue[SIZE_ARRAY_RANGE_MA];
-	/* Выборка АЦП. */
-	uint8_t sample[2];
+	/* СКО выборок. */
+	float adcStd[SIZE_ARRAY_RANGE_MA];
+	/* Кол-во выборок, по которым посчитано среднее. */
+	uint32_t adcCount[SIZE_ARRAY_RANGE_MA];
+	/* Отклонение точки от полинома последнего расчета коэфициентов (в кодах идеального АЦП). */
+	float residual[SIZE_ARRAY_RANGE_MA];
+	/* Битовая маска точек, СКО которых больше CALIBRATION_MAX_STD. */
+	uint32_t noisyMask;
+	/* Кол-во оставшихся неучитывающихся выборок. */
+	uint8_t skipCnt;
+	/* Статус набора текущей точки. */
+	uint8_t status;
 } AiCalibrationData;
 
+/* Данные на флешке. Новые поля добавляются только в конец структуры с увеличением AI_FLASH_VERSION. */
 typedef struct AiDataFlash
+{
+	/* Контрольная сумма по структуре после этого поля (size байт). */
+	uint32_t crc;
+	/* Версия структуры. */
+	uint16_t version;
+	/* Размер структуры в записанной версии. */
+	uint16_t size;
+	/* Коэфициент калибровки x^2*a. */
+	double coefA[AI_CH_NUM];
+	/* Коэфициент калибровки x*b. */
+	double coefB[AI_CH_NUM];
+	/* Коэфициент калибровки x+-c. */
+	double coefC[AI_CH_NUM];
+	/* Значение шага экспонециального фильтра по каналам. */
+	float filterExpCurrent[AI_CH_NUM];
+	/* Размер массива под фильтрацию средним по каналам. */
+	uint8_t filterAvgSize[AI_CH_NUM];
+	/* Коэфициент калибровки x^3*d (с версии 3). Хранится во float, чтобы структура помещалась в страницу флешки. */
+	float coefD[AI_CH_NUM];
+} AiDataFlash;
+
+/* Запись калибровки должна помещаться в слот журнала вместе с заголовком. */
+_Static_assert( ( sizeof(AiDataFlash) + sizeof(JournalHeader) ) <= JOURNAL_SLOT_SIZE, "AiDataFlash does not fit a journal slot" );
+
+/* Данные на флешке первой версии (общие настройки фильтров для всех каналов). */
+typedef struct AiDataFlashV1
 {
 	/* Коэфициент калибровки x^2*a. */
 	double coefA[AI_CH_NUM];
@@ -173,7 +290,68 @@ typedef struct AiDataFlash
 	uint32_t crc;
 	/* Размер массива под фильтрацию средним. */
 	uint8_t filterAvgSize;
-} AiDataFlash;
+} AiDataFlashV1;
+
+/* Буфер чтения с флешки под любую версию структуры. */
+typedef union AiDataFlashBuff
+{
+	AiDataFlash data;
+	AiDataFlashV1 dataV1;
+} AiDataFlashBuff;
+
+typedef struct AiScanData
+{
+	/* Двойной буфер сырых выборок: [буфер][канал по маппингу][проход по каналам]. */
+	uint16_t buff[2][AI_CH_NUM][AI_SCAN_BLOCK_SIZE];
+	/* Принятая по SPI выборка. */
+	uint8_t sample[2];
+	/* Индекс заполняемого буфера. */
+	volatile uint8_t fillBuff;
+	/* Текущий проход по каналам в заполняемом буфере. */
+	volatile uint8_t fillPos;
+	/* Индекс заполненного буфера, готового к обработке. */
+	volatile uint8_t readyBuff;
+	/* Флаг, что заполненный буфер готов к обработке. */
+	volatile uint8_t isReady;
+	/* Канал (по порядку), конфиг которого отправляется в АЦП. */
+	volatile uint8_t channel;
+	/* Кол-во выборок, которые необходимо пропустить (конвейер АЦП после старта). */
+	volatile uint8_t skipCnt;
+	/* Каналы с пропущенными выборками в буфере (первый блок после старта), бит на канал. */
+	volatile uint8_t staleMask[2];
+	/* Флаг, что идет обмен с АЦП. */
+	volatile uint8_t isBusy;
+	/* Флаг, что сканирование запущено. */
+	volatile uint8_t isEnabled;
+	/* Счетчик потерянных блоков (буфер не успели обработать). */
+	volatile uint32_t overrunCnt;
+	/* Счетчик ошибок запуска обмена с АЦП (HAL вернул не HAL_OK). */
+	volatile uint32_t spiErrorCnt;
+} AiScanData;
+
+#if AI_BENCH_ENABLE
+/* Замер скорости выборок и отклика канала. */
+typedef struct AiBenchData
+{
+	/* Результаты замера. */
+	AiBenchStat stat;
+	/* Кол-во выходных выборок в текущем окне. */
+	uint32_t outCnt;
+	/* Ток по среднему сырого блока на прошлом блоке, мкА. */
+	uint16_t rawCurrent;
+	/* Флаг, что идет замер отклика на скачок. */
+	uint8_t isStep;
+	/* Флаг, что 63% скачка уже пройдено. */
+	uint8_t isPassed63;
+	/* Ток до и после скачка, мкА. */
+	uint16_t stepFrom;
+	uint16_t stepTo;
+	/* Время скачка, мс. */
+	uint32_t stepTick;
+	/* Время достижения 63% скачка в текущем замере, мс. */
+	uint32_t latency63;
+} AiBenchData;
+#endif
 
 typedef struct AiDataLed
 {
@@ -189,6 +367,13 @@ typedef struct AiDataLed
 	LED_COLOR colorWorking;
 } AiDataLed;
 
+/* ________________________ STRUCT FUNCTION'S PROTOTYPE ________________________ */
+void aiStatReset( AiCalibrationStat* stat );
+void aiStatAdd( AiCalibrationStat* stat, uint16_t sample );
+double aiStatMean( const AiCalibrationStat* stat );
+double aiStatVariance( const AiCalibrationStat* stat );
+uint8_t aiStatIsStable( const AiCalibrationStat* stat );
+
 /* ________________________ INIT STRUCT ________________________ */
 /* Пример конфигураций, отправляемых в АЦП:
 *     		cfg		    INCC	INx		BW		REF		SEQ		RB
@@ -197,12 +382,12 @@ typedef struct AiDataLed
 */
 AiData aiData[AI_CH_NUM] =
 {
-	{ { 0b11111101, 0b11000000 }, { 0, 0 }, CH1, &userData.dataCH1CH2[1] },
-	{ { 0b11111011, 0b11000000 }, { 0, 0 }, CH2, &userData.dataCH1CH2[3] },
-	{ { 0b11111001, 0b11000000 }, { 0, 0 }, CH3, &userData.dataCH3CH4[1] },
-	{ { 0b11110111, 0b11000000 }, { 0, 0 }, CH4, &userData.dataCH3CH4[3] },
-	{ { 0b11110101, 0b11000000 }, { 0, 0 }, CH5, &userData.dataCH5CH6[1] },
-	{ { 0b11110011, 0b11000000 }, { 0, 0 }, CH6, &userData.dataCH5CH6[3] },
+	{ { 0b11111101, 0b11000000 }, CH1, &userData.dataCH1CH2[1] },
+	{ { 0b11111011, 0b11000000 }, CH2, &userData.dataCH1CH2[3] },
+	{ { 0b11111001, 0b11000000 }, CH3, &userData.dataCH3CH4[1] },
+	{ { 0b11110111, 0b11000000 }, CH4, &userData.dataCH3CH4[3] },
+	{ { 0b11110101, 0b11000000 }, CH5, &userData.dataCH5CH6[1] },
+	{ { 0b11110011, 0b11000000 }, CH6, &userData.dataCH5CH6[3] },
 };
 
 AiDataLed aiDataLed[AI_CH_NUM] =
@@ -215,69 +400,116 @@ AiDataLed aiDataLed[AI_CH_NUM] =
 	{ LED_CH6, MODE_OFF, COLOR_YELLOW, MODE_OFF, COLOR_YELLOW },
 };
 
+/* Границы зон диагностики тока по возрастанию, мкА. */
+const uint16_t aiDiagLevel[] = { AI_DIAG_FALL_LEVEL, AI_DIAG_UNDER_LEVEL, AI_DIAG_OVER_LEVEL, AI_DIAG_KZ_LEVEL };
+
+/* Цепочка фильтров каналов по умолчанию: медиана -> скользящее среднее -> экспонента. */
+const FilterStage aiFilterChain[FILTER_MAX_STAGES] =
+{
+	{ FILTER_MEDIAN,	SIZE_ARRAY_MEDIAN 						},
+	{ FILTER_AVERAGE,	DEFAULT_FILTER_AVERAGE_SIZE 			},
+	{ FILTER_EXP,		FILTER_EXP_Q( DEFAULT_FILTER_EXP ) 		},
+	{ FILTER_NONE,		0 										},
+};
+
 AiCalibrationData aiCalibrationData[AI_CH_NUM] = {};
 
 AiDataFlash aiDataFlash = {};
 
+AiDataFlashBuff aiDataFlashBuff = {};
+
+AiScanData aiScanData = {};
+
+#if AI_BENCH_ENABLE
+AiBenchData aiBenchData[AI_CH_NUM] = {};
+/* Начало окна подсчета выборок в секунду, мс. */
+uint32_t aiBenchTick = 0;
+#endif
+
 /**
-  * @brief Инициализация модуля AI, чтение и проверка калибровочных данных из памяти.
+  * @brief Инициализация модуля AI. Калибровочные данные загружаются с флешки асинхронно в aiProcess.
   */
 void aiInit( void )
+{
+	/* Регистрация колбэков. */
+	registerCallback( aiSPITxRxCallback, SPI1_TX_RX_CPT );
+	for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
+	{
+		/* Инициализация цепочек фильтров каналов. */
+		filterInit( &aiData[channel].filter, aiFilterChain );
+		/* До загрузки данных с флешки работаем на коэфициентах и фильтрах по умолчанию. */
+		aiData[channel].coefA = DEFAULT_CALIBRATION_COEF_A;
+		aiData[channel].coefB = DEFAULT_CALIBRATION_COEF_B;
+		aiData[channel].coefC = DEFAULT_CALIBRATION_COEF_C;
+		aiData[channel].coefD = 0;
+		aiUpdateConversion( channel );
+		aiSetFilterAvgSize( channel, DEFAULT_FILTER_AVERAGE_SIZE );
+		aiSetFilterExp( channel, DEFAULT_FILTER_EXP );
+	}
+	/* Запоминаем текущие настройки фильтров в CAN, применяются только их изменения. */
+	userFilterAvgSize = userData.filterAvgSize;
+	userFilterExpCurrent = userData.filterExpCurrent;
+	/* Запускаем загрузку калибровочных данных, она продолжается в aiProcess. */
+	isFlashLoading = 1;
+	flashOpTick = HAL_GetTick();
+	/* Запускаем сканирование каналов. */
+	if ( aiMode == AI_WORKING )
+	{
+		aiScanStart();
+	}
+};
+
+/**
+  * @brief  Шаг загрузки калибровочных данных с флешки. По завершению чтения и проверки
+  *         коэфициенты по умолчанию заменяются сохраненными без остановки сканирования.
+  *         Если флешка занята дольше AI_FLASH_OP_TIMEOUT мс - остаются значения по умолчанию,
+  *         а прерванная загрузка журнала сбрасывается (запись до новой загрузки не выполняется).
+  */
+void aiLoadCalibration( void )
 {
 	/* Флаг, что флешка в рабочем состоянии. */
 	uint8_t flashValid = 1;
 	/* Флаг, что данные прочитались верно. */
 	uint8_t dataValid = 1;
-	/* Счетчик попыток чтения из флешки. */
-	uint16_t readAttemptCnt = 0;
-	/* CRC данных из флешки. */
-	uint32_t crc = 0;
-
-	/* Регистрация колбэков. */
-	registerCallback( aiSPITxRxCallback, SPI1_TX_RX_CPT );
+	/* Результат проверки данных из флешки. */
+	FLASH_DATA_STATUS dataStatus = FLASH_DATA_EMPTY;
 
-	/* Чтение данных из памяти. */
-	while ( ( aiReadCalibrationData() != FLASH_DONE ) )
+	/* Если чтение не завершено. */
+	if ( aiReadCalibrationData() != FLASH_DONE )
 	{
-		/* Если достигли лимита на попытки чтения. */
-		if (readAttemptCnt == FLASH_MAX_ATTEMPT_READ)
+		/* Если флешка еще отвечает. */
+		if ( !aiFlashTimeout() )
 		{
-			/* Обнуляем флаг, что флешка в рабочем состоянии. */
-			flashValid = 0;
-			break;
+			return;
 		}
-		/* Увеличиваем счетчик ошибок. */
-		readAttemptCnt++;
-	};
+		/* Обнуляем флаг, что флешка в рабочем состоянии. */
+		flashValid = 0;
+		aiReadCalibrationReset();
+	}
+	isFlashLoading = 0;
+
 	/* Если флешка в рабочем состоянии. */
 	if ( flashValid )
 	{
-		/* Если есть CRC. */
-		if ( ( aiDataFlash.crc != 0 ) || ( aiDataFlash.crc != 0xFF ) )
+		/* Проверяем прочитанные данные. */
+		dataStatus = aiCheckFlashData();
+		/* Если CRC не совпадают. */
+		if ( dataStatus == FLASH_DATA_CRC_ERROR )
 		{
-			/* Сохраняем прочитанную CRC. */
-			crc = aiDataFlash.crc;
-			/* Обнуляем CRC в структуре для рассчета CRC без самой CRC. */
-			aiDataFlash.crc = 0;
-			/* Рассчитываем CRC по прочитанным данным. */
-			uint32_t crcReadedData = HAL_CRC_Calculate(&hcrc, (uint32_t*)( (uint8_t*)&aiDataFlash ), sizeof(AiDataFlash) / sizeof(uint32_t) );
-			/* Если CRC не совпадают. */
-			if ( crc != crcReadedData )
+			/* Выставление индицаии ошибки CRC. */
+			for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
 			{
-				/* Выставление индицаии ошибки CRC. */
-				for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
-				{
-					aiDataLed[channel].colorWorking = COLOR_YELLOW;
-					aiDataLed[channel].modeWorking = MODE_FLICK;
+				aiDataLed[channel].colorWorking = COLOR_YELLOW;
+				aiDataLed[channel].modeWorking = MODE_FLICK;
 
-					aiDataLed[channel].color = COLOR_YELLOW;
-					aiDataLed[channel].mode = MODE_FLICK;
-				}
-				/* Выставляем флаг, что данные не валидны. */
-				dataValid = 0;
+				aiDataLed[channel].color = COLOR_YELLOW;
+				aiDataLed[channel].mode = MODE_FLICK;
 			}
+			/* Выставляем флаг, что данные не валидны. */
+			dataValid = 0;
 		}
 		else
+		if ( dataStatus == FLASH_DATA_EMPTY )
 		{
 			/* CRC нет - выставляем индикацию неверной CRC. */
 			for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
@@ -315,43 +547,37 @@ void aiInit( void )
 			aiData[channel].coefA = aiDataFlash.coefA[channel];
 			aiData[channel].coefB = aiDataFlash.coefB[channel];
 			aiData[channel].coefC = aiDataFlash.coefC[channel];
+			aiData[channel].coefD = aiDataFlash.coefD[channel];
+			aiUpdateConversion( channel );
 			/* Выставляем индикацию, что всё ОК. */
 			aiDataLed[channel].colorWorking = COLOR_GREEN;
 			aiDataLed[channel].modeWorking = MODE_ON;
 
 			aiDataLed[channel].color = COLOR_GREEN;
 			aiDataLed[channel].mode = MODE_ON;
+			/* Если вдруг размер массива под фильтрацию средним вне диапазона, устанавливаем значение по умолчанию. */
+			if ( ( aiDataFlash.filterAvgSize[channel] < 1 ) || ( aiDataFlash.filterAvgSize[channel] >= SIZE_ARRAY_AVERAGE ) )
+			{
+				aiSetFilterAvgSize( channel, DEFAULT_FILTER_AVERAGE_SIZE );
+			}
+			else
+			{
+				aiSetFilterAvgSize( channel, aiDataFlash.filterAvgSize[channel] );
+			}
+			/* Переносим настройки экспонециальной фильтрации. */
+			if ( ( aiDataFlash.filterExpCurrent[channel] > 0 ) && ( aiDataFlash.filterExpCurrent[channel] <= 1 ) )
+			{
+				aiSetFilterExp( channel, aiDataFlash.filterExpCurrent[channel] );
+			}
+			else
+			{
+				aiSetFilterExp( channel, DEFAULT_FILTER_EXP );
+			}
 		}
-		/* Если вдруг размер массива под фильтрацию средним меньше 1, устанавливаем значение по умолчанию. */
-		if ( aiDataFlash.filterAvgSize < 1 )
-		{
-			filterAvgSize = DEFAULT_FILTER_AVERAGE_SIZE;
-		}
-		else
-		{
-			filterAvgSize = aiDataFlash.filterAvgSize;
-		}
-		/* Переносим настройки экспонециальной фильтрации. */
-		filterExpCurrent = aiDataFlash.filterExpCurrent;
-	}
-	else
-	{
-		/* Если данные битые, устанавлиаем коэфициенты и фильтры по умолчанию. */
-		for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
-		{
-			aiData[channel].coefA = DEFAULT_CALIBRATION_COEF_A;
-			aiData[channel].coefB = DEFAULT_CALIBRATION_COEF_B;
-			aiData[channel].coefC = DEFAULT_CALIBRATION_COEF_C;
-		}
-		filterAvgSize = DEFAULT_FILTER_AVERAGE_SIZE;
-		filterExpCurrent = DEFAULT_FILTER_EXP;
 	}
 	/* Выставляем флаг, что необходимо обновить индикацию. */
-	isLedUpdate = 1;
-	/* Обновляем индикацию. */
-	updateLed();
-};
-
+	ledUpdateMask = AI_LED_ALL;
+}
 
 /**
   * @brief Проверка и обновления режима работы блока AI.
@@ -361,11 +587,10 @@ void aiUpdateMode( void )
 	/* Если режим изменился. */
 	if (userData.aiMode != aiMode)
 	{
-		/* Обнуляем флаги. */
-		isSampleReceived = 0;
-		isConfigSended = 0;
+		/* Останавливаем сканирование каналов и набор калибровки до смены режима. */
+		aiCalibrationStop();
 		/* Выставляем флаг обновления инидкации. */
-		isLedUpdate = 1;
+		ledUpdateMask = AI_LED_ALL;
 		/* Обновляем режим работы. */
 		aiMode = userData.aiMode;
 
@@ -386,6 +611,8 @@ void aiUpdateMode( void )
 			aiDataLed[3].mode = aiDataLed[3].modeWorking;
 			aiDataLed[4].mode = aiDataLed[4].modeWorking;
 			aiDataLed[5].mode = aiDataLed[5].modeWorking;
+			/* Запускаем сканирование каналов. */
+			aiScanStart();
 		}
 		else
 		if ( aiMode == AI_CALIBRATION )
@@ -395,6 +622,7 @@ void aiUpdateMode( void )
 			calibrationCh = CALIBRATION_NO_CHANNEL;
 			/* Сбрасываем флаг индикации. */
 			isSaveLedEnabled = 0;
+			isFlashSaving = 0;
 			/* Сбрасываем индикацию. */
 			aiDataLed[0].color = COLOR_GREEN;
 			aiDataLed[1].color = COLOR_GREEN;
@@ -418,23 +646,19 @@ void aiUpdateMode( void )
   */
 void updateLed( void )
 {
-	/* Если индикацию необходимо обновить. */
-	if ( isLedUpdate )
-	{
-		/* Обнуляем флаг необходимости обновления индикации. */
-		isLedUpdate = 0;
-		/* Обновляем индикацию каналов. */
-		setLedMode(aiDataLed[0].type, aiDataLed[0].mode, aiDataLed[0].color);
-		setLedMode(aiDataLed[1].type, aiDataLed[1].mode, aiDataLed[1].color);
-		setLedMode(aiDataLed[2].type, aiDataLed[2].mode, aiDataLed[2].color);
-		setLedMode(aiDataLed[3].type, aiDataLed[3].mode, aiDataLed[3].color);
-		setLedMode(aiDataLed[4].type, aiDataLed[4].mode, aiDataLed[4].color);
-		setLedMode(aiDataLed[5].type, aiDataLed[5].mode, aiDataLed[5].color);
+	/* Обновляем индикацию только измененных каналов. */
+	for ( uint8_t channel = 0; ledUpdateMask; channel++ )
+	{
+		if ( ledUpdateMask & ( 1 << channel ) )
+		{
+			ledUpdateMask &= ~( 1 << channel );
+			setLedMode( aiDataLed[channel].type, aiDataLed[channel].mode, aiDataLed[channel].color );
+		}
 	}
 }
 
 /**
-  * @brief Сбрасывание всех каналов (массивов среднего, значений среднего, медианной фильтрации).
+  * @brief Сбрасывание всех каналов (цепочек фильтров, медианной фильтрации калибровки).
   */
 void aiReset( void )
 {
@@ -443,21 +667,128 @@ void aiReset( void )
 		/* Сбрасываем медианный фильтр. */
 		aiData[ch].medianCurrentPos = 0;
 		memset( aiData[ch].medianCurrentArr, 0, SIZE_ARRAY_MEDIAN * sizeof(uint16_t) );
-		/* Сбрасываем средне-скользящий фильтр. */
-		memset( aiData[ch].avgCurrentArr, 0, SIZE_ARRAY_AVERAGE * sizeof(uint16_t) );
-		aiData[ch].avgCurrentPos = 0;
-		/* Сбрасываем значения тока. */
+		/* Сбрасываем цепочку фильтров. */
+		filterReset( &aiData[ch].filter, 0 );
+		/* Сбрасываем значение тока. */
 		aiData[ch].current = 0;
-		aiData[ch].currentFull = 0;
-		aiData[ch].avgCurrent = 0;
 	}
 }
 
+/**
+  * @brief  Пересчет коэфициентов (таблицы) канала под вычисление тока.
+  *         Вызывается при каждом изменении калибровочных коэфициентов канала.
+  *         В режиме AI_CONVERSION_FIXED калибровка и перевод в мкА объединяются в один полином:
+  *         I = A' * x^2 + B' * x + C', где A' = a * CURRENT_STEP (Q48), B' = b * CURRENT_STEP (Q32),
+  *         C' = LOWER_SAMPLE_BIAS + ( c - ADC_IDEAL_MA4 ) * CURRENT_STEP (Q32).
+  *         Погрешность относительно double на всем диапазоне кодов 0..65535 не превышает 1e-5 мкА
+  *         (при |a| < 1e-5, x^2 берется по целой части кода), ток в мкА совпадает с double в пределах ±1 МЗР.
+  *         В режиме AI_CONVERSION_LUT таблица строится по тем же формулам, что и в double.
+  * @param  channel:	номер канала.
+  */
+void aiUpdateConversion( uint8_t channel )
+{
+#if AI_CONVERSION == AI_CONVERSION_FIXED
+	aiData[channel].coefAq = llround( aiData[channel].coefA * CURRENT_STEP * 281474976710656.0 );
+	aiData[channel].coefBq = llround( aiData[channel].coefB * CURRENT_STEP * 4294967296.0 );
+	aiData[channel].coefCq = llround( ( LOWER_SAMPLE_BIAS + ( aiData[channel].coefC - ADC_IDEAL_MA4 ) * CURRENT_STEP ) * 4294967296.0 );
+#elif AI_CONVERSION == AI_CONVERSION_LUT
+	for ( uint16_t i = 0; i < AI_LUT_SIZE; i++ )
+	{
+		/* Код АЦП в узле таблицы. */
+		double x = (double)i * ( 1UL << AI_LUT_SHIFT );
+		/* Приводим к идеальной выборке и переводим в мкА. */
+		double y = ( ( aiData[channel].coefD * x + aiData[channel].coefA ) * x + aiData[channel].coefB ) * x + aiData[channel].coefC;
+		y = LOWER_SAMPLE_BIAS + ( y - ADC_IDEAL_MA4 ) * CURRENT_STEP;
+		aiData[channel].lut[i] = lround( y * 256 );
+	}
+#else
+	(void)channel;
+#endif
+}
+
+/**
+  * @brief  Установка коэфициента фильтрации экспонентой канала без сброса его истории.
+  *         Коэфициент меньше МЗР Q16 заменяется наименьшим допустимым.
+  * @param  channel:	номер канала.
+  * @param  value:		коэфициент (0..1].
+  * @retval 1 - коэфициент применен, 0 - не принят цепочкой (остается прежний, на флешку идет он).
+  */
+uint8_t aiSetFilterExp( uint8_t channel, float value )
+{
+	uint32_t alpha = FILTER_EXP_Q( value );
+
+	if ( ( value > 0 ) && !alpha )
+	{
+		alpha = 1;
+		value = 1.0f / 65536;
+	}
+	if ( !filterSetParam( &aiData[channel].filter, FILTER_EXP, alpha ) )
+	{
+		return 0;
+	}
+	aiData[channel].filterExpCurrent = value;
+	return 1;
+}
+
+/**
+  * @brief  Установка размера окна скользящего среднего канала без сброса остальных ступеней фильтров.
+  * @param  channel:	номер канала.
+  * @param  size:		размер окна.
+  * @retval 1 - размер применен, 0 - не принят цепочкой (остается прежний, на флешку идет он).
+  */
+uint8_t aiSetFilterAvgSize( uint8_t channel, uint8_t size )
+{
+	if ( !filterSetParam( &aiData[channel].filter, FILTER_AVERAGE, size ) )
+	{
+		return 0;
+	}
+	aiData[channel].filterAvgSize = size;
+	return 1;
+}
+
+/**
+  * @brief  Замена цепочки фильтров канала (по умолчанию у всех каналов aiFilterChain).
+  *         История новой цепочки заполняется текущим выходом канала, поэтому ток не скачет.
+  *         Цепочка на флешку не сохраняется и после перезапуска возвращается к aiFilterChain.
+  *         Вызывается из основного цикла, как и обработка выборок.
+  * @param  channel:	номер канала.
+  * @param  stages:		FILTER_MAX_STAGES ступеней, после последней - FILTER_NONE.
+  * @retval 1 - цепочка заменена, 0 - неверный канал или цепочка (остается прежняя).
+  */
+uint8_t aiSetFilterChain( uint8_t channel, const FilterStage* stages )
+{
+	FilterChain* chain;
+	/* Ступени прежней цепочки на случай ошибки. */
+	FilterStage stage[FILTER_MAX_STAGES];
+	uint32_t out;
+
+	if ( channel >= AI_CH_NUM )
+	{
+		return 0;
+	}
+	chain = &aiData[channel].filter;
+	out = filterGetOutput( chain );
+	memcpy( stage, chain->stage, sizeof(stage) );
+	if ( !filterInit( chain, stages ) )
+	{
+		filterInit( chain, stage );
+		filterReset( chain, out );
+		return 0;
+	}
+	filterReset( chain, out );
+	return 1;
+}
+
 /**
   * @brief Главная точка работы блока AI.
   */
 void aiProcess( void )
 {
+	/* Если калибровочные данные еще загружаются. */
+	if ( isFlashLoading )
+	{
+		aiLoadCalibration();
+	}
 	/* Проверяем, не изменился ли режим работы блока AI. */
 	aiUpdateMode();
 
@@ -470,6 +801,12 @@ void aiProcess( void )
 	if ( aiMode == AI_CALIBRATION)
 	{
 		/* Если режим CALIBRATION. */
+		/* Если набор выборок прерван сменой команды. */
+		if ( calibrationMask && ( userData.calibrationMode != CALIBRATION_SAMPLING ) )
+		{
+			aiCalibrationStop();
+		}
+
 		if (userData.calibrationMode == CALIBRATION_SAMPLING)
 		{
 			/* Высчитываем калибрацию для канала под значение тока. */
@@ -484,13 +821,20 @@ void aiProcess( void )
 		else
 		if (userData.calibrationMode == CALIBRATION_CALC)
 		{
-			/* Режим высчитывания коэфициентов */
-			aiCalcCalibration(userData.calibrationCh);
+			/* Режим высчитывания коэфициентов по всем выбранным каналам. */
+			for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
+			{
+				if ( aiCalibrationMask( userData.calibrationCh ) & ( 1 << channel ) )
+				{
+					aiCalcCalibration( channel );
+				}
+			}
+			userData.calibrationMode = CALIBRATION_WAIT;
 		}
 		else
-		if (userData.calibrationMode == CALIBRATION_SAVE)
+		if ( ( userData.calibrationMode == CALIBRATION_SAVE ) && !isFlashLoading )
 		{
-			/* Режим сохранения значений. */
+			/* Режим сохранения значений (пока флешка занята загрузкой, сохранение откладывается). */
 			aiCalibrationSaveData();
 		}
 	}
@@ -498,109 +842,295 @@ void aiProcess( void )
 };
 
 /**
-  * @brief WORKING режим, вычисление значений тока.
+  * @brief WORKING режим, обработка заполненного блока выборок.
   */
 void aiWorking( void )
 {
-	/* Текущий канал (по порядку, не по маппингу). */
-	static uint8_t channel = 0;
-	/* Медианное значение тока. */
-	static uint16_t medianCurrent = 0;
-	/* Среднее значение тока. */
-	static double avgCurrent = 0;
-
-	/* Если запрос на получение выборки к АЦП отправлен. */
-	if ( isConfigSended )
-	{
-		/* Если выборка с АЦП получена. */
-		if ( isSampleReceived )
+	/* Блок выборок канала под цепочку фильтров. */
+	uint32_t block[AI_SCAN_BLOCK_SIZE];
+
+	/* Если блок выборок еще не заполнен. */
+	if ( !aiScanData.isReady )
+	{
+		return;
+	}
+	PROF_BEGIN( PROF_AI_WORKING );
+	for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
+	{
+		uint16_t size;
+#if AI_BENCH_ENABLE
+		/* Сумма сырых выборок блока. */
+		uint32_t sum = 0;
+#endif
+
+		/* Неполный блок не подаем в фильтры: старые выборки исказили бы медиану и экспоненту. */
+		if ( aiScanData.staleMask[aiScanData.readyBuff] & ( 1 << channel ) )
+		{
+			continue;
+		}
+
+		/* Переводим сырые выборки канала в формат цепочки фильтров. */
+		for ( uint8_t pos = 0; pos < AI_SCAN_BLOCK_SIZE; pos++ )
+		{
+			block[pos] = (uint32_t)aiScanData.buff[aiScanData.readyBuff][channel][pos] << FILTER_FRAC_BITS;
+#if AI_BENCH_ENABLE
+			sum += aiScanData.buff[aiScanData.readyBuff][channel][pos];
+#endif
+		}
+		PROF_BEGIN( PROF_AI_FILTER );
+		size = filterProcess( &aiData[channel].filter, block, AI_SCAN_BLOCK_SIZE );
+		PROF_END( PROF_AI_FILTER );
+		/* Если после фильтрации (прореживания) остались выборки - обновляем ток. */
+		if ( size )
+		{
+			PROF_BEGIN( PROF_AI_CONVERT );
+			aiData[channel].current = aiConvert( channel, filterGetOutput( &aiData[channel].filter ) );
+			PROF_END( PROF_AI_CONVERT );
+			aiCheckCurrent( channel );
+		}
+#if AI_BENCH_ENABLE
+		aiBenchUpdate( channel, sum / AI_SCAN_BLOCK_SIZE, size );
+#endif
+	}
+	/* Освобождаем буфер под следующий блок. */
+	aiScanData.staleMask[aiScanData.readyBuff] = 0;
+	aiScanData.isReady = 0;
+	PROF_END( PROF_AI_WORKING );
+}
+
+/**
+  * @brief  Вычисление значения тока по отфильтрованной выборке.
+  * @param  channel:	номер канала.
+  * @param  sample:		выборка АЦП в формате Q(FILTER_FRAC_BITS).
+  * @retval ток в мкА, отрицательный ток ограничивается нулем.
+  */
+uint16_t aiConvert( uint8_t channel, uint32_t sample )
+{
+#if AI_CONVERSION == AI_CONVERSION_FIXED
+	/* Квадрат целой части кода. */
+	int64_t sample2 = ( (uint64_t)sample * sample ) >> ( 2 * FILTER_FRAC_BITS );
+	/* Приводим выборку к идеальной и рассчитываем ток в мкА (Q32), коэфициенты объединены в aiUpdateConversion. */
+	int64_t current = ( ( aiData[channel].coefAq * sample2 ) >> 16 )
+			+ ( ( aiData[channel].coefBq * (int64_t)sample ) >> FILTER_FRAC_BITS ) + aiData[channel].coefCq;
+
+	return ( current > 0 ) ? ( current >> 32 ) : 0;
+#elif AI_CONVERSION == AI_CONVERSION_LUT
+	/* Берем ток из таблицы канала (Q8) с линейной интерполяцией между узлами. */
+	const int32_t* lut = &aiData[channel].lut[sample >> ( AI_LUT_SHIFT + FILTER_FRAC_BITS )];
+	uint32_t frac = sample & ( ( 1UL << ( AI_LUT_SHIFT + FILTER_FRAC_BITS ) ) - 1 );
+	int32_t current = lut[0] + (int32_t)( ( (int64_t)( lut[1] - lut[0] ) * frac ) >> ( AI_LUT_SHIFT + FILTER_FRAC_BITS ) );
+
+	return ( current > 0 ) ? ( current >> 8 ) : 0;
+#else
+	double x = (double)sample / ( 1UL << FILTER_FRAC_BITS );
+	/* Приводим выборку к идеальной выборке. */
+	double current = ( ( aiData[channel].coefD * x + aiData[channel].coefA ) * x + aiData[channel].coefB ) * x + aiData[channel].coefC;
+	/* Рассчитываем ток по приведенной выборке. */
+	current = LOWER_SAMPLE_BIAS + ( current - ADC_IDEAL_MA4 ) * CURRENT_STEP;
+
+	return ( current > 0 ) ? current : 0;
+#endif
+}
+
+/**
+  * @brief  Диагностика тока канала по зонам NAMUR NE43 с гистерезисом границ и подтверждением
+  *         смены состояния AI_DIAG_DEBOUNCE выборками подряд, обновление индикации при смене.
+  * @param  channel:	номер канала.
+  */
+void aiCheckCurrent( uint8_t channel )
+{
+	AiData* data = &aiData[channel];
+	/* Зона тока, биты состояний идут по возрастанию тока. */
+	uint8_t zone = AI_DIAG_FALL;
+
+	/* Граница сдвигается от текущего состояния на гистерезис. */
+	for ( uint8_t i = 0; i < ( sizeof(aiDiagLevel) / sizeof(aiDiagLevel[0]) ); i++ )
+	{
+		uint16_t level = aiDiagLevel[i];
+
+		if ( data->diagState )
+		{
+			level = ( data->diagState > zone ) ? ( level - AI_DIAG_HYSTERESIS ) : ( level + AI_DIAG_HYSTERESIS );
+		}
+		if ( data->current < level )
+		{
+			break;
+		}
+		zone <<= 1;
+	}
+
+	if ( zone == data->diagState )
+	{
+		data->diagCnt = 0;
+		return;
+	}
+	if ( zone != data->diagPending )
+	{
+		data->diagPending = zone;
+		data->diagCnt = 0;
+	}
+	/* Первое состояние после старта принимается сразу. */
+	if ( data->diagState && ( ++data->diagCnt < AI_DIAG_DEBOUNCE ) )
+	{
+		return;
+	}
+	data->diagState = zone;
+	data->diagCnt = 0;
+
+	switch ( zone )
+	{
+		case AI_DIAG_FALL:
+			aiDataLed[channel].modeWorking = MODE_ON;
+			aiDataLed[channel].colorWorking = COLOR_YELLOW;
+			break;
+		case AI_DIAG_KZ:
+			aiDataLed[channel].modeWorking = MODE_ON;
+			aiDataLed[channel].colorWorking = COLOR_RED;
+			break;
+		case AI_DIAG_UNDER:
+		case AI_DIAG_OVER:
+			aiDataLed[channel].modeWorking = MODE_BLINK;
+			aiDataLed[channel].colorWorking = COLOR_GREEN;
+			break;
+		default:
+			aiDataLed[channel].modeWorking = MODE_ON;
+			aiDataLed[channel].colorWorking = COLOR_GREEN;
+			break;
+	}
+	aiDataLed[channel].mode = aiDataLed[channel].modeWorking;
+	aiDataLed[channel].color = aiDataLed[channel].colorWorking;
+	ledUpdateMask |= 1 << channel;
+}
+
+/**
+  * @brief  Статус диагностики канала.
+  * @param  channel:	номер канала.
+  * @retval Бит состояния AI_DIAG_* и AI_DIAG_PENDING, 0 - тока еще не было или неверный канал.
+  */
+uint8_t aiGetDiagStatus( uint8_t channel )
+{
+	if ( channel >= AI_CH_NUM )
+	{
+		return 0;
+	}
+	return aiData[channel].diagState | ( aiData[channel].diagCnt ? AI_DIAG_PENDING : 0 );
+}
+
+/**
+  * @brief  Запуск циклического сканирования каналов АЦП.
+  */
+void aiScanStart( void )
+{
+	aiScanData.fillBuff = 0;
+	aiScanData.fillPos = 0;
+	aiScanData.isReady = 0;
+	aiScanData.channel = 0;
+	/* Первые выборки после старта принадлежат конфигам, отправленным до старта. */
+	aiScanData.skipCnt = AI_ADC_PIPELINE_DEPTH;
+	aiScanData.staleMask[0] = 0;
+	aiScanData.staleMask[1] = 0;
+	aiScanData.isEnabled = 1;
+}
+
+/**
+  * @brief  Остановка сканирования, ожидание завершения текущего обмена с АЦП.
+  */
+void aiScanStop( void )
+{
+	uint32_t start = HAL_GetTick();
+
+	aiScanData.isEnabled = 0;
+	/* Обмен длится 2 байта, ждем его завершения, чтобы освободить SPI. */
+	while ( aiScanData.isBusy )
+	{
+		/* Завершения обмена нет (DMA не отработал) - прерываем его, иначе главный цикл зависнет. */
+		if ( ( HAL_GetTick() - start ) > AI_SCAN_STOP_TIMEOUT )
 		{
-			/* Поднимаем чип-селект. */
+			HAL_SPI_Abort(&hspi1);
 			HAL_GPIO_WritePin(ADC_CS_GPIO_Port, ADC_CS_Pin, GPIO_PIN_SET);
-			/* Очищаем флаги. */
-			isSampleReceived = 0;
-			isConfigSended = 0;
-			/* Считаем медианное по сырой выборки из АЦП. */
-			medianCurrent = calcMedian( ( aiData[channel].sample[0] << 8 ) | aiData[channel].sample[1], aiData[channel].medianCurrentArr, &aiData[channel].medianCurrentPos );
-			/* Считаем среднее по сырым выборкам канала. */
-			avgCurrent = calcAverage( medianCurrent, aiData[channel].avgCurrentArr, &aiData[channel].avgCurrent, &aiData[channel].avgCurrentPos );
-			/* Приводим выборку к идеальной выборке. */
-			avgCurrent = aiData[channel].coefA * (avgCurrent * avgCurrent) + ( avgCurrent * aiData[channel].coefB ) + aiData[channel].coefC;
-			/* Рассчитываем ток по приведенной выборке. */
-			avgCurrent = LOWER_SAMPLE_BIAS + (avgCurrent - ADC_IDEAL_MA4) * CURRENT_STEP;
-			/* Фильтруем экспонециальным фильтром и обновляем значение тока. */
-			aiData[channel].currentFull += (avgCurrent - aiData[channel].currentFull) * filterExpCurrent;
-			aiData[channel].current = aiData[channel].currentFull;
-
-			if ( (aiData[channel].current > CURRENT_FALL_VALUE && aiData[channel].current < CURRENT_KZ_VALUE ) && !aiData[channel].isOK )
-			{
-				aiDataLed[channel].color = COLOR_GREEN;
-				aiDataLed[channel].mode = MODE_ON;
-				aiDataLed[channel].colorWorking = COLOR_GREEN;
-				aiDataLed[channel].modeWorking = MODE_ON;
-				aiData[channel].isFall = 0;
-				aiData[channel].isKZ = 0;
-				aiData[channel].isOK = 1;
-
-				isLedUpdate = 1;
-			}
-			else
-			if ( aiData[channel].current < CURRENT_FALL_VALUE && !aiData[channel].isFall )
-			{
-				aiDataLed[channel].color = COLOR_YELLOW;
-				aiDataLed[channel].mode = MODE_ON;
-				aiDataLed[channel].colorWorking = COLOR_YELLOW;
-				aiDataLed[channel].modeWorking = MODE_ON;
-				aiData[channel].isFall = 1;
-				aiData[channel].isKZ = 0;
-				aiData[channel].isOK = 0;
+			aiScanData.spiErrorCnt++;
+			aiScanData.isBusy = 0;
+		}
+	}
+}
 
-				isLedUpdate = 1;
-			}
-			else
-			if ( aiData[channel].current > CURRENT_KZ_VALUE && !aiData[channel].isKZ )
-			{
-				aiDataLed[channel].color = COLOR_RED;
-				aiDataLed[channel].mode = MODE_ON;
-				aiDataLed[channel].colorWorking = COLOR_RED;
-				aiDataLed[channel].modeWorking = MODE_ON;
-				aiData[channel].isFall = 0;
-				aiData[channel].isKZ = 1;
-				aiData[channel].isOK = 0;
-
-				isLedUpdate = 1;
-			}
+/**
+  * @brief  Шаг сканирования: отправка конфига очередного канала в АЦП.
+  *         Вызывается из прерывания таймера, период таймера задает частоту выборок.
+  */
+void aiScanTick( void )
+{
+	/* Если сканирование остановлено или предыдущий обмен еще не завершен. */
+	if ( !aiScanData.isEnabled || aiScanData.isBusy )
+	{
+		return;
+	}
+	aiScanData.isBusy = 1;
+	/* Опускаем чип-селект АЦП. */
+	HAL_GPIO_WritePin(ADC_CS_GPIO_Port, ADC_CS_Pin, GPIO_PIN_RESET);
+	/* Отправляем конфиг канала. */
+	if ( HAL_SPI_TransmitReceive_DMA(&hspi1, aiData[aiScanData.channel].config, aiScanData.sample, 2) != HAL_OK )
+	{
+		/* Обмен не запущен, колбэка не будет: освобождаем АЦП, канал повторится на следующем шаге. */
+		HAL_GPIO_WritePin(ADC_CS_GPIO_Port, ADC_CS_Pin, GPIO_PIN_SET);
+		aiScanData.spiErrorCnt++;
+		aiScanData.isBusy = 0;
+	}
+}
+
+/**
+  * @brief  Завершение обмена с АЦП при сканировании, запись выборки в буфер.
+  */
+void aiScanCallback( void )
+{
+	/* Канал, которому принадлежит выборка с учетом маппинга и задержки АЦП. */
+	uint8_t realCh = aiData[aiScanData.channel].realCh;
+
+	/* Поднимаем чип-селект, запускаем преобразование. */
+	HAL_GPIO_WritePin(ADC_CS_GPIO_Port, ADC_CS_Pin, GPIO_PIN_SET);
 
+	if ( aiScanData.skipCnt )
+	{
+		/* Пропускаем выборки, оставшиеся в конвейере АЦП, слот канала в блоке остается старым. */
+		aiScanData.skipCnt--;
+		aiScanData.staleMask[aiScanData.fillBuff] |= 1 << realCh;
+	}
+	else
+	{
+		/* Записываем выборку в заполняемый буфер. */
+		aiScanData.buff[aiScanData.fillBuff][realCh][aiScanData.fillPos] = ( aiScanData.sample[0] << 8 ) | aiScanData.sample[1];
+	}
+
+	/* Если отправлен конфиг последнего канала - проход завершен. */
+	if ( aiScanData.channel == ( AI_CH_NUM - 1 ) )
+	{
+		aiScanData.channel = 0;
 
-			/* Если текущий канал АЦП последний. */
-			if ( channel == 5 )
+		if ( ++aiScanData.fillPos == AI_SCAN_BLOCK_SIZE )
+		{
+			aiScanData.fillPos = 0;
+			/* Если предыдущий блок еще не обработан - перезаписываем текущий буфер. */
+			if ( aiScanData.isReady )
 			{
-				/* Обнуляем счетчик каналов. */
-				channel = 0;
+				aiScanData.overrunCnt++;
+				/* Буфер перезаписан целиком. */
+				aiScanData.staleMask[aiScanData.fillBuff] = 0;
 			}
 			else
 			{
-				/* Инкрементируем счетчик каналов. */
-				channel++;
+				aiScanData.readyBuff = aiScanData.fillBuff;
+				aiScanData.fillBuff ^= 1;
+				aiScanData.isReady = 1;
+				schedTrigger( SCHED_TASK_AI );
 			}
 		}
-		else
-		{
-			/* Если выборка с АЦП не получена. */
-			return;
-		}
-
 	}
 	else
 	{
-		/* Если запрос не отправлен. */
-		/* Выставляем флаг, что запрос к АЦП отправлен. */
-		isConfigSended = 1;
-		/* Опускаем чип-селект АЦП. */
-		HAL_GPIO_WritePin(ADC_CS_GPIO_Port, ADC_CS_Pin, GPIO_PIN_RESET);
-		/* Отправляем конфиг канала, получаем данные в канал по маппингу. */
-		HAL_SPI_TransmitReceive_DMA(&hspi1, aiData[channel].config, aiData[aiData[channel].realCh].sample, 2);
+		aiScanData.channel++;
 	}
+
+	aiScanData.isBusy = 0;
 }
 
 /**
@@ -614,7 +1144,7 @@ void aiWaitCalibration( void )
 		/* Обновляем локальную переменную канала. */
 		calibrationCh = userData.calibrationCh;
 		/* Если канал задан неверно. */
-		if ( ( calibrationCh < 0 ) || ( calibrationCh > ( AI_CH_NUM - 1 ) ) )
+		if ( !aiCalibrationMask( calibrationCh ) )
 		{
 			/* Включаем аварийную индикацю. */
 			for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
@@ -622,7 +1152,7 @@ void aiWaitCalibration( void )
 				aiDataLed[ch].color = COLOR_RED;
 				aiDataLed[ch].mode = MODE_SINGLE;
 			}
-			isLedUpdate = 1;
+			ledUpdateMask = AI_LED_ALL;
 		}
 		else
 		{
@@ -632,64 +1162,53 @@ void aiWaitCalibration( void )
 				aiDataLed[ch].color = COLOR_GREEN;
 				aiDataLed[ch].mode = MODE_OFF;
 			}
-			/* Подсвечиваем рабочий канал. */
-			aiDataLed[calibrationCh].color = COLOR_GREEN;
-			aiDataLed[calibrationCh].mode = MODE_BLINK;
-			isLedUpdate = 1;
-		}
-	}
+			/* Подсвечиваем рабочие каналы. */
+			for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+			{
+				if ( aiCalibrationMask( calibrationCh ) & ( 1 << ch ) )
+				{
+					aiDataLed[ch].mode = MODE_BLINK;
+				}
+			}
+			ledUpdateMask = AI_LED_ALL;
+		}
+	}
 	/* Если изменилось значение размера массива под фильтрацию средним. */
-	if ( filterAvgSize != userData.filterAvgSize )
+	if ( userFilterAvgSize != userData.filterAvgSize )
 	{
+		userFilterAvgSize = userData.filterAvgSize;
 		/* Проверяем на допустимый диапазон. */
 		if ( ( userData.filterAvgSize > 1 ) && ( userData.filterAvgSize < SIZE_ARRAY_AVERAGE ) )
 		{
-			/* Обновляем значение размера массива среднего под фильтрацию. */
-			filterAvgSize = userData.filterAvgSize;
-			/* Сбрасываем значения каналов. */
-			aiReset();
+			/* Обновляем размер окна среднего выбранных каналов (всех, если каналы не выбраны). */
+			for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+			{
+				if ( ( aiCalibrationMask( calibrationCh ) & ( 1 << ch ) ) || !aiCalibrationMask( calibrationCh ) )
+				{
+					aiSetFilterAvgSize( ch, userData.filterAvgSize );
+				}
+			}
 		}
 	}
 	/* Если изменилось значение шага фильтрацией экспонентой. */
-	if ( filterExpCurrent != userData.filterExpCurrent )
+	if ( userFilterExpCurrent != userData.filterExpCurrent )
 	{
+		userFilterExpCurrent = userData.filterExpCurrent;
 		/* Если шаг больше 0 и меньше 1. */
 		if ( ( userData.filterExpCurrent > 0 ) && ( userData.filterExpCurrent <= 1 ) )
 		{
-			/* Обновляем шаг фильтра. */
-			filterExpCurrent = userData.filterExpCurrent;
-			/* Сбрасываем значения каналов. */
-			aiReset();
+			/* Обновляем шаг фильтра выбранных каналов (всех, если каналы не выбраны). */
+			for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+			{
+				if ( ( aiCalibrationMask( calibrationCh ) & ( 1 << ch ) ) || !aiCalibrationMask( calibrationCh ) )
+				{
+					aiSetFilterExp( ch, userData.filterExpCurrent );
+				}
+			}
 		}
 	}
 }
 
-/**
-  * @brief  Вычисление инкрементального скользящего среднего в массиве.
-  * @param  sample:		новая выборка АЦП.
-  * @param  ptrToArray: указатель на массив среднего.
-  * @param  ptrToSum:	указатель на сумму среднего.
-  * @param  ptrToPos:	указатель на актуальную позицию в массиве среднего.
-  * @retval вычисленное среднее.
-  */
-double calcAverage( uint16_t sample, uint16_t* ptrToArray, uint32_t* ptrToSum, uint8_t* ptrToPos )
-{
-	/* Если мы достигли края конца массива под среднее. */
-	if (++(*ptrToPos) == filterAvgSize)
-	{
-		/* Обнуляем переменную позиции. */
-		*ptrToPos = 0;
-	}
-	/* Вычитаем предыдущие значение выборки для вычисления скользящего среднего. */
-	*ptrToSum -= ptrToArray[*ptrToPos];
-	/* Добавляем текущее значение выборки для вычисления скользящего среднего. */
-	*ptrToSum += sample;
-	/* Меняем предыдущее значение выборки на текущее. */
-	ptrToArray[*ptrToPos] = sample;
-	/* Новое значение тока по скользящему среднему. */
-	return (*ptrToSum) / filterAvgSize;
-}
-
 /**
   * @brief  Вычисление медианного из трех значений.
   * @param  sample:		новая выборка АЦП.
@@ -723,104 +1242,295 @@ uint16_t calcMedian( uint16_t sample, uint16_t* ptrToArray, uint8_t* ptrToPos )
 }
 
 /**
-  * @brief Калибровка тока.
-  * @param  ch:		номер канала, который калибруется.
+  * @brief Калибровка тока. Выборки всех выбранных каналов набираются одновременно сканированием.
+  * @param  ch:		номер канала, который калибруется, или CALIBRATION_CH_MASK_FLAG | маска каналов.
   * @param  ma:		опорное значение для калибровки.
   */
 void aiCalibrationMa( uint8_t ch, uint16_t ma )
 {
-	/* Началась ли калибровка. */
-	static uint8_t isStarted = 0;
-	/* Счетчик полученных выборок для калибрации. */
-	static uint32_t calibrationCnt = 0;
-
-	/* Если введено неверное значение ma. */
-	if ( ( ma < MA4 ) || (ma > MA20) )
+	/* Маска выбранных каналов. */
+	uint8_t mask = aiCalibrationMask( ch );
+	/* Флаг, что по какому-либо каналу еще идет набор выборок. */
+	uint8_t isSampling = 0;
+	/* Медианное трех последних выборок. */
+	uint16_t median;
+
+	/* Если введено неверное значение ma или каналы не выбраны. */
+	if ( ( ma < MA4 ) || ( ma > MA20 ) || !mask )
 	{
+		aiCalibrationStop();
 		userData.calibrationMode = CALIBRATION_WAIT;
 		return;
 	}
 
-	/* Если введено неверное значение канала. */
-	if ( ( ch < 0 ) || (ch > ( AI_CH_NUM - 1) ) )
+	/* Если калибрация еще не запустилась. */
+	if ( !calibrationMask )
 	{
-		userData.calibrationMode = CALIBRATION_WAIT;
+		calibrationMask = mask;
+		for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
+		{
+			if ( !( calibrationMask & ( 1 << channel ) ) )
+			{
+				continue;
+			}
+			/* Обнуляем статистику и счетчик неучитывающихся выборок. */
+			aiStatReset( &aiCalibrationData[channel].stat );
+			aiCalibrationData[channel].skipCnt = NUM_NOT_TAKEN_SAMPLE_CALIBRATION;
+			aiCalibrationData[channel].status = CALIBRATION_STATUS_SAMPLING;
+			/* Обнуляем массив и позицию медианного. */
+			memset( aiData[channel].medianCurrentArr, 0, sizeof(aiData[channel].medianCurrentArr) );
+			aiData[channel].medianCurrentPos = 0;
+			/* Выставляем индикацию канала. */
+			aiDataLed[channel].color = COLOR_YELLOW;
+			aiDataLed[channel].mode = MODE_FLICK;
+		}
+		ledUpdateMask |= calibrationMask;
+		/* Запускаем сканирование, выборки всех каналов набираются одновременно. */
+		aiScanStart();
 		return;
 	}
 
-	/* Если калибрация еще не запустилась. */
-	if ( !isStarted )
+	/* Если блок выборок еще не заполнен. */
+	if ( !aiScanData.isReady )
 	{
-		/* Выставляем флаг, что калибрация началась. */
-		isStarted = 1;
-		/* Обнуляем массив медианного. */
-		memset(aiData[ch].medianCurrentArr, 0, 6);
-		/* Обнуляем позицию медианного. */
-		aiData[ch].medianCurrentPos = 0;
-		/* Выставляем индикацию канала. */
-		aiDataLed[ch].color = COLOR_YELLOW;
-		aiDataLed[ch].mode = MODE_FLICK;
-		isLedUpdate = 1;
+		return;
 	}
 
-	if ( isConfigSended )
+	for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
 	{
-		if ( isSampleReceived )
+		if ( !( calibrationMask & ( 1 << channel ) ) || ( aiCalibrationData[channel].status != CALIBRATION_STATUS_SAMPLING ) )
+		{
+			continue;
+		}
+		/* Неполный первый блок после старта в статистику не берем. */
+		if ( aiScanData.staleMask[aiScanData.readyBuff] & ( 1 << channel ) )
+		{
+			isSampling = 1;
+			continue;
+		}
+		for ( uint8_t pos = 0; pos < AI_SCAN_BLOCK_SIZE; pos++ )
 		{
-			/* Поднимаем чип-селект. */
-			HAL_GPIO_WritePin(ADC_CS_GPIO_Port, ADC_CS_Pin, GPIO_PIN_SET);
-			/* Очищаем флаги. */
-			isSampleReceived = 0;
-			isConfigSended = 0;
 			/* Проверка, прошли ли выборки, которые не учитываются. */
-			if ( calibrationCnt < NUM_NOT_TAKEN_SAMPLE_CALIBRATION )
+			if ( aiCalibrationData[channel].skipCnt )
 			{
-				return;
+				aiCalibrationData[channel].skipCnt--;
+				continue;
 			}
-			/* Прибавляем к сумме калибрации медианное. */
-			aiCalibrationData[ch].sumCalibration += calcMedian( (aiCalibrationData[ch].sample[0] << 8 ) | aiCalibrationData[ch].sample[1], aiData[ch].medianCurrentArr, &aiData[ch].medianCurrentPos);
-			/* Если серднее вычислено полностью. */
-			if (calibrationCnt == (SIZE_ARR_CALIBRATION + NUM_NOT_TAKEN_SAMPLE_CALIBRATION) - 1 )
+			/* Добавляем в статистику калибрации медианное. */
+			PROF_BEGIN( PROF_CALC_MEDIAN );
+			median = calcMedian( aiScanData.buff[aiScanData.readyBuff][channel][pos], aiData[channel].medianCurrentArr, &aiData[channel].medianCurrentPos );
+			PROF_END( PROF_CALC_MEDIAN );
+			aiStatAdd( &aiCalibrationData[channel].stat, median );
+			/* Если набрано максимальное кол-во выборок или среднее уже определено с нужной точностью. */
+			if ( ( aiCalibrationData[channel].stat.count == SIZE_ARR_CALIBRATION ) || aiStatIsStable( &aiCalibrationData[channel].stat ) )
 			{
-				/* Вычисляем среднее выборок. */
-				aiCalibrationData[ch].adcValue[ma - 4] = (double) aiCalibrationData[ch].sumCalibration / SIZE_ARR_CALIBRATION;
-				/* Обнуляем сумму для среднего. */
-				aiCalibrationData[ch].sumCalibration = 0;
-				/* Обнуляем счетчик полученных выборок. */
-				calibrationCnt = 0;
-				/* Обнуляем флаг, что калибрация работает. */
-				isStarted = 0;
-				/* Обнуляем массив медианного. */
-				memset(aiData[ch].medianCurrentArr, 0, 6);
-				/* Обнуляем позицию медианного. */
-				aiData[ch].medianCurrentPos = 0;
-
-				aiDataLed[ch].color = COLOR_GREEN;
-				aiDataLed[ch].mode = MODE_BLINK;
-				isLedUpdate = 1;
-
-				/* Переходим в режим ожидания. */
-				userData.calibrationMode = CALIBRATION_WAIT;
+				aiCalibrationFinishPoint( channel, ma );
+				break;
 			}
 		}
-		else
+		if ( aiCalibrationData[channel].status == CALIBRATION_STATUS_SAMPLING )
 		{
-			return;
+			isSampling = 1;
 		}
 	}
+	/* Освобождаем буфер под следующий блок. */
+	aiScanData.staleMask[aiScanData.readyBuff] = 0;
+	aiScanData.isReady = 0;
+
+	/* Если по всем каналам точка набрана - переходим в режим ожидания. */
+	if ( !isSampling )
+	{
+		aiCalibrationStop();
+		userData.calibrationMode = CALIBRATION_WAIT;
+	}
+}
+
+/**
+  * @brief  Завершение набора точки калибровки канала.
+  * @param  channel:	номер канала.
+  * @param  ma:			опорное значение для калибровки.
+  */
+void aiCalibrationFinishPoint( uint8_t channel, uint16_t ma )
+{
+	/* Вычисляем среднее и СКО выборок. */
+	aiCalibrationData[channel].adcValue[ma - 4] = lround( aiStatMean( &aiCalibrationData[channel].stat ) );
+	aiCalibrationData[channel].adcStd[ma - 4] = sqrt( aiStatVariance( &aiCalibrationData[channel].stat ) );
+	aiCalibrationData[channel].adcCount[ma - 4] = aiCalibrationData[channel].stat.count;
+
+	/* Если точка шумная - помечаем ее и выставляем индикацию ошибки. */
+	if ( aiCalibrationData[channel].adcStd[ma - 4] > CALIBRATION_MAX_STD )
+	{
+		aiCalibrationData[channel].noisyMask |= ( 1UL << ( ma - 4 ) );
+		aiCalibrationData[channel].status = CALIBRATION_STATUS_NOISY;
+		aiDataLed[channel].color = COLOR_RED;
+	}
 	else
 	{
-		/* Выставляем флаг, что запрос к АЦП отправлен. */
-		isConfigSended = 1;
-		/* Увеличиваем счетчик выборок калибрации. */
-		calibrationCnt++;
-		HAL_GPIO_WritePin(ADC_CS_GPIO_Port, ADC_CS_Pin, GPIO_PIN_RESET);
-		/* Отправляем конфигурацию канала. */
-		HAL_SPI_TransmitReceive_DMA(&hspi1, aiData[ch].config, aiCalibrationData[ch].sample, 2);
-		return;
+		aiCalibrationData[channel].noisyMask &= ~( 1UL << ( ma - 4 ) );
+		aiCalibrationData[channel].status = CALIBRATION_STATUS_DONE;
+		aiDataLed[channel].color = COLOR_GREEN;
+	}
+	aiDataLed[channel].mode = MODE_BLINK;
+	ledUpdateMask |= 1 << channel;
+}
+
+/**
+  * @brief  Остановка набора выборок калибровки (по завершению или при смене команды).
+  */
+void aiCalibrationStop( void )
+{
+	aiScanStop();
+
+	for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
+	{
+		/* Прерванные точки возвращаем в ожидание. */
+		if ( aiCalibrationData[channel].status == CALIBRATION_STATUS_SAMPLING )
+		{
+			aiCalibrationData[channel].status = CALIBRATION_STATUS_IDLE;
+		}
 	}
+	calibrationMask = 0;
 }
 
+/**
+  * @brief  Маска каналов калибровки по номеру канала из CAN.
+  * @param  ch:			номер канала (0..AI_CH_NUM-1) или CALIBRATION_CH_MASK_FLAG | маска каналов.
+  * @retval маска каналов, 0 - каналы заданы неверно.
+  */
+uint8_t aiCalibrationMask( uint8_t ch )
+{
+	if ( ch < AI_CH_NUM )
+	{
+		return 1 << ch;
+	}
+	if ( ( ch != CALIBRATION_NO_CHANNEL ) && ( ch & CALIBRATION_CH_MASK_FLAG ) )
+	{
+		return ch & ( ( 1 << AI_CH_NUM ) - 1 );
+	}
+	return 0;
+}
+
+/**
+  * @brief  Статус набора точки калибровки канала.
+  * @param  channel:	номер канала.
+  * @param  count:		кол-во набранных выборок текущей точки.
+  * @retval статус CALIBRATION_STATUS.
+  */
+uint8_t aiGetCalibrationStatus( uint8_t channel, uint32_t* count )
+{
+	if ( channel >= AI_CH_NUM )
+	{
+		return CALIBRATION_STATUS_IDLE;
+	}
+	*count = aiCalibrationData[channel].stat.count;
+	return aiCalibrationData[channel].status;
+}
+
+/**
+  * @brief  Сброс статистики выборок.
+  */
+void aiStatReset( AiCalibrationStat* stat )
+{
+	memset( stat, 0, sizeof(AiCalibrationStat) );
+}
+
+/**
+  * @brief  Добавление выборки в статистику.
+  */
+void aiStatAdd( AiCalibrationStat* stat, uint16_t sample )
+{
+	/* Отклонение от первой выборки. */
+	int32_t delta = 0;
+
+	if ( stat->count == 0 )
+	{
+		stat->origin = sample;
+		stat->min = sample;
+		stat->max = sample;
+	}
+	delta = (int32_t)sample - stat->origin;
+	stat->sum += delta;
+	stat->sumSq += (uint64_t)( (int64_t)delta * delta );
+	stat->count++;
+
+	if ( sample < stat->min )
+	{
+		stat->min = sample;
+	}
+	if ( sample > stat->max )
+	{
+		stat->max = sample;
+	}
+}
+
+/**
+  * @brief  Среднее выборок.
+  */
+double aiStatMean( const AiCalibrationStat* stat )
+{
+	if ( stat->count == 0 )
+	{
+		return 0;
+	}
+	return stat->origin + (double)stat->sum / stat->count;
+}
+
+/**
+  * @brief  Несмещенная дисперсия выборок.
+  */
+double aiStatVariance( const AiCalibrationStat* stat )
+{
+	if ( stat->count < 2 )
+	{
+		return 0;
+	}
+	double variance = ( (double)stat->sumSq - (double)stat->sum * stat->sum / stat->count ) / ( stat->count - 1 );
+	return ( variance > 0 ) ? variance : 0;
+}
+
+/**
+  * @brief  Проверка, что доверительный интервал среднего уже уже CALIBRATION_MEAN_TOLERANCE.
+  *         Проверка выполняется раз в CALIBRATION_CHECK_PERIOD выборок после CALIBRATION_MIN_SAMPLE.
+  * @retval 1 - набор выборок можно завершить.
+  */
+uint8_t aiStatIsStable( const AiCalibrationStat* stat )
+{
+	if ( ( stat->count < CALIBRATION_MIN_SAMPLE ) || ( stat->count % CALIBRATION_CHECK_PERIOD ) )
+	{
+		return 0;
+	}
+	/* z^2 * s^2 / n <= tol^2 */
+	return ( CALIBRATION_Z2 * aiStatVariance( stat ) ) <= ( CALIBRATION_MEAN_TOLERANCE * CALIBRATION_MEAN_TOLERANCE * stat->count );
+}
+
+/**
+  * @brief  Получение результата калибровки точки (для проверки точек мастером CAN).
+  * @param  channel:	номер канала.
+  * @param  ma:			значение тока точки (4..20).
+  * @param  adcValue:	среднее значение АЦП.
+  * @param  std:		СКО выборок.
+  * @param  count:		кол-во выборок.
+  * @retval 1 - точка в пределах CALIBRATION_MAX_STD, 0 - точка шумная или параметры неверные.
+  */
+uint8_t aiGetCalibrationPoint( uint8_t channel, uint8_t ma, uint16_t* adcValue, float* std, uint32_t* count )
+{
+	if ( ( channel >= AI_CH_NUM ) || ( ma < MA4 ) || ( ma > MA20 ) )
+	{
+		return 0;
+	}
+	*adcValue = aiCalibrationData[channel].adcValue[ma - 4];
+	*std = aiCalibrationData[channel].adcStd[ma - 4];
+	*count = aiCalibrationData[channel].adcCount[ma - 4];
+
+	return !( aiCalibrationData[channel].noisyMask & ( 1UL << ( ma - 4 ) ) );
+}
+
+/**
+  * @brief  Рассчет коэфициентов калибровки канала полиномом степени AI_CALIBRATION_ORDER
+  *         по методу наименьших квадратов через QR-разложение на приведенной к [-1, 1] выборке.
+  *         Отклонения точек от полинома доступны через aiGetCalibrationResidual.
+  * @param  channel:	номер канала.
+  */
 void aiCalcCalibration( uint8_t channel )
 {
 	/* Если введено неверное значение канала. */
@@ -851,32 +1561,47 @@ void aiCalcCalibration( uint8_t channel )
 		ADC_IDEAL_MA20,
 	};
 
-	double sum_x = 0, sum_x2 = 0, sum_x3 = 0, sum_x4 = 0;
-	double sum_y = 0, sum_xy = 0, sum_x2y = 0;
-
-	for (uint8_t i = 0; i < SIZE_ARRAY_RANGE_MA; i++) {
-		sum_x += aiCalibrationData[channel].adcValue[i];
-		sum_x2 += (double) aiCalibrationData[channel].adcValue[i] * aiCalibrationData[channel].adcValue[i];
-		sum_x3 += (double) aiCalibrationData[channel].adcValue[i] * aiCalibrationData[channel].adcValue[i] * aiCalibrationData[channel].adcValue[i];
-		sum_x4 += (double) aiCalibrationData[channel].adcValue[i] * aiCalibrationData[channel].adcValue[i] * aiCalibrationData[channel].adcValue[i] * aiCalibrationData[channel].adcValue[i];
-		sum_y += (double) idealADCValue[i];
-		sum_xy += (double) aiCalibrationData[channel].adcValue[i] * idealADCValue[i];
-		sum_x2y += (double) aiCalibrationData[channel].adcValue[i] * aiCalibrationData[channel].adcValue[i] * idealADCValue[i];
+	/* Матрица системы по степеням приведенной выборки. */
+	double m[SIZE_ARRAY_RANGE_MA][AI_CALIBRATION_COEF_NUM];
+	/* Правая часть системы. */
+	double y[SIZE_ARRAY_RANGE_MA];
+	/* Коэфициенты полинома по приведенной выборке. */
+	double p[AI_CALIBRATION_COEF_NUM];
+	/* Коэфициенты полинома по выборке (по возрастанию степени). */
+	double coef[4] = { 0 };
+	/* Границы выборок точек. */
+	uint16_t xMin = aiCalibrationData[channel].adcValue[0];
+	uint16_t xMax = aiCalibrationData[channel].adcValue[0];
+
+	for ( uint8_t i = 1; i < SIZE_ARRAY_RANGE_MA; i++ )
+	{
+		if ( aiCalibrationData[channel].adcValue[i] < xMin )
+		{
+			xMin = aiCalibrationData[channel].adcValue[i];
+		}
+		if ( aiCalibrationData[channel].adcValue[i] > xMax )
+		{
+			xMax = aiCalibrationData[channel].adcValue[i];
+		}
 	}
+	/* Выборка приводится к [-1, 1]: t = ( x - center ) / scale, иначе степени x до 45000^4 делают систему плохо обусловленной. */
+	double center = ( (double)xMin + xMax ) / 2;
+	double scale = ( (double)xMax - xMin ) / 2;
 
-	/* Матрица коэффициентов для системы уравнений. */
-	double A = sum_x4, B = sum_x3, C = sum_x2;
-	double D = sum_x3, E = sum_x2, F = sum_x;
-	double G = sum_x2, H = sum_x, I = SIZE_ARRAY_RANGE_MA;
-
-	/* Правая часть. */
-	double J = sum_x2y, K = sum_xy, L = sum_y;
-
-	/* Вычисляем определитель */
-    double denominator = A * (E * I - H * F) - B * (D * I - G * F) + C * (D * H - E * G);
+	for ( uint8_t i = 0; i < SIZE_ARRAY_RANGE_MA; i++ )
+	{
+		double t = ( scale > 0 ) ? ( aiCalibrationData[channel].adcValue[i] - center ) / scale : 0;
+		double tk = 1;
+		for ( uint8_t k = 0; k < AI_CALIBRATION_COEF_NUM; k++ )
+		{
+			m[i][k] = tk;
+			tk *= t;
+		}
+		y[i] = idealADCValue[i];
+	}
 
-	/* Проверка на нулевой определитель (система не может быть решена). */
-	if (denominator == 0)
+	/* Проверка, что система может быть решена (точки различны). */
+	if ( ( scale == 0 ) || !aiSolveLeastSquares( m, y, p ) )
 	{
 		/* Выставляем индикацию ошибки вычисления коэфициентов. */
 		for ( uint8_t channel = 0; channel < AI_CH_NUM; channel++ )
@@ -884,33 +1609,250 @@ void aiCalcCalibration( uint8_t channel )
 			aiDataLed[channel].color = COLOR_RED;
 			aiDataLed[channel].mode = MODE_ON;
 		}
-		isLedUpdate = 1;
+		ledUpdateMask = AI_LED_ALL;
 		userData.calibrationMode = CALIBRATION_WAIT;
 		return;
 	}
 
+	/* Отклонения точек от полинома. */
+	for ( uint8_t i = 0; i < SIZE_ARRAY_RANGE_MA; i++ )
+	{
+		double t = ( aiCalibrationData[channel].adcValue[i] - center ) / scale;
+		double value = 0;
+		for ( int8_t k = AI_CALIBRATION_COEF_NUM - 1; k >= 0; k-- )
+		{
+			value = value * t + p[k];
+		}
+		aiCalibrationData[channel].residual[i] = idealADCValue[i] - value;
+	}
+
+	/* Переводим полином из t в x подстановкой t = x / scale - center / scale по схеме Горнера. */
+	for ( int8_t k = AI_CALIBRATION_COEF_NUM - 1; k >= 0; k-- )
+	{
+		for ( uint8_t j = AI_CALIBRATION_COEF_NUM - 1; j > 0; j-- )
+		{
+			coef[j] = coef[j] * ( -center / scale ) + coef[j - 1] / scale;
+		}
+		coef[0] = coef[0] * ( -center / scale ) + p[k];
+	}
+
 	/* Вычисляем коэфициенты. */
-	aiDataFlash.coefA[channel] = (J * (E * I - H * F) - K * (D * I - G * F) + L * (D * H - E * G)) / denominator;
-	aiDataFlash.coefB[channel] = (A * (K * I - H * L) - B * (J * I - G * L) + C * (J * H - K * G)) / denominator;
-	aiDataFlash.coefC[channel] = (A * (E * L - K * F) - B * (D * L - J * F) + C * (D * K - E * J)) / denominator;
+	aiDataFlash.coefA[channel] = coef[2];
+	aiDataFlash.coefB[channel] = coef[1];
+	aiDataFlash.coefC[channel] = coef[0];
+	aiDataFlash.coefD[channel] = coef[3];
 	/* Переносим коэфициенты в структуру AI, чтобы результат калибровки можно было увидеть сразу. */
 	aiData[channel].coefA = aiDataFlash.coefA[channel];
 	aiData[channel].coefB = aiDataFlash.coefB[channel];
 	aiData[channel].coefC = aiDataFlash.coefC[channel];
+	aiData[channel].coefD = aiDataFlash.coefD[channel];
+	aiUpdateConversion( channel );
 	/* Сбрасываем значения каналов. */
 	aiReset();
 	userData.calibrationMode = CALIBRATION_WAIT;
 }
 
 /**
-  * @brief  Получение значений из flash.
+  * @brief  Решение переопределенной системы m * p = y методом наименьших квадратов
+  *         (QR-разложение отражениями Хаусхолдера). Матрица и правая часть разрушаются.
+  * @param  m:		матрица SIZE_ARRAY_RANGE_MA x AI_CALIBRATION_COEF_NUM.
+  * @param  y:		правая часть, SIZE_ARRAY_RANGE_MA значений.
+  * @param  p:		решение, AI_CALIBRATION_COEF_NUM значений.
+  * @retval 1 - решение найдено, 0 - столбцы матрицы линейно зависимы.
+  */
+uint8_t aiSolveLeastSquares( double m[][AI_CALIBRATION_COEF_NUM], double* y, double* p )
+{
+	/* Диагональ треугольной матрицы R. */
+	double diag[AI_CALIBRATION_COEF_NUM];
+
+	for ( uint8_t k = 0; k < AI_CALIBRATION_COEF_NUM; k++ )
+	{
+		double norm = 0;
+		for ( uint8_t i = k; i < SIZE_ARRAY_RANGE_MA; i++ )
+		{
+			norm += m[i][k] * m[i][k];
+		}
+		norm = sqrt( norm );
+		/* Столбцы масштабированы к [-1, 1], поэтому порог абсолютный. */
+		if ( norm < 1e-9 )
+		{
+			return 0;
+		}
+		/* Знак выбирается так, чтобы не было вычитания близких чисел. */
+		diag[k] = ( m[k][k] > 0 ) ? -norm : norm;
+		/* Вектор отражения v = x - diag * e хранится на месте столбца. */
+		m[k][k] -= diag[k];
+		double vv = 0;
+		for ( uint8_t i = k; i < SIZE_ARRAY_RANGE_MA; i++ )
+		{
+			vv += m[i][k] * m[i][k];
+		}
+		/* Отражаем оставшиеся столбцы и правую часть. */
+		for ( uint8_t j = k + 1; j <= AI_CALIBRATION_COEF_NUM; j++ )
+		{
+			double s = 0;
+			for ( uint8_t i = k; i < SIZE_ARRAY_RANGE_MA; i++ )
+			{
+				s += m[i][k] * ( ( j < AI_CALIBRATION_COEF_NUM ) ? m[i][j] : y[i] );
+			}
+			s = 2 * s / vv;
+			for ( uint8_t i = k; i < SIZE_ARRAY_RANGE_MA; i++ )
+			{
+				if ( j < AI_CALIBRATION_COEF_NUM )
+				{
+					m[i][j] -= s * m[i][k];
+				}
+				else
+				{
+					y[i] -= s * m[i][k];
+				}
+			}
+		}
+	}
+
+	/* Обратный ход по R * p = Q^T * y. */
+	for ( int8_t k = AI_CALIBRATION_COEF_NUM - 1; k >= 0; k-- )
+	{
+		double s = y[k];
+		for ( uint8_t j = k + 1; j < AI_CALIBRATION_COEF_NUM; j++ )
+		{
+			s -= m[k][j] * p[j];
+		}
+		p[k] = s / diag[k];
+	}
+	return 1;
+}
+
+/**
+  * @brief  Отклонение точки калибровки от полинома последнего расчета коэфициентов.
+  * @param  channel:	номер канала.
+  * @param  ma:			значение тока точки (4..20).
+  * @param  residual:	отклонение в кодах идеального АЦП.
+  * @retval 1 - параметры верные, 0 - параметры неверные.
+  */
+uint8_t aiGetCalibrationResidual( uint8_t channel, uint8_t ma, float* residual )
+{
+	if ( ( channel >= AI_CH_NUM ) || ( ma < MA4 ) || ( ma > MA20 ) )
+	{
+		return 0;
+	}
+	*residual = aiCalibrationData[channel].residual[ma - 4];
+	return 1;
+}
+
+/**
+  * @brief  Результаты замера скорости выборок и отклика канала.
+  * @param  channel:	номер канала.
+  * @param  stat:		копия результатов.
+  * @retval 1 - результаты скопированы, 0 - неверный канал или замер не собран (AI_BENCH_ENABLE).
+  */
+uint8_t aiGetBenchStat( uint8_t channel, AiBenchStat* stat )
+{
+#if AI_BENCH_ENABLE
+	if ( channel >= AI_CH_NUM )
+	{
+		return 0;
+	}
+	*stat = aiBenchData[channel].stat;
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+#if AI_BENCH_ENABLE
+
+/**
+  * @brief  Замер по обработанному блоку: подсчет выходных выборок и отклика на скачок.
+  *         Скачок определяется по току среднего сырого блока, отклик - по отфильтрованному току.
+  * @param  channel:	номер канала.
+  * @param  rawMean:	среднее сырых выборок блока.
+  * @param  outCnt:		кол-во выборок на выходе цепочки фильтров.
+  */
+void aiBenchUpdate( uint8_t channel, uint32_t rawMean, uint16_t outCnt )
+{
+	AiBenchData* bench = &aiBenchData[channel];
+	uint16_t raw = aiConvert( channel, rawMean << FILTER_FRAC_BITS );
+	uint32_t now = HAL_GetTick();
+	/* Величина скачка и пройденная часть, мкА. */
+	int32_t span;
+	int32_t done;
+
+	bench->outCnt += outCnt;
+	/* Окно подсчета выборок общее для всех каналов, закрывается на последнем канале. */
+	if ( ( channel == ( AI_CH_NUM - 1 ) ) && ( ( now - aiBenchTick ) >= AI_BENCH_WINDOW ) )
+	{
+		for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+		{
+			aiBenchData[ch].stat.sampleRate = (uint64_t)aiBenchData[ch].outCnt * 1000 / ( now - aiBenchTick );
+			aiBenchData[ch].outCnt = 0;
+		}
+		aiBenchTick = now;
+	}
+
+	/* Новый скачок перезапускает замер. */
+	if ( abs( (int32_t)raw - bench->rawCurrent ) >= AI_STEP_THRESHOLD )
+	{
+		bench->isStep = 1;
+		bench->isPassed63 = 0;
+		bench->stepFrom = bench->rawCurrent;
+		bench->stepTo = raw;
+		bench->stepTick = now;
+	}
+	bench->rawCurrent = raw;
+
+	if ( !bench->isStep )
+	{
+		return;
+	}
+	if ( ( now - bench->stepTick ) > AI_STEP_TIMEOUT )
+	{
+		bench->isStep = 0;
+		return;
+	}
+	span = (int32_t)bench->stepTo - bench->stepFrom;
+	done = (int32_t)aiData[channel].current - bench->stepFrom;
+	if ( span < 0 )
+	{
+		span = -span;
+		done = -done;
+	}
+	if ( !bench->isPassed63 && ( ( done * 100 ) >= ( span * 63 ) ) )
+	{
+		bench->isPassed63 = 1;
+		bench->latency63 = now - bench->stepTick;
+	}
+	if ( bench->isPassed63 && ( ( done * 10 ) >= ( span * 9 ) ) )
+	{
+		bench->isStep = 0;
+		bench->stat.stepCnt++;
+		bench->stat.latency63 = bench->latency63;
+		bench->stat.latency90 = now - bench->stepTick;
+	}
+}
+#endif
+
+/**
+  * @brief  Получение значений из flash: самая новая запись журнала,
+  *         если журнал пуст - данные старого формата по адресу FLASH_CALIBRATION_ADR.
   * @retval Статус flash.
   */
 FLASH_STATUS aiReadCalibrationData( void )
 {
-	static uint8_t operation = FLASH_READ;
-	/* Адрес памяти, с которым ведется работа. */
-	static uint32_t address = FLASH_CALIBRATION_ADR;
+	/* Ищем самую новую запись журнала. */
+	if ( !isJournalEmpty )
+	{
+		switch ( journalLoad( (uint8_t*)&aiDataFlashBuff, sizeof(AiDataFlashBuff) ) )
+		{
+			case JOURNAL_AT_WORK:
+				return FLASH_AT_WORK;
+			case JOURNAL_DONE:
+				return FLASH_DONE;
+			default:
+				isJournalEmpty = 1;
+				break;
+		}
+	}
 
 	/* Если флешка занята. */
 	if (flashGetStatus() == FLASH_BUSY)
@@ -918,44 +1860,124 @@ FLASH_STATUS aiReadCalibrationData( void )
 		return FLASH_AT_WORK;
 	}
 	/* Если операция = чтение данных. */
-	if ( operation == FLASH_READ )
+	if ( flashOperation == FLASH_READ )
 	{
 		/* Отправляем команду чтения. */
-		flashReadData( address, sizeof(AiDataFlash) );
-		operation = FLASH_GET_READED;
+		flashReadData( FLASH_CALIBRATION_ADR, sizeof(AiDataFlashBuff) );
+		flashOperation = FLASH_GET_READED;
 		return FLASH_AT_WORK;
 	}
 	/* Если операция = получить запрошенные данные. */
-	if ( operation == FLASH_GET_READED )
+	if ( flashOperation == FLASH_GET_READED )
 	{
 		/* Получаем данные. */
-		flashGetReadedData((uint8_t*) &aiDataFlash);
-		operation = FLASH_DEFAULT;
+		flashGetReadedData((uint8_t*) &aiDataFlashBuff);
+		flashOperation = FLASH_DEFAULT;
 	}
-	if ( operation == FLASH_DEFAULT )
+	if ( flashOperation == FLASH_DEFAULT )
 	{
-		operation = FLASH_READ;
-		address = 0x0;
+		flashOperation = FLASH_READ;
+		isJournalEmpty = 0;
 		return FLASH_DONE;
 	}
 
 	return FLASH_AT_WORK;
 };
 
+/**
+  * @brief  Сброс прерванного чтения калибровочных данных: следующее чтение начинается
+  *         с поиска в журнале, запись в журнал до его полной загрузки не выполняется.
+  */
+void aiReadCalibrationReset( void )
+{
+	journalReset();
+	flashOperation = FLASH_READ;
+	isJournalEmpty = 0;
+}
+
+/**
+  * @brief  Таймаут операции с флешкой: отсчет идет заново каждый раз, когда флешка свободна,
+  *         поэтому время загрузки журнала (кол-во чтений) на таймаут не влияет.
+  * @retval 1 - флешка занята дольше AI_FLASH_OP_TIMEOUT, 0 - флешка отвечает.
+  */
+uint8_t aiFlashTimeout( void )
+{
+	if ( flashGetStatus() != FLASH_BUSY )
+	{
+		flashOpTick = HAL_GetTick();
+		return 0;
+	}
+	return ( HAL_GetTick() - flashOpTick ) >= AI_FLASH_OP_TIMEOUT;
+}
+
+/**
+  * @brief  Проверка прочитанных с flash данных и перенос их в aiDataFlash.
+  *         Данные первой версии (без заголовка) переносятся в текущую структуру,
+  *         общие настройки фильтров копируются во все каналы.
+  * @retval Результат проверки.
+  */
+FLASH_DATA_STATUS aiCheckFlashData( void )
+{
+	/* CRC данных из флешки. */
+	uint32_t crc = 0;
+	/* Размер структуры в записанной версии. */
+	uint16_t size = aiDataFlashBuff.data.size;
+
+	/* Структура с заголовком: версия не старше текущей, размер в пределах буфера. */
+	if ( ( aiDataFlashBuff.data.version >= 2 ) && ( aiDataFlashBuff.data.version <= AI_FLASH_VERSION )
+			&& ( size > sizeof(uint32_t) ) && ( size <= sizeof(AiDataFlash) ) && ( ( size % sizeof(uint32_t) ) == 0 ) )
+	{
+		crc = HAL_CRC_Calculate( &hcrc, (uint32_t*)&aiDataFlashBuff.data.version, ( size - sizeof(uint32_t) ) / sizeof(uint32_t) );
+		if ( crc == aiDataFlashBuff.data.crc )
+		{
+			/* Поля, которых нет в записанной версии, остаются нулевыми. */
+			memset( &aiDataFlash, 0, sizeof(AiDataFlash) );
+			memcpy( &aiDataFlash, &aiDataFlashBuff.data, size );
+			return FLASH_DATA_VALID;
+		}
+	}
+
+	/* Если CRC первой версии нет (флешка чистая). */
+	if ( ( aiDataFlashBuff.dataV1.crc == 0 ) || ( aiDataFlashBuff.dataV1.crc == 0xFFFFFFFF ) )
+	{
+		return FLASH_DATA_EMPTY;
+	}
+	/* Сохраняем прочитанную CRC. */
+	crc = aiDataFlashBuff.dataV1.crc;
+	/* Обнуляем CRC в структуре для рассчета CRC без самой CRC. */
+	aiDataFlashBuff.dataV1.crc = 0;
+	/* Если CRC не совпадают. */
+	if ( crc != HAL_CRC_Calculate( &hcrc, (uint32_t*)&aiDataFlashBuff.dataV1, sizeof(AiDataFlashV1) / sizeof(uint32_t) ) )
+	{
+		return FLASH_DATA_CRC_ERROR;
+	}
+	/* Переносим данные первой версии. */
+	memset( &aiDataFlash, 0, sizeof(AiDataFlash) );
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
+	{
+		aiDataFlash.coefA[ch] = aiDataFlashBuff.dataV1.coefA[ch];
+		aiDataFlash.coefB[ch] = aiDataFlashBuff.dataV1.coefB[ch];
+		aiDataFlash.coefC[ch] = aiDataFlashBuff.dataV1.coefC[ch];
+		aiDataFlash.filterExpCurrent[ch] = aiDataFlashBuff.dataV1.filterExpCurrent;
+		aiDataFlash.filterAvgSize[ch] = aiDataFlashBuff.dataV1.filterAvgSize;
+	}
+	return FLASH_DATA_VALID;
+}
+
 /**
   * @brief Сохранение коэфициентов и настроек фильтрации на flash.
   */
 void aiCalibrationSaveData( void )
 {
-	/* Следующая операция с флешкой. */
-	static uint8_t operation = FLASH_ERASE_SECTOR;
-	/* Адрес, куда записывать данные. */
-	static uint32_t address = FLASH_CALIBRATION_ADR;
-	/* Статус флешки. */
-	static uint8_t statusFlash = FLASH_BUSY;
-	/* CRC. */
-	static uint32_t crc = 0;
+	/* Результат записи в журнал. */
+	JOURNAL_STATUS status;
 
+	/* Начало записи - отсчет таймаута флешки. */
+	if ( !isFlashSaving )
+	{
+		isFlashSaving = 1;
+		flashOpTick = HAL_GetTick();
+	}
 	/* Если индикация записи в флешку не была включена. */
 	if ( !isSaveLedEnabled )
 	{
@@ -965,78 +1987,70 @@ void aiCalibrationSaveData( void )
 			aiDataLed[ch].color = COLOR_YELLOW;
 			aiDataLed[ch].mode = MODE_FLICK;
 		}
-		isLedUpdate = 1;
+		ledUpdateMask = AI_LED_ALL;
 		isSaveLedEnabled = 1;
 	}
 
-	/* Обнуляем CRC. */
-	aiDataFlash.crc = 0;
+	/* Заполняем заголовок структуры. */
+	aiDataFlash.version = AI_FLASH_VERSION;
+	aiDataFlash.size = sizeof(AiDataFlash);
 	/* Сохраняем значения фильтрации. */
-	aiDataFlash.filterAvgSize = filterAvgSize;
-	aiDataFlash.filterExpCurrent = filterExpCurrent;
-
-	/* Получаем байтовый указатель на сохраняемую структуру. */
-	uint8_t* ptrToDataFlash = (uint8_t*)&aiDataFlash;
-	/* Считаем crc. */
-	crc = HAL_CRC_Calculate( &hcrc, (uint32_t*)ptrToDataFlash, sizeof(AiDataFlash)/sizeof(uint32_t) );
-	/* Записывам crc в структуру. */
-	aiDataFlash.crc = crc;
-
-	/* Получаем статус флешки. */
-	statusFlash = flashGetStatus();
-	/* Если флешка занята. */
-	if (statusFlash == FLASH_BUSY)
-	{
-		return;
-	}
-	/* Если флешка свободна на чтение. */
-	if (statusFlash == FLASH_FREE_R)
+	for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
 	{
-		flashSetWriteMode();
+		aiDataFlash.filterAvgSize[ch] = aiData[ch].filterAvgSize;
+		aiDataFlash.filterExpCurrent[ch] = aiData[ch].filterExpCurrent;
 	}
-	/* Если флешка свободна на чтение и запись. */
-	if (statusFlash == FLASH_FREE_RW)
+
+	/* Считаем crc по структуре после поля crc. */
+	aiDataFlash.crc = HAL_CRC_Calculate( &hcrc, (uint32_t*)&aiDataFlash.version, ( sizeof(AiDataFlash) - sizeof(uint32_t) ) / sizeof(uint32_t) );
+
+	/* Добавляем запись в журнал, сектор стирается только при заполнении предыдущего. */
+	status = journalAppend( (uint8_t*)&aiDataFlash, sizeof(AiDataFlash) );
+	/* Загрузка при старте не завершилась - место записи ищется заново, прочитанная запись не нужна. */
+	if ( status == JOURNAL_NOT_LOADED )
 	{
-		/* Если операция = очистить сектор. */
-		if ( operation == FLASH_ERASE_SECTOR )
+		status = journalLoad( (uint8_t*)&aiDataFlashBuff, sizeof(AiDataFlashBuff) );
+		if ( ( status == JOURNAL_DONE ) || ( status == JOURNAL_EMPTY ) )
 		{
-			/* Очищаем сектор. */
-			flashEraseSector(address);
-			operation = FLASH_SAVE;
-			return;
+			/* Запись - на следующем вызове. */
+			status = JOURNAL_AT_WORK;
 		}
-		/* Если операция = сохранить данные на флешку. */
-		if ( operation == FLASH_SAVE )
+	}
+	if ( status == JOURNAL_AT_WORK )
+	{
+		if ( !aiFlashTimeout() )
 		{
-			/* Записываем данные на флешку. */
-			flashWriteData( address, ptrToDataFlash, sizeof(AiDataFlash) );
-			operation = FLASH_DEFAULT;
 			return;
 		}
-		/* Если операция = сбросить состояния к изначальному. */
-		if ( operation == FLASH_DEFAULT )
+		/* Флешка не отвечает - запись отменяется. */
+		journalReset();
+		status = JOURNAL_ERROR;
+	}
+	/* Запись не сохранена - выставляем индикацию ошибки флешки. */
+	if ( status == JOURNAL_ERROR )
+	{
+		for ( uint8_t ch = 0; ch < AI_CH_NUM; ch++ )
 		{
-			/* Возвращаем адрес к исходному. */
-			address = FLASH_CALIBRATION_ADR;
-			/* Возвращаем операцию к исходной. */
-			operation = FLASH_ERASE_SECTOR;
-			/* Сбрасываем режим калибрации в wait. */
-			userData.calibrationMode = CALIBRATION_WAIT;
-			/* Меняем канал калибрации на по умолчанию. */
-			calibrationCh = CALIBRATION_NO_CHANNEL;
-			/* Сбрасываем флаг включенной индикации записи во флешку. */
-			isSaveLedEnabled = 1;
-			isLedUpdate = 1;
-			/* Обнуляем crc. */
-			crc = 0;
-			return;
+			aiDataLed[ch].colorWorking = COLOR_RED;
+			aiDataLed[ch].modeWorking = MODE_BLINK;
+
+			aiDataLed[ch].color = COLOR_RED;
+			aiDataLed[ch].mode = MODE_BLINK;
 		}
 	}
+	isFlashSaving = 0;
+	/* Сбрасываем режим калибрации в wait. */
+	userData.calibrationMode = CALIBRATION_WAIT;
+	/* Меняем канал калибрации на по умолчанию. */
+	calibrationCh = CALIBRATION_NO_CHANNEL;
+	/* Сбрасываем флаг включенной индикации записи во флешку. */
+	isSaveLedEnabled = 1;
+	ledUpdateMask = AI_LED_ALL;
 }
 
 
 void aiSPITxRxCallback( void )
 {
-	/* Выставляем флаг, что данные с АЦП приняты. */
-	isSampleReceived = 1;
+	/* Обмен с АЦП идет только при сканировании каналов. */
+	aiScanCallback();
 }
@@ -0,0 +1,339 @@
+#include "filter.h"
+
+#include "string.h"
+
+/* ________________________ FUNCTION'S PROTOTYPE ________________________ */
+uint8_t filterCheckParam( FILTER_TYPE type, uint32_t param );
+uint8_t filterLayout( FilterChain* chain );
+void filterSeedStage( FilterChain* chain, uint8_t num, uint32_t value );
+void filterMedian( FilterStageState* state, uint32_t width, uint32_t* block, uint16_t size );
+void filterAverage( FilterStageState* state, uint32_t* buff, uint32_t width, uint32_t* block, uint16_t size );
+void filterExp( FilterStageState* state, uint32_t alpha, uint32_t* block, uint16_t size );
+uint16_t filterDecimate( FilterStageState* state, uint32_t factor, uint32_t* block, uint16_t size );
+
+/**
+  * @brief  Инициализация цепочки фильтров по таблице ступеней.
+  * @param  chain:		указатель на цепочку.
+  * @param  stages:		таблица из FILTER_MAX_STAGES ступеней, неиспользуемые - FILTER_NONE.
+  * @retval 1 - цепочка задана верно, 0 - неверный параметр или не хватает буфера среднего.
+  */
+uint8_t filterInit( FilterChain* chain, const FilterStage* stages )
+{
+	memcpy( chain->stage, stages, sizeof(chain->stage) );
+
+	for ( uint8_t i = 0; i < FILTER_MAX_STAGES; i++ )
+	{
+		if ( !filterCheckParam( chain->stage[i].type, chain->stage[i].param ) )
+		{
+			chain->stage[i].type = FILTER_NONE;
+			return 0;
+		}
+	}
+
+	if ( !filterLayout( chain ) )
+	{
+		return 0;
+	}
+
+	filterReset( chain, 0 );
+	return 1;
+}
+
+/**
+  * @brief  Сброс истории всех ступеней цепочки.
+  * @param  chain:		указатель на цепочку.
+  * @param  value:		значение, которым заполняется история.
+  */
+void filterReset( FilterChain* chain, uint32_t value )
+{
+	for ( uint8_t i = 0; i < FILTER_MAX_STAGES; i++ )
+	{
+		filterSeedStage( chain, i, value );
+	}
+	chain->out = value;
+}
+
+/**
+  * @brief  Изменение параметра ступеней заданного типа без сброса остальных ступеней.
+  *         История измененной ступени заполняется ее последним выходным значением,
+  *         поэтому выход цепочки не скачет.
+  * @param  chain:		указатель на цепочку.
+  * @param  type:		тип ступени.
+  * @param  param:		новый параметр.
+  * @retval 1 - параметр применен, 0 - параметр неверный или ступени такого типа нет.
+  */
+uint8_t filterSetParam( FilterChain* chain, FILTER_TYPE type, uint32_t param )
+{
+	/* Предыдущие параметры на случай отката. */
+	uint32_t prevParam[FILTER_MAX_STAGES];
+	/* Флаг, что ступень такого типа найдена. */
+	uint8_t isFound = 0;
+
+	if ( ( type == FILTER_NONE ) || !filterCheckParam( type, param ) )
+	{
+		return 0;
+	}
+
+	for ( uint8_t i = 0; i < FILTER_MAX_STAGES; i++ )
+	{
+		prevParam[i] = chain->stage[i].param;
+		if ( chain->stage[i].type == type )
+		{
+			chain->stage[i].param = param;
+			isFound = 1;
+		}
+	}
+
+	if ( !isFound )
+	{
+		return 0;
+	}
+
+	/* Окна среднего не помещаются в буфер - откатываем изменения. */
+	if ( !filterLayout( chain ) )
+	{
+		for ( uint8_t i = 0; i < FILTER_MAX_STAGES; i++ )
+		{
+			chain->stage[i].param = prevParam[i];
+		}
+		filterLayout( chain );
+		return 0;
+	}
+
+	/* Экспоненциальному фильтру достаточно нового коэфициента. */
+	if ( type == FILTER_EXP )
+	{
+		return 1;
+	}
+
+	for ( uint8_t i = 0; i < FILTER_MAX_STAGES; i++ )
+	{
+		if ( chain->stage[i].type == type )
+		{
+			filterSeedStage( chain, i, chain->state[i].out );
+		}
+	}
+	return 1;
+}
+
+/**
+  * @brief  Обработка блока выборок цепочкой фильтров, результат записывается в тот же блок.
+  * @param  chain:		указатель на цепочку.
+  * @param  block:		блок выборок.
+  * @param  size:		кол-во выборок в блоке.
+  * @retval кол-во выборок в блоке после обработки (меньше входного при прореживании).
+  */
+uint16_t filterProcess( FilterChain* chain, uint32_t* block, uint16_t size )
+{
+	for ( uint8_t i = 0; ( i < FILTER_MAX_STAGES ) && size; i++ )
+	{
+		FilterStageState* state = &chain->state[i];
+		uint32_t param = chain->stage[i].param;
+
+		switch ( chain->stage[i].type )
+		{
+			case FILTER_MEDIAN:
+				filterMedian( state, param, block, size );
+				break;
+			case FILTER_AVERAGE:
+				filterAverage( state, &chain->avgBuff[state->offset], param, block, size );
+				break;
+			case FILTER_EXP:
+				filterExp( state, param, block, size );
+				break;
+			case FILTER_DECIMATE:
+				size = filterDecimate( state, param, block, size );
+				break;
+			default:
+				continue;
+		}
+
+		if ( size )
+		{
+			state->out = block[size - 1];
+		}
+	}
+
+	if ( size )
+	{
+		chain->out = block[size - 1];
+	}
+	return size;
+}
+
+/**
+  * @brief  Последнее выходное значение цепочки.
+  */
+uint32_t filterGetOutput( const FilterChain* chain )
+{
+	return chain->out;
+}
+
+/**
+  * @brief  Проверка параметра ступени.
+  */
+uint8_t filterCheckParam( FILTER_TYPE type, uint32_t param )
+{
+	switch ( type )
+	{
+		case FILTER_NONE:
+			return 1;
+		case FILTER_MEDIAN:
+			return ( param & 1 ) && ( param >= 3 ) && ( param <= FILTER_MAX_MEDIAN );
+		case FILTER_AVERAGE:
+			return ( param >= 1 ) && ( param <= SIZE_ARRAY_AVERAGE );
+		case FILTER_EXP:
+			return ( param >= 1 ) && ( param <= ( 1UL << 16 ) );
+		case FILTER_DECIMATE:
+			return ( param >= 1 ) && ( param <= FILTER_MAX_DECIMATE );
+		default:
+			return 0;
+	}
+}
+
+/**
+  * @brief  Распределение общего буфера среднего между ступенями скользящего среднего.
+  * @retval 1 - окна помещаются в буфер, 0 - не помещаются.
+  */
+uint8_t filterLayout( FilterChain* chain )
+{
+	uint16_t offset = 0;
+
+	for ( uint8_t i = 0; i < FILTER_MAX_STAGES; i++ )
+	{
+		if ( chain->stage[i].type == FILTER_AVERAGE )
+		{
+			if ( ( offset + chain->stage[i].param ) > SIZE_ARRAY_AVERAGE )
+			{
+				return 0;
+			}
+			chain->state[i].offset = offset;
+			offset += chain->stage[i].param;
+		}
+	}
+	return 1;
+}
+
+/**
+  * @brief  Заполнение истории ступени значением.
+  */
+void filterSeedStage( FilterChain* chain, uint8_t num, uint32_t value )
+{
+	FilterStageState* state = &chain->state[num];
+	uint32_t param = chain->stage[num].param;
+
+	state->pos = 0;
+	state->sum = 0;
+	state->out = value;
+
+	if ( chain->stage[num].type == FILTER_MEDIAN )
+	{
+		for ( uint8_t i = 0; i < FILTER_MAX_MEDIAN; i++ )
+		{
+			state->window[i] = value;
+		}
+	}
+	else
+	if ( chain->stage[num].type == FILTER_AVERAGE )
+	{
+		for ( uint16_t i = 0; i < param; i++ )
+		{
+			chain->avgBuff[state->offset + i] = value;
+		}
+		state->sum = value * param;
+	}
+}
+
+/**
+  * @brief  Медианный фильтр по скользящему окну нечетной ширины.
+  */
+void filterMedian( FilterStageState* state, uint32_t width, uint32_t* block, uint16_t size )
+{
+	/* Отсортированная копия окна. */
+	uint32_t sorted[FILTER_MAX_MEDIAN];
+
+	for ( uint16_t n = 0; n < size; n++ )
+	{
+		state->window[state->pos] = block[n];
+		if ( ++state->pos == width )
+		{
+			state->pos = 0;
+		}
+		/* Сортировка вставками, окно не больше FILTER_MAX_MEDIAN. */
+		for ( uint8_t i = 0; i < width; i++ )
+		{
+			uint32_t value = state->window[i];
+			uint8_t j = i;
+			while ( j && ( sorted[j - 1] > value ) )
+			{
+				sorted[j] = sorted[j - 1];
+				j--;
+			}
+			sorted[j] = value;
+		}
+		block[n] = sorted[width / 2];
+	}
+}
+
+/**
+  * @brief  Скользящее среднее по кольцевому окну.
+  */
+void filterAverage( FilterStageState* state, uint32_t* buff, uint32_t width, uint32_t* block, uint16_t size )
+{
+	uint32_t sum = state->sum;
+	uint16_t pos = state->pos;
+
+	for ( uint16_t n = 0; n < size; n++ )
+	{
+		sum += block[n] - buff[pos];
+		buff[pos] = block[n];
+		if ( ++pos == width )
+		{
+			pos = 0;
+		}
+		block[n] = sum / width;
+	}
+
+	state->sum = sum;
+	state->pos = pos;
+}
+
+/**
+  * @brief  Экспоненциальный фильтр с коэфициентом в Q16.
+  *         Состояние хранится с 16 дополнительными дробными битами (остаток ниже выхода - в state->sum),
+  *         иначе шаг меньше 2^16 / alpha отбрасывался бы и выход не доходил до входа.
+  *         Выход округляется до ближайшего.
+  */
+void filterExp( FilterStageState* state, uint32_t alpha, uint32_t* block, uint16_t size )
+{
+	int64_t acc = ( (int64_t)state->out << 16 ) + (int32_t)state->sum;
+
+	for ( uint16_t n = 0; n < size; n++ )
+	{
+		acc += ( ( ( (int64_t)block[n] << 16 ) - acc ) * alpha ) >> 16;
+		block[n] = ( acc + 0x8000 ) >> 16;
+	}
+	/* Остаток относительно последнего выхода, который filterProcess запишет в state->out. */
+	state->sum = (uint32_t)(int32_t)( acc - ( (int64_t)block[size - 1] << 16 ) );
+}
+
+/**
+  * @brief  CIC 1-го порядка: среднее по factor выборкам с прореживанием в factor раз.
+  * @retval кол-во выборок после прореживания.
+  */
+uint16_t filterDecimate( FilterStageState* state, uint32_t factor, uint32_t* block, uint16_t size )
+{
+	uint16_t outSize = 0;
+
+	for ( uint16_t n = 0; n < size; n++ )
+	{
+		state->sum += block[n];
+		if ( ++state->pos == factor )
+		{
+			block[outSize++] = state->sum / factor;
+			state->sum = 0;
+			state->pos = 0;
+		}
+	}
+	return outSize;
+}
@@ -5,7 +5,27 @@
 #include "tim.h"
 #include "string.h"
 
+#include "hart.h"
+#include "hartframe.h"
 #include "led.h"
+#include "sched.h"
+#include "prof.h"
+
+/* Типы транзакций HART. */
+enum HART_TRANSACTION
+{
+	/* Передача буфера TX мастера CAN. */
+	HART_TRANSACTION_TX			=	0,
+	/* Прием ответа в буфер RX мастера CAN. */
+	HART_TRANSACTION_RX			=	1,
+	/* Циклический опрос устройства модулем: запрос и прием ответа во внутренние буферы. */
+	HART_TRANSACTION_POLL		=	2,
+	/* Прослушивание свободной линии канала (burst-сообщения), в очередь не ставится. */
+	HART_TRANSACTION_LISTEN		=	3,
+};
+
+/* Кол-во циклических команд (1..3). */
+#define HART_CYCLIC_CMD_NUM			3
 
 /* Мьютекс берется каждый раз, когда происходит любое действие (прием/передача) на любом из каналов
  * Освобождается при завершении операции */
@@ -14,10 +34,122 @@ volatile uint8_t flagBusy = 0;
 /* Номер канала, на котором была совершена последняя операция */
 volatile uint8_t activeCH = 0;
 
+/* Канал, с которого продолжается выбор по кругу. Транзакции HART_PRIORITY_ALARM его не сдвигают,
+ * иначе после каждой из них выигрывал бы один и тот же следующий канал */
+uint8_t roundCH = 0;
+
+/* Тип транзакции, которая выполняется на activeCH */
+volatile uint8_t activeTransaction = HART_TRANSACTION_TX;
+
+/* Флаг, что на activeCH завершилась передача и ожидается ответ устройства */
+volatile uint8_t flagWaitResponse = 0;
+
 volatile uint8_t flagToTransmitPDO = 0;
 
+/* Флаги каналов в масках: биты 0..5 - передача, биты 8..13 - прием */
+#define HART_FLAG_TX( ch )			( 1 << (ch) )
+#define HART_FLAG_RX( ch )			( 1 << ( (ch) + 8 ) )
+#define HART_FLAG_TX_ALL			0x003F
+
+/* Флаги разрешения передачи/приема от мастера CAN на прошлом проходе hartProcess */
+uint16_t hartEnFlags = 0;
+
+/* Флаги завершения передачи/приема на прошлом проходе hartProcess */
+uint16_t hartCompletedFlags = 0;
+
+/* Счетчик флагов завершения, выставленных модулем: снимок флагов мастера повторяется, если он изменился */
+volatile uint8_t completedSeq = 0;
+
+/* Время отправки последнего PDO4, мс */
+uint32_t pdoTick = 0;
+
+/* Флаг, что передается преамбула, за ней передается кадр */
+volatile uint8_t flagTxPreamble = 0;
+
+/* Размер передаваемого кадра с контрольной суммой */
+volatile uint16_t txFrameSize = 0;
+
 volatile uint8_t timerTickCounter = 0;
 
+/* Флаг, что по приему уже пришел первый байт (время ответа учтено) */
+volatile uint8_t flagFirstByte = 0;
+
+/* Флаг, что окно приема ограничено таймаутом ответа (при прослушивании - нет) */
+volatile uint8_t flagRxTimeout = 0;
+
+/* Положение записи в кольце приема на прошлом тике таймера, по нему видны новые байты */
+volatile uint16_t rxHead = 0;
+
+/* Передаваемый кадр (от разделителя) */
+uint8_t* txFrame = 0;
+
+/* Флаг, что опрос или прослушивание завершены (кадр принят или таймаут) и ждут разбора в hartProcess */
+volatile uint8_t flagPollDone = 0;
+
+/* Флаг, что открыто окно приема: кадр, закончившийся паузой на линии, отдается транзакции activeCH */
+volatile uint8_t flagRxWindow = 0;
+
+/* Положение в кольце приема, с которого начинается следующий кадр */
+volatile uint16_t rxStart = 0;
+
+/* Канал, который прослушивается в свободное время */
+uint8_t listenCH = 0;
+
+/* Время начала прослушивания listenCH, мс */
+uint32_t listenTick = 0;
+
+/* Принятый кадр в кольце приема */
+typedef struct HartRxFrame
+{
+	/* Смещение первого байта в кольце */
+	uint16_t offset;
+	/* Кол-во байт, 0 - таймаут */
+	uint16_t length;
+} HartRxFrame;
+
+/* Транзакция в очереди канала */
+typedef struct HartTransaction
+{
+	uint8_t type;
+	uint8_t priority;
+} HartTransaction;
+
+/* Очередь транзакций канала, упорядочена по приоритету (внутри приоритета - по порядку добавления) */
+typedef struct HartQueue
+{
+	HartTransaction item[HART_QUEUE_SIZE];
+	uint8_t count;
+} HartQueue;
+
+/* Кэш ответов устройства на циклические команды */
+typedef struct HartCache
+{
+	/* Длинный адрес устройства из ответа на команду 0 (с битом первичного мастера) */
+	uint8_t address[HART_LONG_ADDR_SIZE];
+	/* Флаг, что адрес устройства известен */
+	uint8_t isAddressValid;
+	/* Кол-во неудачных опросов подряд */
+	uint8_t missCnt;
+	/* Циклическая команда, которая опрашивается следующей */
+	uint8_t command;
+	/* Команда, отправленная при текущем опросе */
+	uint8_t pollCommand;
+	/* Время начала последнего цикла опроса, мс */
+	uint32_t pollTick;
+	/* Флаг, что в последнем ответе устройство сообщило аварию (HART_ALARM_STATUS_MASK) */
+	uint8_t isAlarm;
+	/* Данные ответов (с двумя байтами статуса), по индексу команда - 1 */
+	uint8_t data[HART_CYCLIC_CMD_NUM][HART_CACHE_DATA_SIZE];
+	/* Размер данных ответов, 0 - ответа не было */
+	uint8_t size[HART_CYCLIC_CMD_NUM];
+	/* Время получения ответов, мс */
+	uint32_t tick[HART_CYCLIC_CMD_NUM];
+	/* Флаг, что устройство присылало burst-сообщения */
+	uint8_t isBurstSeen;
+	/* Время последнего burst-сообщения, мс */
+	uint32_t burstTick;
+} HartCache;
+
 /* Структора под отдельный канал */
 typedef struct HartData
 {
@@ -27,16 +159,52 @@ typedef struct HartData
 	uint16_t *pointerRxSize;
 	uint16_t *pointerTxSize;
 
-	uint8_t localHartFlagTxEn;
-	uint8_t localHartFlagRxEn;
-	uint8_t localHartFlagTxCompleted;
-	uint8_t localHartFlagRxCompleted;
-
 	uint8_t tickForTimeout;
 
 	uint8_t muxValue;
+
+	/* Очередь транзакций канала */
+	HartQueue queue;
+	/* Битовая маска типов транзакций, которые стоят в очереди или выполняются */
+	uint8_t pendingMask;
+	/* Флаг, что устройство уже отвечало (время ответа известно) */
+	uint8_t isResponded;
+	/* Сглаженное время ответа устройства * 8 (в тиках таймера) */
+	uint16_t srtt;
+	/* Сглаженное отклонение времени ответа * 4 */
+	uint16_t rttvar;
+	/* Кол-во завершенных транзакций */
+	uint32_t transactionCnt;
+	/* Кол-во таймаутов */
+	uint32_t timeoutCnt;
+	/* Кол-во поврежденных кадров */
+	uint32_t errorCnt;
+	/* Кэш циклических команд */
+	HartCache cache;
 } HartData;
 
+/* ________________________ FUNCTION'S PROTOTYPE ________________________ */
+uint8_t hartEnqueue( uint8_t channel, uint8_t type, uint8_t priority );
+uint8_t hartSchedule( uint8_t* channel, HartTransaction* transaction );
+void hartStartTransaction( uint8_t channel, const HartTransaction* transaction );
+void hartFinishTransaction( void );
+void hartUpdateTimeout( uint8_t channel, uint8_t ticks );
+void hartBackoffTimeout( uint8_t channel );
+void hartSetCompleted( uint8_t channel, uint8_t isTx, uint8_t isRx );
+void hartStartTransmit( void );
+void hartStartReceive( uint8_t isTimeout );
+void hartRxProgress( uint16_t head );
+void hartRxFrameEnd( uint16_t head );
+uint16_t hartRingHead( void );
+uint16_t hartRingCopy( uint8_t* buff, const HartRxFrame* rx );
+void hartStartListen( void );
+uint8_t hartListenExpired( void );
+void hartBurstStore( uint8_t channel, uint16_t size );
+uint8_t hartCyclicNext( uint8_t command );
+void hartCyclicPoll( uint8_t channel );
+void hartCyclicStore( uint8_t channel, uint16_t size );
+uint8_t hartCacheAnswer( uint8_t channel );
+
 HartData hartData[6] =
 {
 	{ userData.rxBuffCH1, userData.txBuffCH1, &userData.sizeRxBuffer[0], &userData.sizeTxBuffer[0] },
@@ -47,10 +215,20 @@ HartData hartData[6] =
 	{ userData.rxBuffCH6, userData.txBuffCH6, &userData.sizeRxBuffer[5], &userData.sizeTxBuffer[5] },
 };
 
-uint8_t hart_request3[] = {
-		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x82, 0xA6, 0x18, 0x51, 0x62, 0xA7, 0x03,
-		0x00, 0xAB, 0x00,
-};
+/* Преамбула передаваемого кадра */
+uint8_t hartPreamble[HART_PREAMBLE_TX];
+
+/* Кадр запроса при опросе модулем */
+uint8_t hartPollTxBuff[HART_REQUEST_SIZE];
+
+/* Буфер разбора ответа при опросе модулем и burst-сообщения */
+uint8_t hartPollRxBuff[SIZE_HART_BUFF];
+
+/* Кольцо непрерывного приема с DMA */
+uint8_t hartRing[HART_RING_SIZE];
+
+/* Кадр, принятый при опросе модулем или прослушивании */
+volatile HartRxFrame pollRxFrame;
 
 
 void hartInit()
@@ -71,139 +249,919 @@ void hartInit()
 	hartData[4].muxValue = 0b101;
 	hartData[5].muxValue = 0b100;
 
+	/* Таймауты до первого ответа устройства, дальше подстраиваются по времени ответа */
 	hartData[0].tickForTimeout = 30;
 	hartData[1].tickForTimeout = 30;
 	hartData[2].tickForTimeout = 30;
 	hartData[3].tickForTimeout = 30;
 	hartData[4].tickForTimeout = 120;
 	hartData[5].tickForTimeout = 30;
+
+	memset(hartPreamble, HART_PREAMBLE_BYTE, HART_PREAMBLE_TX);
+
+	for (int numCH = 0; numCH < AI_CH_NUM; numCH++)
+	{
+		hartData[numCH].cache.command = hartCyclicNext( HART_CYCLIC_CMD_NUM );
+	}
+
+	/* Прием идет непрерывно по кольцу, кадры выделяются по паузе на линии */
+	huart1.hdmarx->Init.Mode = DMA_CIRCULAR;
+	HAL_DMA_Init(huart1.hdmarx);
+	HAL_UARTEx_ReceiveToIdle_DMA(&huart1, hartRing, HART_RING_SIZE);
 }
 
 void hartProcess()
 {
-	for (int numCH = 0; numCH < AI_CH_NUM; numCH++)
+	/* Канал и транзакция, выбранные планировщиком */
+	uint8_t channel = 0;
+	HartTransaction transaction;
+	/* Снимок флагов мастера CAN */
+	uint16_t en;
+	uint16_t completed;
+	uint8_t seq;
+	/* Незавершенные запросы мастера */
+	uint16_t pending;
+
+	PROF_BEGIN( PROF_HART_PROCESS );
+
+	/* Снимок флагов в маски, повторяется, если прерывание выставило флаг завершения во время снимка */
+	do
 	{
-		if ( hartData[numCH].localHartFlagTxEn != userData.hartFlagTxEn[numCH] )
+		seq = completedSeq;
+		en = 0;
+		completed = 0;
+		for (int numCH = 0; numCH < AI_CH_NUM; numCH++)
 		{
-			hartData[numCH].localHartFlagTxEn = userData.hartFlagTxEn[numCH];
-			flagToTransmitPDO = 1;
+			en |= ( userData.hartFlagTxEn[numCH] ? HART_FLAG_TX( numCH ) : 0 ) | ( userData.hartFlagRxEn[numCH] ? HART_FLAG_RX( numCH ) : 0 );
+			completed |= ( userData.hartFlagTxCompleted[numCH] ? HART_FLAG_TX( numCH ) : 0 ) | ( userData.hartFlagRxCompleted[numCH] ? HART_FLAG_RX( numCH ) : 0 );
 		}
+	} while ( seq != completedSeq );
+
+	/* Любое изменение флагов - повод для PDO4 */
+	if ( ( en ^ hartEnFlags ) | ( completed ^ hartCompletedFlags ) )
+	{
+		flagToTransmitPDO = 1;
+	}
+	hartEnFlags = en;
+	hartCompletedFlags = completed;
 
-		if ( hartData[numCH].localHartFlagRxEn != userData.hartFlagRxEn[numCH] )
+	/* Запросы мастера CAN ставятся в очередь канала, прием - только после завершения передачи.
+	 * Запрос циклической команды, на которую в кэше есть свежий ответ, на линию не передается */
+	pending = en & ~completed;
+	pending &= ~( ( pending & HART_FLAG_TX_ALL ) << 8 );
+	for (int numCH = 0; numCH < AI_CH_NUM; numCH++)
+	{
+		/* Флаг завершения выставлен после снимка - снимок устарел, запросы ставятся на следующем проходе */
+		if ( seq != completedSeq )
 		{
-			hartData[numCH].localHartFlagRxEn = userData.hartFlagRxEn[numCH];
-			flagToTransmitPDO = 1;
+			break;
 		}
-
-		if ( hartData[numCH].localHartFlagTxCompleted != userData.hartFlagTxCompleted[numCH] )
+		if ( pending & HART_FLAG_TX( numCH ) )
 		{
-			hartData[numCH].localHartFlagTxCompleted = userData.hartFlagTxCompleted[numCH];
-			flagToTransmitPDO = 1;
+			/* Ответ из кэша выставляет флаги завершения сам - снимок остается верным */
+			if ( hartCacheAnswer( numCH ) )
+			{
+				seq++;
+			}
+			else
+			{
+				hartEnqueue( numCH, HART_TRANSACTION_TX, HART_PRIORITY_MASTER );
+			}
 		}
-
-		if ( hartData[numCH].localHartFlagRxCompleted != userData.hartFlagRxCompleted[numCH] )
+		else
+		if ( pending & HART_FLAG_RX( numCH ) )
 		{
-			hartData[numCH].localHartFlagRxCompleted = userData.hartFlagRxCompleted[numCH];
-			flagToTransmitPDO = 1;
+			hartEnqueue( numCH, HART_TRANSACTION_RX, HART_PRIORITY_MASTER );
 		}
 	}
 
-	if ( flagToTransmitPDO )
+	for (int numCH = 0; numCH < AI_CH_NUM; numCH++)
 	{
-		usercanSendPDO4();
-		flagToTransmitPDO = 0;
+		hartCyclicPoll( numCH );
 	}
 
-	if (flagBusy)
+	/* Разбор ответа на опрос модулем и burst-сообщения вне прерывания, линия занята до конца разбора */
+	if ( flagPollDone )
 	{
-		return;
+		uint16_t size = hartRingCopy( hartPollRxBuff, (const HartRxFrame*)&pollRxFrame );
+
+		flagPollDone = 0;
+		if ( activeTransaction == HART_TRANSACTION_LISTEN )
+		{
+			hartBurstStore( activeCH, size );
+		}
+		else
+		{
+			hartCyclicStore( activeCH, size );
+		}
+		hartFinishTransaction();
 	}
 	else
+	/* Прослушивание прерывается, если кадр не принимается, а время вышло или есть работа для линии */
+	if ( flagBusy && ( activeTransaction == HART_TRANSACTION_LISTEN ) && hartListenExpired()
+			&& ( hartRingHead() == rxStart ) )
 	{
-		if ( hartData[activeCH].localHartFlagTxEn && ( !hartData[activeCH].localHartFlagTxCompleted ) )
+		flagRxWindow = 0;
+		/* Кадр мог успеть прийти до закрытия окна - тогда он разбирается на следующем проходе */
+		if ( !flagPollDone )
 		{
-			HAL_TIM_Base_Stop_IT(&htim5);
-			flagBusy = 1;
-			HAL_GPIO_WritePin(MUX_0_GPIO_Port, MUX_0_Pin, 1);
-			HAL_GPIO_WritePin(MUX_1_GPIO_Port, MUX_1_Pin, 1);
-			HAL_GPIO_WritePin(MUX_2_GPIO_Port, MUX_2_Pin, 1);
-			HAL_GPIO_WritePin(UART_RTS_GPIO_Port, UART_RTS_Pin, GPIO_PIN_RESET);
-			//HAL_UART_Transmit_IT(&huart1, (uint8_t*)hartData[activeCH].pointerTxBuff, *hartData[activeCH].pointerTxSize);
-			HAL_UART_Transmit_IT(&huart1, hart_request3, 16);
-			return;
+			hartFinishTransaction();
 		}
-		if ( hartData[activeCH].localHartFlagRxEn && ( !hartData[activeCH].localHartFlagRxCompleted) )
+	}
+
+	/* Изменения флагов за HART_PDO_INTERVAL объединяются в один PDO4 */
+	if ( flagToTransmitPDO && ( ( HAL_GetTick() - pdoTick ) >= HART_PDO_INTERVAL ) )
+	{
+		flagToTransmitPDO = 0;
+		pdoTick = HAL_GetTick();
+		usercanSendPDO4();
+	}
+
+	/* Каналы без транзакций пропускаются, если транзакций нет совсем - линия прослушивается */
+	if ( !flagBusy )
+	{
+		if ( hartSchedule( &channel, &transaction ) )
 		{
-			HAL_TIM_Base_Stop_IT(&htim5);
-			HAL_UART_DMAStop(&huart1);
-			flagBusy = 1;
-			HAL_GPIO_WritePin(MUX_0_GPIO_Port, MUX_0_Pin, (1 << 0) & hartData[activeCH].muxValue);
-			HAL_GPIO_WritePin(MUX_1_GPIO_Port, MUX_1_Pin, (1 << 1) & hartData[activeCH].muxValue);
-			HAL_GPIO_WritePin(MUX_2_GPIO_Port, MUX_2_Pin, (1 << 2) & hartData[activeCH].muxValue);
-			memset(hartData[activeCH].pointerRxBuff, 0, SIZE_HART_BUFF);
-			timerTickCounter = 0;
-			HAL_UARTEx_ReceiveToIdle_DMA(&huart1, (uint8_t*)hartData[activeCH].pointerRxBuff, SIZE_HART_BUFF);
-			HAL_TIM_Base_Start_IT(&htim5);
+			hartStartTransaction( channel, &transaction );
 		}
 		else
 		{
-			if (activeCH == 5)
-			{
-				activeCH = 0;
-			}
-			else
+			hartStartListen();
+		}
+	}
+	PROF_END( PROF_HART_PROCESS );
+}
+
+/**
+  * @brief  Счетчики транзакций канала.
+  * @param  channel:		номер канала.
+  * @param  transactions:	кол-во завершенных транзакций.
+  * @param  timeouts:		кол-во таймаутов.
+  * @param  errors:			кол-во поврежденных кадров (принятых и переданных мастером).
+  * @retval текущий таймаут ответа канала в тиках таймера.
+  */
+uint8_t hartGetStatistics( uint8_t channel, uint32_t* transactions, uint32_t* timeouts, uint32_t* errors )
+{
+	if ( channel >= AI_CH_NUM )
+	{
+		return 0;
+	}
+	*transactions = hartData[channel].transactionCnt;
+	*timeouts = hartData[channel].timeoutCnt;
+	*errors = hartData[channel].errorCnt;
+	return hartData[channel].tickForTimeout;
+}
+
+/**
+  * @brief  Последний ответ устройства на циклическую команду из кэша модуля.
+  * @param  channel:	номер канала.
+  * @param  command:	команда 1..3.
+  * @param  data:		буфер не меньше HART_CACHE_DATA_SIZE байт под данные ответа (с двумя байтами статуса).
+  * @param  size:		размер данных ответа.
+  * @param  age:		возраст ответа, мс.
+  * @retval Состояние ответа в кэше.
+  */
+HART_CACHE_STATUS hartGetCache( uint8_t channel, uint8_t command, uint8_t* data, uint8_t* size, uint32_t* age )
+{
+	HartCache* cache;
+
+	if ( ( channel >= AI_CH_NUM ) || ( command < 1 ) || ( command > HART_CYCLIC_CMD_NUM ) )
+	{
+		return HART_CACHE_EMPTY;
+	}
+	cache = &hartData[channel].cache;
+	if ( !cache->size[command - 1] )
+	{
+		return HART_CACHE_EMPTY;
+	}
+	memcpy( data, cache->data[command - 1], cache->size[command - 1] );
+	*size = cache->size[command - 1];
+	*age = HAL_GetTick() - cache->tick[command - 1];
+	return ( *age < HART_CACHE_STALE_TIME ) ? HART_CACHE_VALID : HART_CACHE_STALE;
+}
+
+/**
+  * @brief  Добавление транзакции в очередь канала по приоритету.
+  *         Транзакция одного типа стоит в очереди канала не больше одного раза.
+  * @param  channel:	номер канала.
+  * @param  type:		тип транзакции HART_TRANSACTION.
+  * @param  priority:	приоритет HART_PRIORITY (меньше - важнее).
+  * @retval 1 - транзакция добавлена, 0 - уже в очереди или очередь заполнена.
+  */
+uint8_t hartEnqueue( uint8_t channel, uint8_t type, uint8_t priority )
+{
+	HartQueue* queue = &hartData[channel].queue;
+	uint8_t pos = queue->count;
+
+	if ( ( hartData[channel].pendingMask & ( 1 << type ) ) || ( queue->count == HART_QUEUE_SIZE ) )
+	{
+		return 0;
+	}
+	/* Сдвигаем транзакции с меньшим приоритетом. */
+	while ( pos && ( queue->item[pos - 1].priority > priority ) )
+	{
+		queue->item[pos] = queue->item[pos - 1];
+		pos--;
+	}
+	queue->item[pos].type = type;
+	queue->item[pos].priority = priority;
+	queue->count++;
+	hartData[channel].pendingMask |= ( 1 << type );
+	return 1;
+}
+
+/**
+  * @brief  Выбор следующей транзакции: самый высокий приоритет среди голов очередей,
+  *         при равном приоритете - следующий по кругу после roundCH канал. Если на канале только что
+  *         прошла передача, в первую очередь принимается ответ на нее.
+  * @param  channel:		выбранный канал.
+  * @param  transaction:	выбранная транзакция (извлекается из очереди).
+  * @retval 1 - транзакция выбрана, 0 - очереди пусты.
+  */
+uint8_t hartSchedule( uint8_t* channel, HartTransaction* transaction )
+{
+	/* Канал с лучшей транзакцией, AI_CH_NUM - не найден. */
+	uint8_t best = AI_CH_NUM;
+	HartQueue* queue;
+
+	if ( flagWaitResponse )
+	{
+		flagWaitResponse = 0;
+		queue = &hartData[activeCH].queue;
+		for ( uint8_t i = 0; i < queue->count; i++ )
+		{
+			if ( queue->item[i].type == HART_TRANSACTION_RX )
 			{
-				activeCH++;
+				*channel = activeCH;
+				*transaction = queue->item[i];
+				memmove( &queue->item[i], &queue->item[i + 1], ( queue->count - i - 1 ) * sizeof(HartTransaction) );
+				queue->count--;
+				return 1;
 			}
 		}
 	}
+
+	for ( uint8_t i = 1; i <= AI_CH_NUM; i++ )
+	{
+		uint8_t ch = ( roundCH + i ) % AI_CH_NUM;
+		if ( !hartData[ch].queue.count )
+		{
+			continue;
+		}
+		if ( ( best == AI_CH_NUM ) || ( hartData[ch].queue.item[0].priority < hartData[best].queue.item[0].priority ) )
+		{
+			best = ch;
+		}
+	}
+	if ( best == AI_CH_NUM )
+	{
+		return 0;
+	}
+
+	queue = &hartData[best].queue;
+	*channel = best;
+	*transaction = queue->item[0];
+	if ( transaction->priority != HART_PRIORITY_ALARM )
+	{
+		roundCH = best;
+	}
+	memmove( &queue->item[0], &queue->item[1], ( queue->count - 1 ) * sizeof(HartTransaction) );
+	queue->count--;
+	return 1;
 }
 
-void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+/**
+  * @brief  Запуск транзакции на канале.
+  */
+void hartStartTransaction( uint8_t channel, const HartTransaction* transaction )
 {
-	(*hartData[activeCH].pointerRxSize) = Size;
-	userData.hartFlagRxCompleted[activeCH] = 1;
-	hartData[activeCH].localHartFlagRxCompleted = 1;
+	activeCH = channel;
+	activeTransaction = transaction->type;
 
-	flagBusy = 0;
+	if ( transaction->type == HART_TRANSACTION_TX )
+	{
+		/* Кадр мастера (от разделителя, без контрольной суммы) дополняется контрольной суммой на месте */
+		txFrameSize = 0;
+		if ( *hartData[activeCH].pointerTxSize < SIZE_HART_BUFF )
+		{
+			txFrameSize = hartFrameEncode( (uint8_t*)hartData[activeCH].pointerTxBuff, *hartData[activeCH].pointerTxSize );
+		}
+		if ( !txFrameSize )
+		{
+			/* Кадр неверный - не передаем и отдаем мастеру пустой ответ */
+			hartData[activeCH].errorCnt++;
+			*hartData[activeCH].pointerRxSize = 0;
+			hartSetCompleted( activeCH, 1, 1 );
+			hartFinishTransaction();
+			return;
+		}
+		txFrame = (uint8_t*)hartData[activeCH].pointerTxBuff;
+		hartStartTransmit();
+		return;
+	}
+
+	if ( transaction->type == HART_TRANSACTION_POLL )
+	{
+		HartCache* cache = &hartData[activeCH].cache;
+		/* Пока адрес неизвестен, устройство ищется командой 0 по короткому адресу 0 */
+		uint8_t shortAddress = HART_ADDR_PRIMARY_MASTER;
+
+		if ( cache->isAddressValid )
+		{
+			cache->pollCommand = cache->command;
+			txFrameSize = hartFrameBuild( hartPollTxBuff, cache->address, HART_LONG_ADDR_SIZE, cache->pollCommand );
+		}
+		else
+		{
+			cache->pollCommand = 0;
+			txFrameSize = hartFrameBuild( hartPollTxBuff, &shortAddress, HART_SHORT_ADDR_SIZE, 0 );
+		}
+		txFrame = hartPollTxBuff;
+		hartStartTransmit();
+		return;
+	}
+
+	hartStartReceive( 1 );
+}
+
+/**
+  * @brief  Выставление флагов завершения передачи/приема мастеру CAN, изменение уйдет в PDO4.
+  * @param  channel:	номер канала.
+  * @param  isTx:		1 - передача завершена.
+  * @param  isRx:		1 - прием завершен.
+  */
+void hartSetCompleted( uint8_t channel, uint8_t isTx, uint8_t isRx )
+{
+	if ( isTx )
+	{
+		userData.hartFlagTxCompleted[channel] = 1;
+	}
+	if ( isRx )
+	{
+		userData.hartFlagRxCompleted[channel] = 1;
+	}
+	completedSeq++;
 	flagToTransmitPDO = 1;
+}
 
+/**
+  * @brief  Передача txFrame размером txFrameSize: сначала преамбула, кадр передается из HAL_UART_TxCpltCallback.
+  */
+void hartStartTransmit( void )
+{
 	HAL_TIM_Base_Stop_IT(&htim5);
+	flagBusy = 1;
+	HAL_GPIO_WritePin(MUX_0_GPIO_Port, MUX_0_Pin, 1);
+	HAL_GPIO_WritePin(MUX_1_GPIO_Port, MUX_1_Pin, 1);
+	HAL_GPIO_WritePin(MUX_2_GPIO_Port, MUX_2_Pin, 1);
+	HAL_GPIO_WritePin(UART_RTS_GPIO_Port, UART_RTS_Pin, GPIO_PIN_RESET);
+	flagTxPreamble = 1;
+	HAL_UART_Transmit_IT(&huart1, hartPreamble, HART_PREAMBLE_TX);
 }
 
-void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+/**
+  * @brief  Открытие окна приема на activeCH: байты, принятые до этого, в кадр не попадают.
+  *         Таймер работает все время окна: до первого байта отсчитывает таймаут ответа,
+  *         после - паузу HART_FRAME_END_TIMEOUT, которая закрывает кадр без события IDLE.
+  * @param  isTimeout:	1 - прием ответа с таймаутом, 0 - прослушивание без таймаута ответа.
+  */
+void hartStartReceive( uint8_t isTimeout )
+{
+	HAL_TIM_Base_Stop_IT(&htim5);
+	flagBusy = 1;
+	HAL_GPIO_WritePin(MUX_0_GPIO_Port, MUX_0_Pin, (1 << 0) & hartData[activeCH].muxValue);
+	HAL_GPIO_WritePin(MUX_1_GPIO_Port, MUX_1_Pin, (1 << 1) & hartData[activeCH].muxValue);
+	HAL_GPIO_WritePin(MUX_2_GPIO_Port, MUX_2_Pin, (1 << 2) & hartData[activeCH].muxValue);
+	timerTickCounter = 0;
+	flagFirstByte = 0;
+	flagRxTimeout = isTimeout;
+	rxStart = hartRingHead();
+	rxHead = rxStart;
+	flagRxWindow = 1;
+	HAL_TIM_Base_Start_IT(&htim5);
+}
+
+/**
+  * @brief  Учет принятых байт в окне приема: первый байт фиксирует время ответа устройства,
+  *         каждый новый байт заново запускает отсчет паузы конца кадра.
+  * @param  head:	положение записи DMA в кольце приема.
+  */
+void hartRxProgress( uint16_t head )
+{
+	if ( head == rxHead )
+	{
+		return;
+	}
+	rxHead = head;
+	if ( !flagFirstByte )
+	{
+		flagFirstByte = 1;
+		if ( flagRxTimeout )
+		{
+			hartUpdateTimeout( activeCH, timerTickCounter );
+		}
+	}
+	timerTickCounter = 0;
+}
+
+/**
+  * @brief  Закрытие кадра по паузе на линии: кадр от rxStart до head отдается транзакции activeCH.
+  * @param  head:	положение записи DMA в кольце приема.
+  */
+void hartRxFrameEnd( uint16_t head )
 {
-	userData.hartFlagTxCompleted[activeCH] = 1;
-	hartData[activeCH].localHartFlagTxCompleted = 1;
+	uint8_t* buff = (uint8_t*)hartData[activeCH].pointerRxBuff;
+	HartFrame frame;
+	HartRxFrame rx;
+	uint16_t size;
+
+	rx.offset = rxStart;
+	rx.length = ( head + HART_RING_SIZE - rxStart ) % HART_RING_SIZE;
+	rxStart = head;
+	rxHead = head;
+	/* Байты вне окна приема (помехи при переключении мультиплексора, ответы после таймаута) пропускаются */
+	if ( !flagRxWindow || !rx.length )
+	{
+		return;
+	}
+
+	HAL_TIM_Base_Stop_IT(&htim5);
 
+	if ( ( activeTransaction == HART_TRANSACTION_POLL ) || ( activeTransaction == HART_TRANSACTION_LISTEN ) )
+	{
+		flagRxWindow = 0;
+		pollRxFrame = rx;
+		flagPollDone = 1;
+		schedTrigger( SCHED_TASK_HART );
+		return;
+	}
+
+	size = hartRingCopy( buff, &rx );
+	if ( hartFrameDecode( buff, size, &frame ) != HART_FRAME_OK )
+	{
+		/* Кадр поврежден - прием повторится, как после таймаута */
+		hartData[activeCH].errorCnt++;
+		hartFinishTransaction();
+		return;
+	}
+	/* Мастеру CAN отдается кадр без преамбулы и контрольной суммы */
+	memmove(buff, &buff[frame.start], frame.length);
+	(*hartData[activeCH].pointerRxSize) = frame.length;
+	hartData[activeCH].transactionCnt++;
+	hartSetCompleted( activeCH, 0, 1 );
+
+	hartFinishTransaction();
+}
+
+/**
+  * @brief  Положение записи DMA в кольце приема.
+  */
+uint16_t hartRingHead( void )
+{
+	return ( HART_RING_SIZE - __HAL_DMA_GET_COUNTER(huart1.hdmarx) ) % HART_RING_SIZE;
+}
+
+/**
+  * @brief  Копирование кадра из кольца приема в буфер (с учетом перехода через конец кольца).
+  * @param  buff:		буфер размером SIZE_HART_BUFF.
+  * @param  rx:			кадр в кольце.
+  * @retval кол-во скопированных байт (не больше SIZE_HART_BUFF).
+  */
+uint16_t hartRingCopy( uint8_t* buff, const HartRxFrame* rx )
+{
+	uint16_t length = ( rx->length < SIZE_HART_BUFF ) ? rx->length : SIZE_HART_BUFF;
+	uint16_t first = HART_RING_SIZE - rx->offset;
+
+	if ( first > length )
+	{
+		first = length;
+	}
+	memcpy( buff, &hartRing[rx->offset], first );
+	memcpy( &buff[first], hartRing, length - first );
+	return length;
+}
+
+/**
+  * @brief  Прослушивание свободной линии: каналы по кругу, на каждом - HART_LISTEN_DWELL,
+  *         на каналах с burst-устройствами - HART_LISTEN_DWELL_BURST, чтобы застать следующее сообщение.
+  *         После принятого кадра прослушивание того же канала продолжается до конца времени.
+  */
+void hartStartListen( void )
+{
+	if ( hartListenExpired() )
+	{
+		listenCH = ( listenCH + 1 ) % AI_CH_NUM;
+		listenTick = HAL_GetTick();
+	}
+	activeCH = listenCH;
+	activeTransaction = HART_TRANSACTION_LISTEN;
+	hartStartReceive( 0 );
+}
+
+/**
+  * @brief  Проверка, что прослушивание listenCH нужно закончить.
+  * @retval 1 - время прослушивания вышло или в очередях есть транзакции, 0 - продолжать.
+  */
+uint8_t hartListenExpired( void )
+{
+	HartCache* cache = &hartData[listenCH].cache;
+	uint32_t dwell = HART_LISTEN_DWELL;
+
+	for ( uint8_t i = 0; i < AI_CH_NUM; i++ )
+	{
+		/* Циклический опрос ждет канал с burst-устройством, остальные транзакции - нет */
+		if ( hartData[i].queue.count && ( ( hartData[i].queue.item[0].priority < HART_PRIORITY_CYCLIC ) || !cache->isBurstSeen ) )
+		{
+			return 1;
+		}
+	}
+	if ( cache->isBurstSeen && ( ( HAL_GetTick() - cache->burstTick ) < HART_BURST_EXPIRE ) )
+	{
+		dwell = HART_LISTEN_DWELL_BURST;
+	}
+	return ( HAL_GetTick() - listenTick ) >= dwell;
+}
+
+/**
+  * @brief  Завершение транзакции activeCH (прием, передача или таймаут), освобождение линии.
+  */
+void hartFinishTransaction( void )
+{
+	flagRxWindow = 0;
+	hartData[activeCH].pendingMask &= ~( 1 << activeTransaction );
 	flagBusy = 0;
-	flagToTransmitPDO = 1;
+	schedTrigger( SCHED_TASK_HART );
+}
+
+/**
+  * @brief  Подстройка таймаута канала по времени ответа устройства (как RTO в TCP):
+  *         таймаут = среднее + 4 * отклонение, в пределах HART_TIMEOUT_MIN..HART_TIMEOUT_MAX.
+  * @param  channel:	номер канала.
+  * @param  ticks:		время от начала приема до первого байта ответа, в тиках таймера.
+  */
+void hartUpdateTimeout( uint8_t channel, uint8_t ticks )
+{
+	HartData* data = &hartData[channel];
+	int16_t delta;
+	uint16_t timeout;
+
+	if ( !data->isResponded )
+	{
+		/* Первый ответ: среднее = время ответа, отклонение = половина времени ответа. */
+		data->isResponded = 1;
+		data->srtt = ticks << 3;
+		data->rttvar = ticks << 1;
+	}
+	else
+	{
+		delta = ticks - ( data->srtt >> 3 );
+		data->srtt += delta;
+		if ( delta < 0 )
+		{
+			delta = -delta;
+		}
+		data->rttvar += delta - ( data->rttvar >> 2 );
+	}
+
+	timeout = ( data->srtt >> 3 ) + data->rttvar;
+	if ( timeout < HART_TIMEOUT_MIN )
+	{
+		timeout = HART_TIMEOUT_MIN;
+	}
+	if ( timeout > HART_TIMEOUT_MAX )
+	{
+		timeout = HART_TIMEOUT_MAX;
+	}
+	data->tickForTimeout = timeout;
+}
+
+/**
+  * @brief  Удвоение таймаута канала после таймаута ответа (как RTO в TCP), не больше HART_TIMEOUT_MAX.
+  *         Следующий ответ устройства снова подстраивает таймаут по времени ответа.
+  * @param  channel:	номер канала.
+  */
+void hartBackoffTimeout( uint8_t channel )
+{
+	uint16_t timeout = (uint16_t)hartData[channel].tickForTimeout << 1;
+
+	if ( timeout > HART_TIMEOUT_MAX )
+	{
+		timeout = HART_TIMEOUT_MAX;
+	}
+	hartData[channel].tickForTimeout = timeout;
+}
+
+/**
+  * @brief  Следующая после command циклическая команда из HART_CYCLIC_MASK (по кругу).
+  */
+uint8_t hartCyclicNext( uint8_t command )
+{
+	for ( uint8_t i = 0; i < HART_CYCLIC_CMD_NUM; i++ )
+	{
+		command = ( command % HART_CYCLIC_CMD_NUM ) + 1;
+		if ( HART_CYCLIC_MASK & ( 1 << command ) )
+		{
+			break;
+		}
+	}
+	return command;
+}
+
+/**
+  * @brief  Постановка опроса модулем в очередь канала. Циклические команды опрашиваются подряд
+  *         раз в HART_CYCLIC_PERIOD, поиск устройства - раз в HART_DISCOVERY_PERIOD.
+  *         Устройство в аварии опрашивается раз в HART_CYCLIC_PERIOD_ALARM с приоритетом HART_PRIORITY_ALARM.
+  */
+void hartCyclicPoll( uint8_t channel )
+{
+	HartCache* cache = &hartData[channel].cache;
+	uint32_t period = 0;
+	uint8_t priority = cache->isAlarm ? HART_PRIORITY_ALARM : HART_PRIORITY_CYCLIC;
+
+	if ( !HART_CYCLIC_MASK || ( hartData[channel].pendingMask & ( 1 << HART_TRANSACTION_POLL ) ) )
+	{
+		return;
+	}
+	/* Период отсчитывается от первой команды цикла, остальные идут сразу за ней */
+	if ( !cache->isAddressValid )
+	{
+		period = HART_DISCOVERY_PERIOD;
+	}
+	else
+	if ( cache->command == hartCyclicNext( HART_CYCLIC_CMD_NUM ) )
+	{
+		period = cache->isAlarm ? HART_CYCLIC_PERIOD_ALARM : HART_CYCLIC_PERIOD;
+	}
+	if ( ( HAL_GetTick() - cache->pollTick ) < period )
+	{
+		return;
+	}
+	if ( hartEnqueue( channel, HART_TRANSACTION_POLL, priority ) && period )
+	{
+		cache->pollTick = HAL_GetTick();
+	}
+}
+
+/**
+  * @brief  Разбор ответа на опрос модулем и сохранение его в кэш канала.
+  * @param  channel:	номер канала.
+  * @param  size:		кол-во принятых байт в hartPollRxBuff, 0 - таймаут.
+  */
+void hartCyclicStore( uint8_t channel, uint16_t size )
+{
+	HartCache* cache = &hartData[channel].cache;
+	HartFrame frame;
+	const uint8_t* data;
+
+	if ( size && ( hartFrameDecode( hartPollRxBuff, size, &frame ) != HART_FRAME_OK ) )
+	{
+		hartData[channel].errorCnt++;
+		size = 0;
+	}
+	/* Ответ без ошибки связи (старший бит первого байта статуса) на отправленную команду */
+	if ( size )
+	{
+		data = &hartPollRxBuff[frame.start + frame.dataOffset];
+		if ( ( frame.type != HART_FRAME_ACK ) || ( frame.command != cache->pollCommand ) || ( frame.byteCount < 2 )
+				|| ( data[0] & 0x80 ) || ( frame.byteCount > HART_CACHE_DATA_SIZE ) )
+		{
+			size = 0;
+		}
+	}
+	if ( !size )
+	{
+		/* Устройство не отвечает - возможно, его заменили, адрес ищется заново */
+		if ( cache->isAddressValid && ( ++cache->missCnt >= HART_CYCLIC_MAX_MISSES ) )
+		{
+			cache->isAddressValid = 0;
+			cache->isAlarm = 0;
+			cache->missCnt = 0;
+			cache->command = hartCyclicNext( HART_CYCLIC_CMD_NUM );
+		}
+		else
+		if ( cache->isAddressValid )
+		{
+			cache->command = hartCyclicNext( cache->command );
+		}
+		return;
+	}
+
+	cache->missCnt = 0;
+	hartData[channel].transactionCnt++;
+
+	/* Команда 0: длинный адрес - код производителя (типа устройства), тип устройства и ID устройства */
+	if ( cache->pollCommand == 0 )
+	{
+		if ( frame.byteCount >= 14 )
+		{
+			cache->address[0] = HART_ADDR_PRIMARY_MASTER | ( data[3] & HART_ADDR_MANUFACTURER_MASK );
+			cache->address[1] = data[4];
+			memcpy( &cache->address[2], &data[11], 3 );
+			cache->isAddressValid = 1;
+			/* Первый цикл опроса - сразу после поиска */
+			cache->pollTick = HAL_GetTick() - HART_CYCLIC_PERIOD;
+		}
+		return;
+	}
+
+	memcpy( cache->data[cache->pollCommand - 1], data, frame.byteCount );
+	cache->size[cache->pollCommand - 1] = frame.byteCount;
+	cache->isAlarm = ( data[1] & HART_ALARM_STATUS_MASK ) ? 1 : 0;
+	cache->tick[cache->pollCommand - 1] = HAL_GetTick();
+	cache->command = hartCyclicNext( cache->command );
+}
+
+/**
+  * @brief  Разбор кадра, принятого при прослушивании. Burst-сообщение с циклической командой
+  *         сохраняется в кэш канала, как ответ на опрос, а адрес устройства берется из сообщения.
+  * @param  channel:	номер канала.
+  * @param  size:		кол-во принятых байт в hartPollRxBuff.
+  */
+void hartBurstStore( uint8_t channel, uint16_t size )
+{
+	HartCache* cache = &hartData[channel].cache;
+	HartFrame frame;
+	const uint8_t* data;
+	const uint8_t* address;
+
+	if ( hartFrameDecode( hartPollRxBuff, size, &frame ) != HART_FRAME_OK )
+	{
+		hartData[channel].errorCnt++;
+		return;
+	}
+	/* Ответы другому мастеру на линии не разбираются */
+	if ( ( frame.type != HART_FRAME_BACK ) || ( frame.addressSize != HART_LONG_ADDR_SIZE ) )
+	{
+		return;
+	}
+	cache->isBurstSeen = 1;
+	cache->burstTick = HAL_GetTick();
+	hartData[channel].transactionCnt++;
+
+	address = &hartPollRxBuff[frame.start + 1];
+	if ( !cache->isAddressValid )
+	{
+		cache->address[0] = HART_ADDR_PRIMARY_MASTER | ( address[0] & HART_ADDR_MANUFACTURER_MASK );
+		memcpy( &cache->address[1], &address[1], HART_LONG_ADDR_SIZE - 1 );
+		cache->isAddressValid = 1;
+		cache->missCnt = 0;
+	}
+
+	data = &hartPollRxBuff[frame.start + frame.dataOffset];
+	if ( ( frame.command < 1 ) || ( frame.command > HART_CYCLIC_CMD_NUM ) || ( frame.byteCount < 2 )
+			|| ( data[0] & 0x80 ) || ( frame.byteCount > HART_CACHE_DATA_SIZE ) )
+	{
+		return;
+	}
+	memcpy( cache->data[frame.command - 1], data, frame.byteCount );
+	cache->size[frame.command - 1] = frame.byteCount;
+	cache->isAlarm = ( data[1] & HART_ALARM_STATUS_MASK ) ? 1 : 0;
+	cache->tick[frame.command - 1] = HAL_GetTick();
+}
+
+/**
+  * @brief  Ответ мастеру CAN из кэша: если в txBuff запрос циклической команды без данных
+  *         по длинному адресу устройства канала и в кэше есть свежий ответ, в rxBuff сразу
+  *         кладется кадр ответа, как если бы его прислало устройство.
+  * @retval 1 - мастеру отдан ответ из кэша, 0 - запрос нужно передать устройству.
+  */
+uint8_t hartCacheAnswer( uint8_t channel )
+{
+	HartData* data = &hartData[channel];
+	uint8_t* tx = (uint8_t*)data->pointerTxBuff;
+	uint8_t* rx = (uint8_t*)data->pointerRxBuff;
+	uint8_t index;
+	HartFrame frame;
+
+	if ( ( data->pendingMask & ( 1 << HART_TRANSACTION_TX ) ) || !data->cache.isAddressValid
+			|| ( *data->pointerTxSize >= SIZE_HART_BUFF ) )
+	{
+		return 0;
+	}
+	if ( ( hartFrameHeader( tx, *data->pointerTxSize, &frame ) != 1 ) || ( frame.length != *data->pointerTxSize )
+			|| ( frame.type != HART_FRAME_STX ) || ( frame.addressSize != HART_LONG_ADDR_SIZE ) || frame.byteCount
+			|| ( tx[0] & HART_DELIMITER_EXPANSION_MASK )
+			|| ( frame.command < 1 ) || ( frame.command > HART_CYCLIC_CMD_NUM ) )
+	{
+		return 0;
+	}
+	/* Адрес сравнивается без бита мастера и бита burst-режима */
+	if ( ( ( tx[1] ^ data->cache.address[0] ) & HART_ADDR_MANUFACTURER_MASK )
+			|| memcmp( &tx[2], &data->cache.address[1], HART_LONG_ADDR_SIZE - 1 ) )
+	{
+		return 0;
+	}
+	index = frame.command - 1;
+	if ( !data->cache.size[index] || ( ( HAL_GetTick() - data->cache.tick[index] ) >= HART_CACHE_STALE_TIME ) )
+	{
+		return 0;
+	}
+
+	/* Кадр ответа: разделитель ACK, адрес из запроса, команда, счетчик байт и данные */
+	rx[0] = HART_FRAME_ACK | HART_DELIMITER_LONG_ADDR;
+	memcpy( &rx[1], &tx[1], HART_LONG_ADDR_SIZE + 1 );
+	rx[frame.dataOffset - 1] = data->cache.size[index];
+	memcpy( &rx[frame.dataOffset], data->cache.data[index], data->cache.size[index] );
+	*data->pointerRxSize = frame.dataOffset + data->cache.size[index];
+
+	hartSetCompleted( channel, 1, 1 );
+	return 1;
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	uint16_t head = Size % HART_RING_SIZE;
+
+	if ( huart != &huart1 )
+	{
+		return;
+	}
+	/* События половины и конца кольца кадр не закрывают: кадр может продолжаться. Они учитываются
+	 * как прием байт, а если пауза после кадра не придет событием IDLE (кадр закончился ровно
+	 * на конце кольца), кадр закроет таймаут конца кадра в hartTimeout */
+	if ( HAL_UARTEx_GetRxEventType(huart) != HAL_UART_RXEVENT_IDLE )
+	{
+		if ( flagRxWindow )
+		{
+			hartRxProgress( head );
+		}
+		return;
+	}
+	hartRxFrameEnd( head );
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	if ( huart != &huart1 )
+	{
+		return;
+	}
+	if ( flagTxPreamble )
+	{
+		flagTxPreamble = 0;
+		HAL_UART_Transmit_IT(&huart1, txFrame, txFrameSize);
+		return;
+	}
 
 	HAL_GPIO_WritePin(UART_RTS_GPIO_Port, UART_RTS_Pin, GPIO_PIN_SET);
+
+	/* При опросе модулем ответ принимается сразу, без возврата в планировщик */
+	if ( activeTransaction == HART_TRANSACTION_POLL )
+	{
+		hartStartReceive( 1 );
+		return;
+	}
+
+	hartSetCompleted( activeCH, 1, 0 );
+
+	hartFinishTransaction();
+	flagWaitResponse = 1;
 }
 
 void hartTimeout()
 {
-	if (__HAL_DMA_GET_COUNTER(huart1.hdmarx) < SIZE_HART_BUFF)
+	uint16_t head = hartRingHead();
+
+	/* Окно закрыто вне таймера (кадр, ошибка, конец прослушивания) */
+	if ( !flagRxWindow )
 	{
-		timerTickCounter = 0;
 		HAL_TIM_Base_Stop_IT(&htim5);
 		return;
 	}
-
-	if (timerTickCounter == hartData[activeCH].tickForTimeout)
+	if ( head != rxHead )
 	{
-		flagBusy = 0;
-		HAL_TIM_Base_Stop_IT(&htim5);
+		hartRxProgress( head );
+		return;
+	}
 
-		if (activeCH == 5)
+	/* После первого байта кадр закрывается паузой на линии, даже если событие IDLE потеряно */
+	if ( flagFirstByte )
+	{
+		if ( timerTickCounter >= HART_FRAME_END_TIMEOUT )
 		{
-			activeCH = 0;
+			hartRxFrameEnd( head );
 		}
 		else
 		{
-			activeCH++;
+			timerTickCounter += 1;
+		}
+		return;
+	}
+
+	if ( flagRxTimeout && ( timerTickCounter >= hartData[activeCH].tickForTimeout ) )
+	{
+		hartData[activeCH].timeoutCnt++;
+		hartBackoffTimeout( activeCH );
+		HAL_TIM_Base_Stop_IT(&htim5);
+		if ( activeTransaction == HART_TRANSACTION_POLL )
+		{
+			flagRxWindow = 0;
+			pollRxFrame.length = 0;
+			flagPollDone = 1;
+			schedTrigger( SCHED_TASK_HART );
+			return;
 		}
+		hartFinishTransaction();
 	}
 	else
 	{
@@ -211,3 +1169,33 @@ void hartTimeout()
 	}
 }
 
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if ( huart != &huart1 )
+	{
+		return;
+	}
+	/* Если при ошибке UART прием по кольцу остановлен - запускаем заново */
+	if ( huart->RxState == HAL_UART_STATE_READY )
+	{
+		rxStart = 0;
+		rxHead = 0;
+		HAL_UARTEx_ReceiveToIdle_DMA(huart, hartRing, HART_RING_SIZE);
+	}
+	/* Кадр в открытом окне потерян - транзакция завершается сразу, не дожидаясь таймаута */
+	if ( !flagRxWindow )
+	{
+		return;
+	}
+	HAL_TIM_Base_Stop_IT(&htim5);
+	hartData[activeCH].errorCnt++;
+	if ( activeTransaction == HART_TRANSACTION_POLL )
+	{
+		flagRxWindow = 0;
+		pollRxFrame.length = 0;
+		flagPollDone = 1;
+		schedTrigger( SCHED_TASK_HART );
+		return;
+	}
+	hartFinishTransaction();
+}
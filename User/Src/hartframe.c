@@ -0,0 +1,145 @@
+#include "hartframe.h"
+
+#include "setting.h"
+#include "string.h"
+
+/**
+  * @brief  Разбор принятого кадра на месте: поиск преамбулы, проверка разделителя,
+  *         счетчика байт и контрольной суммы. Мусор до преамбулы пропускается.
+  * @param  buff:		принятые байты.
+  * @param  size:		кол-во принятых байт.
+  * @param  frame:		разобранный кадр (смещения полей в buff).
+  * @retval Результат разбора.
+  */
+HART_FRAME_STATUS hartFrameDecode( const uint8_t* buff, uint16_t size, HartFrame* frame )
+{
+	/* Кол-во подряд идущих байт преамбулы. */
+	uint8_t preambleCnt = 0;
+	uint16_t pos = 0;
+
+	/* Ищем HART_PREAMBLE_MIN байт преамбулы подряд и пропускаем ее до разделителя. */
+	for ( ; pos < size; pos++ )
+	{
+		if ( buff[pos] == HART_PREAMBLE_BYTE )
+		{
+			preambleCnt++;
+		}
+		else
+		if ( preambleCnt >= HART_PREAMBLE_MIN )
+		{
+			break;
+		}
+		else
+		{
+			preambleCnt = 0;
+		}
+	}
+	if ( pos == size )
+	{
+		return HART_FRAME_NO_PREAMBLE;
+	}
+
+	frame->start = pos;
+	switch ( hartFrameHeader( &buff[pos], size - pos, frame ) )
+	{
+		case 0:
+			return HART_FRAME_BAD_DELIMITER;
+		case 1:
+			break;
+		default:
+			return HART_FRAME_SHORT;
+	}
+	/* Контрольная сумма идет сразу за данными. */
+	if ( ( pos + frame->length ) >= size )
+	{
+		return HART_FRAME_SHORT;
+	}
+	if ( hartFrameChecksum( &buff[pos], frame->length ) != buff[pos + frame->length] )
+	{
+		return HART_FRAME_BAD_CHECKSUM;
+	}
+	return HART_FRAME_OK;
+}
+
+/**
+  * @brief  Подготовка кадра к передаче на месте: проверка заголовка и дописывание контрольной суммы.
+  *         Преамбула передается отдельно, поэтому кадр в буфере начинается с разделителя.
+  * @param  buff:		кадр от разделителя до последнего байта данных, в буфере должен быть 1 байт под сумму.
+  * @param  size:		размер кадра без контрольной суммы.
+  * @retval размер кадра с контрольной суммой, 0 - кадр неверный.
+  */
+uint16_t hartFrameEncode( uint8_t* buff, uint16_t size )
+{
+	HartFrame frame;
+
+	if ( ( hartFrameHeader( buff, size, &frame ) != 1 ) || ( frame.length != size ) )
+	{
+		return 0;
+	}
+	buff[size] = hartFrameChecksum( buff, size );
+	return size + 1;
+}
+
+/**
+  * @brief  Сборка кадра запроса мастера без данных (от разделителя, с контрольной суммой).
+  * @param  buff:			буфер не меньше HART_REQUEST_SIZE байт.
+  * @param  address:		адрес устройства с битом мастера.
+  * @param  addressSize:	HART_SHORT_ADDR_SIZE или HART_LONG_ADDR_SIZE.
+  * @param  command:		команда.
+  * @retval размер кадра с контрольной суммой.
+  */
+uint16_t hartFrameBuild( uint8_t* buff, const uint8_t* address, uint8_t addressSize, uint8_t command )
+{
+	uint16_t size = 0;
+
+	buff[size++] = HART_FRAME_STX | ( ( addressSize == HART_LONG_ADDR_SIZE ) ? HART_DELIMITER_LONG_ADDR : 0 );
+	memcpy( &buff[size], address, addressSize );
+	size += addressSize;
+	buff[size++] = command;
+	buff[size++] = 0;
+	buff[size] = hartFrameChecksum( buff, size );
+	return size + 1;
+}
+
+/**
+  * @brief  Контрольная сумма HART (продольная четность - XOR всех байт от разделителя).
+  */
+uint8_t hartFrameChecksum( const uint8_t* buff, uint16_t size )
+{
+	uint8_t checksum = 0;
+
+	for ( uint16_t i = 0; i < size; i++ )
+	{
+		checksum ^= buff[i];
+	}
+	return checksum;
+}
+
+/**
+  * @brief  Разбор заголовка кадра от разделителя.
+  * @retval 0 - неверный разделитель, 1 - заголовок разобран, 2 - кадр короче заголовка.
+  */
+uint8_t hartFrameHeader( const uint8_t* buff, uint16_t size, HartFrame* frame )
+{
+	uint8_t delimiter = buff[0];
+	/* Смещение команды: разделитель + адрес + байты расширения. */
+	uint8_t commandOffset;
+
+	frame->type = delimiter & HART_DELIMITER_TYPE_MASK;
+	if ( ( frame->type != HART_FRAME_BACK ) && ( frame->type != HART_FRAME_STX ) && ( frame->type != HART_FRAME_ACK ) )
+	{
+		return 0;
+	}
+	frame->addressSize = ( delimiter & HART_DELIMITER_LONG_ADDR ) ? HART_LONG_ADDR_SIZE : HART_SHORT_ADDR_SIZE;
+	commandOffset = 1 + frame->addressSize + ( ( delimiter & HART_DELIMITER_EXPANSION_MASK ) >> 5 );
+	/* Команда и счетчик байт. */
+	if ( size < ( commandOffset + 2 ) )
+	{
+		return 2;
+	}
+	frame->command = buff[commandOffset];
+	frame->byteCount = buff[commandOffset + 1];
+	frame->dataOffset = commandOffset + 2;
+	frame->length = frame->dataOffset + frame->byteCount;
+	return 1;
+}
@@ -0,0 +1,343 @@
+#include "journal.h"
+
+#include "flash.h"
+#include "crc.h"
+#include "string.h"
+
+/* ________________________ ENUM'S ________________________ */
+/* Шаги загрузки журнала. */
+enum JOURNAL_LOAD_STEP
+{
+	/* Шаг - чтение заголовков первых слотов секторов, поиск сектора с самой новой записью. */
+	JOURNAL_LOAD_SECTOR			=	0,
+	/* Шаг - чтение заголовков слотов найденного сектора, поиск последней записи. */
+	JOURNAL_LOAD_SLOT			=	1,
+	/* Шаг - чтение и проверка записи, при ошибке переход к предыдущей. */
+	JOURNAL_LOAD_RECORD			=	2,
+};
+
+/* Шаги добавления записи. */
+enum JOURNAL_SAVE_STEP
+{
+	/* Шаг - очистка сектора (только при переходе в новый сектор). */
+	JOURNAL_SAVE_ERASE			=	0,
+	/* Шаг - запись слота. */
+	JOURNAL_SAVE_WRITE			=	1,
+	/* Шаг - ожидание окончания записи и проверка слота чтением. */
+	JOURNAL_SAVE_VERIFY			=	2,
+};
+
+/* ________________________ STRUCT ________________________ */
+typedef struct JournalData
+{
+	/* Буфер слота: заголовок и данные записи. */
+	uint32_t buff[JOURNAL_SLOT_SIZE / sizeof(uint32_t)];
+	/* Номер следующей записи. */
+	uint32_t sequence;
+	/* Слот под следующую запись. */
+	uint16_t nextSlot;
+	/* Слот, с которым идет работа при загрузке. */
+	uint16_t slot;
+	/* Слот самой новой записи. */
+	uint16_t newestSlot;
+	/* Кол-во проверенных записей при загрузке. */
+	uint16_t checkCnt;
+	/* Флаг, что найдена хотя бы одна запись. */
+	uint8_t isFound;
+	/* Флаг, что команда чтения отправлена. */
+	uint8_t isReadSent;
+	/* Флаг, что загрузка завершена и sequence/nextSlot верны, без него запись запрещена. */
+	uint8_t isLoaded;
+	/* Шаг загрузки. */
+	uint8_t loadStep;
+	/* Шаг добавления записи. */
+	uint8_t saveStep;
+} JournalData;
+
+/* ________________________ FUNCTION'S PROTOTYPE ________________________ */
+uint32_t journalSlotAddress( uint16_t slot );
+uint8_t journalRead( uint32_t address, uint16_t size );
+uint8_t journalIsErased( const JournalHeader* header );
+uint8_t journalCheckHeader( const JournalHeader* header );
+uint8_t journalCheckRecord( void );
+void journalLoadFinish( void );
+
+/* ________________________ INIT STRUCT ________________________ */
+JournalData journalData = {};
+
+/**
+  * @brief  Поиск и чтение самой новой верной записи журнала. Вызывается, пока возвращает JOURNAL_AT_WORK.
+  *         Читаются заголовки первых слотов секторов, затем слоты сектора с самой новой записью
+  *         и сама запись. Если CRC записи не совпала (питание пропало при записи), берется предыдущая.
+  *         Заодно определяется слот и номер следующей записи для journalAppend.
+  *         Прерванную загрузку нужно сбросить journalReset, до новой полной загрузки запись запрещена.
+  * @param  data:		буфер под данные записи.
+  * @param  size:		размер буфера, недостающие в записи байты заполняются нулями.
+  * @retval Статус загрузки.
+  */
+JOURNAL_STATUS journalLoad( uint8_t* data, uint16_t size )
+{
+	/* Заголовок прочитанного слота. */
+	JournalHeader* header = (JournalHeader*)journalData.buff;
+
+	/* Поиск сектора с самой новой записью. */
+	if ( journalData.loadStep == JOURNAL_LOAD_SECTOR )
+	{
+		/* Новый поиск - положение записи, найденное раньше, недействительно. */
+		if ( !journalData.slot && !journalData.isReadSent )
+		{
+			journalData.isFound = 0;
+			journalData.isLoaded = 0;
+		}
+		if ( !journalRead( journalSlotAddress( journalData.slot ), sizeof(JournalHeader) ) )
+		{
+			return JOURNAL_AT_WORK;
+		}
+		if ( journalCheckHeader( header ) && ( !journalData.isFound || ( header->sequence >= journalData.sequence ) ) )
+		{
+			journalData.isFound = 1;
+			journalData.sequence = header->sequence;
+			journalData.newestSlot = journalData.slot;
+		}
+		journalData.slot += JOURNAL_SECTOR_SLOTS;
+		if ( journalData.slot < JOURNAL_SLOT_NUM )
+		{
+			return JOURNAL_AT_WORK;
+		}
+		/* Журнал пуст - записи начнутся с первого слота. */
+		if ( !journalData.isFound )
+		{
+			journalData.nextSlot = 0;
+			journalData.sequence = 0;
+			journalLoadFinish();
+			return JOURNAL_EMPTY;
+		}
+		journalData.slot = journalData.newestSlot + 1;
+		journalData.nextSlot = journalData.slot % JOURNAL_SLOT_NUM;
+		journalData.loadStep = JOURNAL_LOAD_SLOT;
+	}
+
+	/* Поиск последней записи в секторе: записи добавляются подряд, за последней идут чистые слоты. */
+	if ( journalData.loadStep == JOURNAL_LOAD_SLOT )
+	{
+		if ( journalData.slot % JOURNAL_SECTOR_SLOTS )
+		{
+			if ( !journalRead( journalSlotAddress( journalData.slot ), sizeof(JournalHeader) ) )
+			{
+				return JOURNAL_AT_WORK;
+			}
+			if ( !journalIsErased( header ) )
+			{
+				/* Даже поврежденный слот занят, писать в него без очистки сектора нельзя. */
+				journalData.nextSlot = ( journalData.slot + 1 ) % JOURNAL_SLOT_NUM;
+				if ( journalCheckHeader( header ) && ( header->sequence >= journalData.sequence ) )
+				{
+					journalData.sequence = header->sequence;
+					journalData.newestSlot = journalData.slot;
+				}
+				journalData.slot++;
+				return JOURNAL_AT_WORK;
+			}
+		}
+		/* Номер следующей записи. */
+		journalData.sequence++;
+		journalData.slot = journalData.newestSlot;
+		journalData.checkCnt = 0;
+		journalData.loadStep = JOURNAL_LOAD_RECORD;
+	}
+
+	/* Чтение и проверка записи. */
+	if ( !journalRead( journalSlotAddress( journalData.slot ), JOURNAL_SLOT_SIZE ) )
+	{
+		return JOURNAL_AT_WORK;
+	}
+	if ( journalCheckRecord() )
+	{
+		memset( data, 0, size );
+		memcpy( data, &journalData.buff[sizeof(JournalHeader) / sizeof(uint32_t)], ( header->length < size ) ? header->length : size );
+		journalLoadFinish();
+		return JOURNAL_DONE;
+	}
+	/* Все слоты проверены - верных записей нет. */
+	if ( ++journalData.checkCnt >= JOURNAL_SLOT_NUM )
+	{
+		journalLoadFinish();
+		return JOURNAL_EMPTY;
+	}
+	/* Переходим к предыдущей записи. */
+	journalData.slot = ( journalData.slot + JOURNAL_SLOT_NUM - 1 ) % JOURNAL_SLOT_NUM;
+	return JOURNAL_AT_WORK;
+}
+
+/**
+  * @brief  Добавление записи в журнал. Вызывается, пока возвращает JOURNAL_AT_WORK.
+  *         Сектор стирается только при переходе записи в него, поэтому предыдущая запись
+  *         остается целой при пропадании питания на любом шаге.
+  *         Записанный слот читается обратно и сравнивается с данными: если не совпал, возвращается
+  *         JOURNAL_ERROR, а следующая запись идет в следующий слот.
+  * @param  data:		данные записи.
+  * @param  size:		размер данных (кратен 4, не больше JOURNAL_SLOT_SIZE - sizeof(JournalHeader)).
+  * @retval Статус записи.
+  */
+JOURNAL_STATUS journalAppend( const uint8_t* data, uint16_t size )
+{
+	/* Заголовок записываемого слота. */
+	JournalHeader* header = (JournalHeader*)journalData.buff;
+	/* Статус флешки. */
+	uint8_t statusFlash = FLASH_BUSY;
+	/* Флаг, что записанный слот совпал с данными. */
+	uint8_t isValid;
+
+	if ( ( size > ( JOURNAL_SLOT_SIZE - sizeof(JournalHeader) ) ) || ( size % sizeof(uint32_t) ) )
+	{
+		return JOURNAL_ERROR;
+	}
+	/* Без полной загрузки запись могла бы затереть самую новую запись или уйти с меньшим номером. */
+	if ( !journalData.isLoaded )
+	{
+		return JOURNAL_NOT_LOADED;
+	}
+
+	/* Проверка записанного слота: после записи флешка свободна на чтение. */
+	if ( journalData.saveStep == JOURNAL_SAVE_VERIFY )
+	{
+		if ( !journalRead( journalSlotAddress( journalData.nextSlot ), sizeof(JournalHeader) + size ) )
+		{
+			return JOURNAL_AT_WORK;
+		}
+		isValid = journalCheckRecord() && ( header->sequence == journalData.sequence ) && ( header->length == size )
+				&& !memcmp( &journalData.buff[sizeof(JournalHeader) / sizeof(uint32_t)], data, size );
+		/* Слот занят и при ошибке - сдвигаем положение журнала, записанный слот в загрузку не попадет. */
+		journalData.sequence++;
+		journalData.nextSlot = ( journalData.nextSlot + 1 ) % JOURNAL_SLOT_NUM;
+		journalData.saveStep = JOURNAL_SAVE_ERASE;
+		return isValid ? JOURNAL_DONE : JOURNAL_ERROR;
+	}
+
+	/* Получаем статус флешки. */
+	statusFlash = flashGetStatus();
+	/* Если флешка занята. */
+	if ( statusFlash == FLASH_BUSY )
+	{
+		return JOURNAL_AT_WORK;
+	}
+	/* Если флешка свободна на чтение. */
+	if ( statusFlash == FLASH_FREE_R )
+	{
+		flashSetWriteMode();
+		return JOURNAL_AT_WORK;
+	}
+
+	/* Очистка сектора при переходе в него. */
+	if ( journalData.saveStep == JOURNAL_SAVE_ERASE )
+	{
+		journalData.saveStep = JOURNAL_SAVE_WRITE;
+		if ( ( journalData.nextSlot % JOURNAL_SECTOR_SLOTS ) == 0 )
+		{
+			flashEraseSector( journalSlotAddress( journalData.nextSlot ) );
+			return JOURNAL_AT_WORK;
+		}
+	}
+	/* Запись слота одной страницей. */
+	if ( journalData.saveStep == JOURNAL_SAVE_WRITE )
+	{
+		header->magic = JOURNAL_MAGIC;
+		header->sequence = journalData.sequence;
+		header->length = size;
+		header->reserved = 0;
+		memcpy( &journalData.buff[sizeof(JournalHeader) / sizeof(uint32_t)], data, size );
+		header->dataCrc = HAL_CRC_Calculate( &hcrc, &journalData.buff[sizeof(JournalHeader) / sizeof(uint32_t)], size / sizeof(uint32_t) );
+		header->crc = HAL_CRC_Calculate( &hcrc, &header->sequence, 3 );
+		flashWriteData( journalSlotAddress( journalData.nextSlot ), (uint8_t*)journalData.buff, sizeof(JournalHeader) + size );
+		journalData.saveStep = JOURNAL_SAVE_VERIFY;
+	}
+	return JOURNAL_AT_WORK;
+}
+
+/**
+  * @brief  Сброс загрузки и записи (после таймаута флешки): следующий journalLoad начинает поиск
+  *         заново, journalAppend возвращает JOURNAL_NOT_LOADED до завершения загрузки.
+  */
+void journalReset( void )
+{
+	journalData.loadStep = JOURNAL_LOAD_SECTOR;
+	journalData.saveStep = JOURNAL_SAVE_ERASE;
+	journalData.slot = 0;
+	journalData.isReadSent = 0;
+	journalData.isFound = 0;
+	journalData.isLoaded = 0;
+}
+
+/**
+  * @brief  Завершение загрузки: положение следующей записи известно, журнал готов к поиску заново.
+  */
+void journalLoadFinish( void )
+{
+	journalData.loadStep = JOURNAL_LOAD_SECTOR;
+	journalData.slot = 0;
+	journalData.isLoaded = 1;
+}
+
+/**
+  * @brief  Адрес слота на флешке.
+  */
+uint32_t journalSlotAddress( uint16_t slot )
+{
+	return JOURNAL_START_ADR + (uint32_t)slot * JOURNAL_SLOT_SIZE;
+}
+
+/**
+  * @brief  Чтение с флешки в буфер слота.
+  * @retval 1 - данные в буфере, 0 - чтение еще идет.
+  */
+uint8_t journalRead( uint32_t address, uint16_t size )
+{
+	/* Если флешка занята. */
+	if ( flashGetStatus() == FLASH_BUSY )
+	{
+		return 0;
+	}
+	/* Отправляем команду чтения. */
+	if ( !journalData.isReadSent )
+	{
+		flashReadData( address, size );
+		journalData.isReadSent = 1;
+		return 0;
+	}
+	/* Получаем данные. */
+	flashGetReadedData( (uint8_t*)journalData.buff );
+	journalData.isReadSent = 0;
+	return 1;
+}
+
+/**
+  * @brief  Проверка, что слот не записывался после очистки сектора.
+  */
+uint8_t journalIsErased( const JournalHeader* header )
+{
+	return ( header->magic == 0xFFFFFFFF ) && ( header->sequence == 0xFFFFFFFF );
+}
+
+/**
+  * @brief  Проверка заголовка записи.
+  * @retval 1 - заголовок верный, 0 - слот чистый или заголовок поврежден.
+  */
+uint8_t journalCheckHeader( const JournalHeader* header )
+{
+	return ( header->magic == JOURNAL_MAGIC )
+			&& ( header->length <= ( JOURNAL_SLOT_SIZE - sizeof(JournalHeader) ) )
+			&& ( ( header->length % sizeof(uint32_t) ) == 0 )
+			&& ( header->crc == HAL_CRC_Calculate( &hcrc, (uint32_t*)&header->sequence, 3 ) );
+}
+
+/**
+  * @brief  Проверка записи в буфере слота.
+  * @retval 1 - запись верная, 0 - запись повреждена.
+  */
+uint8_t journalCheckRecord( void )
+{
+	JournalHeader* header = (JournalHeader*)journalData.buff;
+
+	return journalCheckHeader( header )
+			&& ( header->dataCrc == HAL_CRC_Calculate( &hcrc, &journalData.buff[sizeof(JournalHeader) / sizeof(uint32_t)], header->length / sizeof(uint32_t) ) );
+}
@@ -5,28 +5,61 @@
 #include "main.h"
 #include "setting.h"
 #include "i2c.h"
+#include "prof.h"
 
 
 #define LED_ENABLE 							1
 #define LED_DISABLE 						0
 
-uint8_t delayCnt = 0;
+/* Макс. кол-во шагов шаблона индикации. */
+#define LED_PATTERN_STEPS					12
+
+/* Состояние передачи на расширитель. */
+enum LED_TX_STATE
+{
+	LED_TX_IDLE		= 0,
+	LED_TX_BUSY		= 1,
+	LED_TX_DONE		= 2,
+	LED_TX_ERROR	= 3,
+};
+
+/* Время последнего запуска передачи, мс. */
+uint32_t ledTxTick = 0;
+/* Буфер передачи DMA, не меняется до окончания передачи. */
 uint8_t ledI2C[] = {0b00000010, 0b00111111, 0b00111111};
+/* Требуемое состояние выходов. */
 uint8_t ledLocal[] = {0b00000010, 0b00111111, 0b00111111};
+/* Состояние выходов, подтвержденное расширителем. */
+uint8_t ledAck[] = {0b00000010, 0b00111111, 0b00111111};
+/* Флаг, что ledAck совпадает с выходами расширителя. */
+uint8_t isLedAckValid = 0;
+volatile uint8_t ledTxState = LED_TX_IDLE;
+/* Кол-во запущенных передач на расширитель. */
+uint32_t ledTxCnt = 0;
+/* Ближайшее время смены состояния среди всех диодов, мс. */
+uint32_t ledDeadline = 0;
+/* Состояние диодов на прошлом проходе, бит на LED_TYPE. */
+uint16_t ledOnMask = 0;
+/* Диоды со сменой режима или цвета, бит на LED_TYPE. */
+uint16_t ledDirtyMask = 0;
 
-void ledSet(LED_TYPE type, uint8_t state);
+/* Шаблон индикации: последовательность длительностей включенного и выключенного состояния.
+ * Фаза шаблона общая для режима, поэтому диоды с одним режимом мигают синхронно. */
+typedef struct LedPattern
+{
+	/* Состояние диода в постоянном режиме (шаблон без шагов). */
+	uint8_t state;
+	/* Длительности шагов, мс: четные шаги - включен, нечетные - выключен, 0 - конец, повтор с начала. */
+	uint16_t step[LED_PATTERN_STEPS];
+} LedPattern;
 
 typedef struct LedData
 {
 	GPIO_TypeDef* port;
 	uint16_t pin;
 	LED_MODE mode;
-	uint32_t startCounter;
-	uint32_t secondCounter;
 	uint8_t isMultiColor;
 	uint8_t color;
-	uint16_t flag;
-	void ( *ledFunction )( LED_TYPE type );
 } LedData;
 
 enum
@@ -41,289 +74,233 @@ enum
 
 LedData ledData[] =
 {
-	{ LED_STATUS_GPIO_Port,	LED_STATUS_Pin,  	MODE_OFF, 	0,	0,	0 	},
-	{ LED_RUN_GPIO_Port,	LED_RUN_Pin,   		MODE_OFF, 	0,	0,	0 	},
-	{ LED_ALARM_GPIO_Port,	LED_ALARM_Pin, 		MODE_OFF, 	0,	0,	0 	},
-
-	{ NULL,					CH1, 				MODE_OFF, 	0,	0,	1 	},
-	{ NULL,					CH2, 				MODE_OFF, 	0,	0,	1 	},
-	{ NULL,					CH3, 				MODE_OFF, 	0,	0,	1 	},
-	{ NULL,					CH4, 				MODE_OFF, 	0,	0,	1 	},
-	{ NULL,					CH5, 				MODE_OFF, 	0,	0,	1 	},
-	{ NULL,					CH6, 				MODE_OFF, 	0,	0,	1 	},
+	{ LED_STATUS_GPIO_Port,	LED_STATUS_Pin,  	MODE_OFF, 	0 	},
+	{ LED_RUN_GPIO_Port,	LED_RUN_Pin,   		MODE_OFF, 	0 	},
+	{ LED_ALARM_GPIO_Port,	LED_ALARM_Pin, 		MODE_OFF, 	0 	},
+
+	{ NULL,					CH1, 				MODE_OFF, 	1 	},
+	{ NULL,					CH2, 				MODE_OFF, 	1 	},
+	{ NULL,					CH3, 				MODE_OFF, 	1 	},
+	{ NULL,					CH4, 				MODE_OFF, 	1 	},
+	{ NULL,					CH5, 				MODE_OFF, 	1 	},
+	{ NULL,					CH6, 				MODE_OFF, 	1 	},
 };
 
-void ledSet(LED_TYPE type, uint8_t state)
+/* Шаблоны индикации по LED_MODE. Новый режим - новая строка таблицы. */
+const LedPattern ledPattern[] =
 {
-	if ( ledData[type].isMultiColor )
-	{
-		if (state)
-		{
-			ledLocal[1] = ( ledLocal[1] & ~(1 << ledData[type].pin ) ) | ( ( ( ledData[type].color >> 0 ) & 1 ) << ledData[type].pin );
-			ledLocal[2] = ( ledLocal[2] & ~(1 << ledData[type].pin ) ) | ( ( ( ledData[type].color >> 1 ) & 1 ) << ledData[type].pin );
-		}
-		else
-		{
-			ledLocal[1] |= (1 << ledData[type].pin);
-			ledLocal[2] |= (1 << ledData[type].pin);
-		}
-	}
-	else
-	{
-		HAL_GPIO_WritePin( ledData[type].port, ledData[type].pin, state);
-	}
+	[MODE_OFF]			= { LED_DISABLE,	{ 0 } },
+	[MODE_SINGLE]		= { LED_DISABLE,	{ 200, 1000 } },
+	[MODE_DOUBLE]		= { LED_DISABLE,	{ 200, 200, 200, 1000 } },
+	[MODE_TRIPLE]		= { LED_DISABLE,	{ 200, 200, 200, 200, 200, 1000 } },
+	[MODE_BLINK]		= { LED_DISABLE,	{ 200, 200 } },
+	[MODE_FLICK]		= { LED_DISABLE,	{ 50, 50 } },
+	[MODE_ON]			= { LED_ENABLE,		{ 0 } },
+	[MODE_HEARTBEAT]	= { LED_DISABLE,	{ 100, 150, 100, 650 } },
+	[MODE_QUADRUPLE]	= { LED_DISABLE,	{ 200, 200, 200, 200, 200, 200, 200, 1000 } },
+	[MODE_QUINTUPLE]	= { LED_DISABLE,	{ 200, 200, 200, 200, 200, 200, 200, 200, 200, 1000 } },
+	[MODE_SEXTUPLE]		= { LED_DISABLE,	{ 200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 1000 } },
 };
 
-void ledOff( LED_TYPE type )
-{
-	ledSet(type, LED_DISABLE);
-}
+/* Фаза шаблона каждого режима, мс от начала периода. Накапливается по прошедшему времени,
+ * а не берется остатком от HAL_GetTick, поэтому переполнение счетчика не сбивает мигание. */
+uint32_t ledPhase[sizeof(ledPattern) / sizeof(ledPattern[0])] = {};
+/* Время последнего продвижения фаз, мс. */
+uint32_t ledPhaseTick = 0;
 
-void ledSingle( LED_TYPE type )
+/**
+  * @brief  Продвижение фазы шаблона и его состояние в новой фазе.
+  * @param  pattern:	шаблон.
+  * @param  phase:		фаза шаблона, мс, продвигается по модулю периода.
+  * @param  elapsed:	время с прошлого продвижения, мс.
+  * @param  remain:		время до следующей смены состояния, мс (не меняется у шаблона без шагов).
+  * @retval LED_ENABLE / LED_DISABLE.
+  */
+uint8_t ledPatternState( const LedPattern* pattern, uint32_t* phase, uint32_t elapsed, uint32_t* remain )
 {
-	if( ledData[type].flag == 0 )
-	{
-		ledData[type].flag = 1;
-		ledData[type].startCounter = HAL_GetTick();
+	uint32_t period = 0;
+	uint32_t pos;
+	uint8_t i;
 
-		ledSet(type, LED_ENABLE);
-		ledData[type].secondCounter = HAL_GetTick() + 200;
+	for ( i = 0; ( i < LED_PATTERN_STEPS ) && pattern->step[i]; i++ )
+	{
+		period += pattern->step[i];
 	}
-	else
+	if ( !period )
 	{
-		if( ledData[type].secondCounter <= HAL_GetTick() )
-		{
-			if( ledData[type].flag == 1 )
-			{
-				ledData[type].flag = 2;
-				ledData[type].secondCounter += 1000;
-				ledSet(type, LED_DISABLE);
-			}
-			else if( ledData[type].flag == 2 )
-			{
-				ledData[type].flag = 0;
-			}
-		}
+		return pattern->state;
 	}
+
+	*phase = ( *phase + elapsed % period ) % period;
+	pos = *phase;
+	for ( i = 0; pos >= pattern->step[i]; i++ )
+	{
+		pos -= pattern->step[i];
+	}
+	*remain = pattern->step[i] - pos;
+	return ( i & 1 ) ? LED_DISABLE : LED_ENABLE;
 }
 
-void ledDouble( LED_TYPE type )
+void ledInit(void)
 {
-	if( ledData[type].flag == 0 )
+	/* Перенести из GPIO */
+	if ( HAL_I2C_IsDeviceReady( &hi2c1, XL9535_I2C_ADDRESS, 1, 100) == HAL_OK )
 	{
-		ledData[type].flag = 1;
-		ledData[type].startCounter = HAL_GetTick();
-
-		ledSet(type, LED_ENABLE);
-		ledData[type].secondCounter = HAL_GetTick() + 200;
+		uint8_t configurationData[] = {0b00000110, 0b00000000, 0b00000000};
+		HAL_I2C_Master_Transmit(&hi2c1, XL9535_I2C_ADDRESS, configurationData, sizeof(configurationData), 100);
 	}
 	else
 	{
-		if( ledData[type].secondCounter <= HAL_GetTick() )
-		{
-			if( ledData[type].flag == 1 )
-			{
-				ledData[type].flag = 2;
-				ledData[type].secondCounter += 200;
-				ledSet(type, LED_DISABLE);
-			}
-			else if( ledData[type].flag == 2 )
-			{
-				ledData[type].flag = 3;
-				ledData[type].secondCounter += 200;
-				ledSet(type, LED_ENABLE);
-			}
-			else if( ledData[type].flag == 3 )
-			{
-				ledData[type].flag = 4;
-				ledData[type].secondCounter += 1000;
-				ledSet(type, LED_DISABLE);
-			}
-			else if( ledData[type].flag == 4 )
-			{
-				ledData[type].flag = 0;
-			}
-		}
+		/* TODO: FAULT РАСШИРИТЕЛЬ ПОРТОВ НЕ НАЙДЕН */
 	}
 }
 
-void ledTriple( LED_TYPE type )
+void ledProcess(void)
 {
-	if( ledData[type].flag == 0 )
-	{
-		ledData[type].flag = 1;
-		ledData[type].startCounter = HAL_GetTick();
+	PROF_BEGIN( PROF_LED_PROCESS );
 
-		ledSet(type, LED_ENABLE);
-		ledData[type].secondCounter = HAL_GetTick() + 200;
-	}
-	else
+	uint32_t now = HAL_GetTick();
+
+	/* До ближайшей смены состояния или смены режима диоды не перебираются */
+	if ( ledDirtyMask || ( (int32_t)( now - ledDeadline ) >= 0 ) )
 	{
-		if(ledData[type].secondCounter <= HAL_GetTick())
+		/* Включенные режимы, бит на LED_MODE */
+		uint16_t modeOnMask = 0;
+		/* Используемые режимы, бит на LED_MODE */
+		uint16_t modeUsedMask = 0;
+		uint16_t onMask = 0;
+		uint8_t port[2] = {0, 0};
+		/* Разность беззнаковая, корректна и при переполнении HAL_GetTick */
+		uint32_t elapsed = now - ledPhaseTick;
+
+		ledPhaseTick = now;
+
+		/* Если шаблонов с шагами нет - следующая проверка через секунду */
+		ledDeadline = now + 1000;
+		ledDirtyMask = 0;
+
+		for ( uint8_t type = 0; type < ( sizeof(ledData) / sizeof(ledData[0]) ); type++ )
 		{
-			if( ledData[type].flag == 1 )
-			{
-				ledData[type].flag = 2;
-				ledData[type].secondCounter += 200;
-				ledSet(type, LED_DISABLE);
-			}
-			else if( ledData[type].flag == 2 )
-			{
-				ledData[type].flag = 3;
-				ledData[type].secondCounter += 200;
-				ledSet(type, LED_ENABLE);
-			}
-			else if( ledData[type].flag == 3 )
+			modeUsedMask |= 1 << ledData[type].mode;
+		}
+		/* Фазы продвигаются у всех режимов, состояние нужно только используемым */
+		for ( uint8_t mode = 0; mode < ( sizeof(ledPattern) / sizeof(ledPattern[0]) ); mode++ )
+		{
+			uint32_t remain = 1000;
+
+			if ( ledPatternState( &ledPattern[mode], &ledPhase[mode], elapsed, &remain ) )
 			{
-				ledData[type].flag = 4;
-				ledData[type].secondCounter += 200;
-				ledSet(type, LED_DISABLE);
+				modeOnMask |= 1 << mode;
 			}
-			else if( ledData[type].flag == 4 )
+			if ( ( modeUsedMask & ( 1 << mode ) ) && ( (int32_t)( now + remain - ledDeadline ) < 0 ) )
 			{
-				ledData[type].flag = 5;
-				ledData[type].secondCounter += 200;
-				ledSet(type, LED_ENABLE);
+				ledDeadline = now + remain;
 			}
-			else if( ledData[type].flag == 5 )
+		}
+
+		/* Байты выходного порта собираются заново, GPIO пишутся только при изменении */
+		for ( uint8_t type = 0; type < ( sizeof(ledData) / sizeof(ledData[0]) ); type++ )
+		{
+			LedData* led = &ledData[type];
+			uint8_t state = ( modeOnMask >> led->mode ) & 1;
+
+			onMask |= state << type;
+			if ( led->isMultiColor )
 			{
-				ledData[type].flag = 6;
-				ledData[type].secondCounter += 1000;
-				ledSet(type, LED_DISABLE);
+				uint8_t color = state ? led->color : COLOR_NONE;
+
+				port[0] |= ( ( color >> 0 ) & 1 ) << led->pin;
+				port[1] |= ( ( color >> 1 ) & 1 ) << led->pin;
 			}
-			else if( ledData[type].flag == 6 )
+			else
+			if ( ( onMask ^ ledOnMask ) & ( 1 << type ) )
 			{
-				ledData[type].flag = 0;
+				HAL_GPIO_WritePin( led->port, led->pin, state );
 			}
 		}
+		ledOnMask = onMask;
+		ledLocal[1] = port[0];
+		ledLocal[2] = port[1];
 	}
-}
 
-void ledBlink( LED_TYPE type )
-{
-	if( ledData[type].flag == 0 )
+	/* Передача завершена - фиксируем подтвержденное состояние, при ошибке передаем заново */
+	if ( ledTxState == LED_TX_DONE )
 	{
-		ledData[type].flag = 1;
-		ledData[type].startCounter = HAL_GetTick();
-
-		ledSet(type, LED_ENABLE);
-		ledData[type].secondCounter = HAL_GetTick() + 200;
+		memcpy(ledAck, ledI2C, sizeof(ledAck));
+		isLedAckValid = 1;
+		ledTxState = LED_TX_IDLE;
 	}
 	else
+	if ( ledTxState == LED_TX_ERROR )
 	{
-		if(ledData[type].secondCounter <= HAL_GetTick())
-		{
-			if( ledData[type].secondCounter <= HAL_GetTick() )
-			{
-				if( ledData[type].flag == 1 )
-				{
-					ledData[type].flag = 2;
-					ledData[type].secondCounter += 200;
-					ledSet(type, LED_DISABLE);
-				}
-				else if( ledData[type].flag == 2 )
-				{
-					ledData[type].flag = 0;
-				}
-			}
-		}
+		isLedAckValid = 0;
+		ledTxState = LED_TX_IDLE;
 	}
-}
 
-void ledFlick( LED_TYPE type )
-{
-	if( ledData[type].flag == 0 )
-	{
-		ledData[type].flag = 1;
-		ledData[type].startCounter = HAL_GetTick();
-
-		ledSet(type, LED_ENABLE);
-		ledData[type].secondCounter = HAL_GetTick() + 50;
-	}
-	else
+	/* Передаем только изменения и не чаще LED_DELAY_TRANSMIT, изменения за интервал уходят одной передачей */
+	if ( ( ledTxState == LED_TX_IDLE )
+			&& ( !isLedAckValid || memcmp(ledAck, ledLocal, sizeof(ledAck)) )
+			&& ( ( now - ledTxTick ) >= LED_DELAY_TRANSMIT )
+			&& ( HAL_I2C_GetState( &hi2c1 ) == HAL_I2C_STATE_READY ) )
 	{
-		if(ledData[type].secondCounter <= HAL_GetTick())
+		ledTxTick = now;
+		memcpy(ledI2C, ledLocal, sizeof(ledI2C));
+		ledTxState = LED_TX_BUSY;
+		if ( HAL_I2C_Master_Transmit_DMA( &hi2c1, XL9535_I2C_ADDRESS, ledI2C, sizeof(ledI2C) ) == HAL_OK )
 		{
-			if( ledData[type].secondCounter <= HAL_GetTick() )
-			{
-				if( ledData[type].flag == 1 )
-				{
-					ledData[type].flag = 2;
-					ledData[type].secondCounter += 50;
-					ledSet(type, LED_DISABLE);
-				}
-				else if( ledData[type].flag == 2 )
-				{
-					ledData[type].flag = 0;
-				}
-			}
+			ledTxCnt++;
+		}
+		else
+		{
+			ledTxState = LED_TX_IDLE;
 		}
 	}
+	PROF_END( PROF_LED_PROCESS );
 }
 
-void ledOn( LED_TYPE type )
+void setLedMode( LED_TYPE type, LED_MODE mode, LED_COLOR color )
 {
-	ledSet(type, LED_ENABLE);
-}
+	LedData* led = &ledData[type];
 
-void ledInit(void)
-{
-	/* Перенести из GPIO */
-	if ( HAL_I2C_IsDeviceReady( &hi2c1, XL9535_I2C_ADDRESS, 1, 100) == HAL_OK )
+	if ( mode >= ( sizeof(ledPattern) / sizeof(ledPattern[0]) ) )
 	{
-		uint8_t configurationData[] = {0b00000110, 0b00000000, 0b00000000};
-		HAL_I2C_Master_Transmit(&hi2c1, XL9535_I2C_ADDRESS, configurationData, sizeof(configurationData), 100);
+		return;
 	}
-	else
+	/* Тот же режим и цвет - ничего не меняем, фаза шаблона сохраняется */
+	if ( ( led->mode == mode ) && ( !led->isMultiColor || ( led->color == color ) ) )
 	{
-		/* TODO: FAULT РАСШИРИТЕЛЬ ПОРТОВ НЕ НАЙДЕН */
+		return;
 	}
-}
 
-void ledProcess(void)
-{
-	if( ledData[LED_STAT].ledFunction != NULL ) { ledData[LED_STAT].ledFunction(LED_STAT); }
-	if( ledData[LED_RUN].ledFunction != NULL ) { ledData[LED_RUN].ledFunction(LED_RUN); }
-	if( ledData[LED_ALRM].ledFunction != NULL ) { ledData[LED_ALRM].ledFunction(LED_ALRM); }
-
-	if( ledData[LED_CH1].ledFunction != NULL ) { ledData[LED_CH1].ledFunction(LED_CH1); }
-	if( ledData[LED_CH2].ledFunction != NULL ) { ledData[LED_CH2].ledFunction(LED_CH2); }
-	if( ledData[LED_CH3].ledFunction != NULL ) { ledData[LED_CH3].ledFunction(LED_CH3); }
-	if( ledData[LED_CH4].ledFunction != NULL ) { ledData[LED_CH4].ledFunction(LED_CH4); }
-	if( ledData[LED_CH5].ledFunction != NULL ) { ledData[LED_CH5].ledFunction(LED_CH5); }
-	if( ledData[LED_CH6].ledFunction != NULL ) { ledData[LED_CH6].ledFunction(LED_CH6); }
-
-	if ( ( HAL_GetTick() - LED_DELAY_TRANSMIT ) > delayCnt )
+	led->mode = mode;
+	if ( led->isMultiColor )
 	{
-		delayCnt = HAL_GetTick();
-		memcpy(ledI2C, ledLocal, sizeof(ledI2C));
-		HAL_I2C_Master_Transmit_DMA( &hi2c1, XL9535_I2C_ADDRESS, ledI2C, sizeof(ledI2C) );
+		led->color = color;
 	}
+	/* Новое состояние применяется на ближайшем ledProcess */
+	ledDirtyMask |= 1 << type;
 }
 
-void setLedMode( LED_TYPE type, LED_MODE mode, LED_COLOR color )
+/**
+  * @brief  Кол-во запущенных передач на расширитель портов.
+  */
+uint32_t ledGetTxCount( void )
 {
-	ledData[type].mode = mode;
-	ledData[type].flag = 0;
+	return ledTxCnt;
+}
 
-	if ( ledData[type].isMultiColor )
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	if ( hi2c == &hi2c1 )
 	{
-		ledData[type].color = color;
+		ledTxState = LED_TX_DONE;
 	}
+}
 
-	if( mode == MODE_OFF )
-	{ ledData[type].ledFunction = ledOff; }
-	else if( mode == MODE_SINGLE )
-	{ ledData[type].ledFunction = ledSingle; }
-	else if( mode == MODE_DOUBLE )
-	{ ledData[type].ledFunction = ledDouble; }
-	else if( mode == MODE_TRIPLE )
-	{ ledData[type].ledFunction = ledTriple; }
-	else if( mode == MODE_BLINK )
-	{ ledData[type].ledFunction = ledBlink; }
-	else if( mode == MODE_FLICK )
-	{ ledData[type].ledFunction = ledFlick; }
-	else if( mode == MODE_ON )
-	{ ledData[type].ledFunction = ledOn; }
-
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	if ( hi2c == &hi2c1 )
+	{
+		ledTxState = LED_TX_ERROR;
+	}
 }
@@ -0,0 +1,107 @@
+#include "prof.h"
+
+#if PROF_ENABLE
+
+#include "string.h"
+#include "sched.h"
+
+/* ________________________ FUNCTION'S PROTOTYPE ________________________ */
+uint8_t* profPutU32( uint8_t* buff, uint32_t value );
+
+/* ________________________ INIT STRUCT ________________________ */
+ProfStat profStat[PROF_NUM] = {};
+
+/**
+  * @brief  Инициализация: запуск счетчика тактов DWT и сброс статистики.
+  */
+void profInit( void )
+{
+	schedCounterInit();
+	profReset();
+}
+
+/**
+  * @brief  Сброс статистики всех участков.
+  */
+void profReset( void )
+{
+	memset( profStat, 0, sizeof(profStat) );
+	for ( uint8_t id = 0; id < PROF_NUM; id++ )
+	{
+		profStat[id].min = UINT32_MAX;
+	}
+}
+
+/**
+  * @brief  Добавление замера участка.
+  * @param  id:			участок.
+  * @param  time:		время выполнения.
+  */
+void profAdd( PROF_ID id, uint32_t time )
+{
+	ProfStat* stat = &profStat[id];
+
+	stat->count++;
+	stat->sum += time;
+	if ( time < stat->min )
+	{
+		stat->min = time;
+	}
+	if ( time > stat->max )
+	{
+		stat->max = time;
+	}
+}
+
+/**
+  * @brief  Статистика участка.
+  * @param  id:			участок.
+  * @param  stat:		копия статистики.
+  * @retval 1 - статистика скопирована, 0 - неверный участок.
+  */
+uint8_t profGet( PROF_ID id, ProfStat* stat )
+{
+	if ( id >= PROF_NUM )
+	{
+		return 0;
+	}
+	*stat = profStat[id];
+	return 1;
+}
+
+/**
+  * @brief  Дамп таблицы для чтения по CAN: по PROF_DUMP_RECORD_SIZE байт на участок
+  *         (кол-во, минимум, максимум, среднее). Участки без замеров - нули.
+  * @param  buff:		буфер дампа.
+  * @param  size:		размер буфера, не поместившиеся участки не пишутся.
+  * @retval кол-во записанных байт.
+  */
+uint16_t profDump( uint8_t* buff, uint16_t size )
+{
+	uint8_t* pos = buff;
+
+	for ( uint8_t id = 0; ( id < PROF_NUM ) && ( ( pos - buff + PROF_DUMP_RECORD_SIZE ) <= size ); id++ )
+	{
+		ProfStat* stat = &profStat[id];
+
+		pos = profPutU32( pos, stat->count );
+		pos = profPutU32( pos, stat->count ? stat->min : 0 );
+		pos = profPutU32( pos, stat->max );
+		pos = profPutU32( pos, stat->count ? (uint32_t)( stat->sum / stat->count ) : 0 );
+	}
+	return pos - buff;
+}
+
+/**
+  * @brief  Запись uint32_t младшим байтом вперед.
+  */
+uint8_t* profPutU32( uint8_t* buff, uint32_t value )
+{
+	buff[0] = value;
+	buff[1] = value >> 8;
+	buff[2] = value >> 16;
+	buff[3] = value >> 24;
+	return buff + 4;
+}
+
+#endif /* PROF_ENABLE */
@@ -0,0 +1,218 @@
+#include "sched.h"
+
+#include "main.h"
+#include "setting.h"
+#include "string.h"
+#if !defined( __arm__ )
+#include <time.h>
+#endif
+
+#include "ai.h"
+#include "hart.h"
+#include "led.h"
+#include "prof.h"
+
+/* ________________________ STRUCT ________________________ */
+/* Описание задачи. */
+typedef struct SchedTask
+{
+	/* Функция задачи. */
+	void ( *process )( void );
+	/* Период запуска, мс. */
+	uint32_t period;
+	/* Бюджет времени выполнения, мкс. */
+	uint32_t budget;
+} SchedTask;
+
+/* Состояние задачи. */
+typedef struct SchedData
+{
+	/* Статистика выполнения. */
+	SchedStat stat;
+	/* Время последнего запуска по периоду, мс. */
+	uint32_t tick;
+	/* Флаг события, выставляется из прерываний. */
+	volatile uint8_t isTriggered;
+} SchedData;
+
+/* ________________________ FUNCTION'S PROTOTYPE ________________________ */
+uint8_t schedIsReady( SCHED_TASK task );
+uint32_t schedCycles( void );
+
+/* ________________________ INIT STRUCT ________________________ */
+/* Таблица задач в порядке приоритета. */
+const SchedTask schedTask[SCHED_TASK_NUM] =
+{
+	{ aiProcess,	SCHED_PERIOD_AI,	SCHED_BUDGET_AI },
+	{ hartProcess,	SCHED_PERIOD_HART,	SCHED_BUDGET_HART },
+	{ ledProcess,	SCHED_PERIOD_LED,	SCHED_BUDGET_LED },
+};
+
+SchedData schedData[SCHED_TASK_NUM] = {};
+
+/* Тактов счетчика времени в мкс. */
+uint32_t schedCyclesPerUs = 0;
+/* Время выполнения задач в текущем окне подсчета загрузки, такты. */
+uint64_t schedBusyCycles = 0;
+/* Начало окна подсчета загрузки, мс. */
+uint32_t schedLoadTick = 0;
+/* Загрузка процессора задачами за последнее окно, десятые доли процента. */
+uint16_t schedLoad = 0;
+
+/**
+  * @brief  Инициализация планировщика: запуск счетчика тактов DWT и перевод бюджетов в такты.
+  *         При сборке на хосте время считается в нс.
+  */
+void schedInit( void )
+{
+	schedCounterInit();
+#if defined( __arm__ )
+	schedCyclesPerUs = SystemCoreClock / 1000000;
+	DWT->CYCCNT = 0;
+#else
+	schedCyclesPerUs = 1000;
+#endif
+	profInit();
+	schedBusyCycles = 0;
+	schedLoadTick = HAL_GetTick();
+
+	for ( uint8_t task = 0; task < SCHED_TASK_NUM; task++ )
+	{
+		memset( &schedData[task].stat, 0, sizeof(SchedStat) );
+		schedData[task].stat.budgetCycles = schedCyclesPerUs * schedTask[task].budget;
+		schedData[task].tick = HAL_GetTick();
+		schedData[task].isTriggered = 1;
+	}
+}
+
+/**
+  * @brief  Запуск счетчика тактов DWT. Общий для планировщика и профилировщика,
+  *         значение счетчика не сбрасывает. На хосте ничего не делает.
+  */
+void schedCounterInit( void )
+{
+#if defined( __arm__ )
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+/**
+  * @brief  Один проход планировщика: запускается одна готовая задача с самым высоким приоритетом.
+  *         После каждой задачи готовность проверяется заново с начала таблицы, поэтому между
+  *         любыми двумя задачами ниже AI проверяется готовность AI.
+  */
+void schedRun( void )
+{
+	uint32_t start;
+	uint32_t cycles;
+	uint32_t tick = HAL_GetTick();
+
+	/* Загрузка - доля времени окна, занятая задачами. */
+	if ( ( tick - schedLoadTick ) >= SCHED_LOAD_WINDOW )
+	{
+		schedLoad = schedBusyCycles * 1000 / ( (uint64_t)( tick - schedLoadTick ) * 1000 * schedCyclesPerUs );
+		schedBusyCycles = 0;
+		schedLoadTick = tick;
+	}
+
+	for ( uint8_t task = 0; task < SCHED_TASK_NUM; task++ )
+	{
+		if ( !schedIsReady( task ) )
+		{
+			continue;
+		}
+
+		start = schedCycles();
+		schedTask[task].process();
+		cycles = schedCycles() - start;
+
+		schedBusyCycles += cycles;
+		schedData[task].stat.runCnt++;
+		schedData[task].stat.lastCycles = cycles;
+		if ( cycles > schedData[task].stat.maxCycles )
+		{
+			schedData[task].stat.maxCycles = cycles;
+		}
+		if ( cycles > schedData[task].stat.budgetCycles )
+		{
+			schedData[task].stat.overrunCnt++;
+		}
+		return;
+	}
+}
+
+/**
+  * @brief  Запуск задачи по событию (вызывается из прерываний).
+  */
+void schedTrigger( SCHED_TASK task )
+{
+	schedData[task].isTriggered = 1;
+}
+
+/**
+  * @brief  Статистика выполнения задачи.
+  * @param  task:		задача.
+  * @param  stat:		копия статистики.
+  * @retval 1 - статистика скопирована, 0 - неверный номер задачи.
+  */
+uint8_t schedGetStat( SCHED_TASK task, SchedStat* stat )
+{
+	if ( task >= SCHED_TASK_NUM )
+	{
+		return 0;
+	}
+	*stat = schedData[task].stat;
+	return 1;
+}
+
+/**
+  * @brief  Загрузка процессора задачами за последнее окно SCHED_LOAD_WINDOW, десятые доли процента.
+  */
+uint16_t schedGetLoad( void )
+{
+	return schedLoad;
+}
+
+/**
+  * @brief  Проверка готовности задачи: пришло событие или прошел период.
+  *         Флаг события сбрасывается до запуска, событие во время выполнения не теряется.
+  */
+uint8_t schedIsReady( SCHED_TASK task )
+{
+	SchedData* data = &schedData[task];
+	uint32_t tick = HAL_GetTick();
+
+	if ( ( tick - data->tick ) >= schedTask[task].period )
+	{
+		/* Отставание больше периода не накапливается. */
+		data->tick += schedTask[task].period;
+		if ( ( tick - data->tick ) >= schedTask[task].period )
+		{
+			data->tick = tick;
+		}
+		data->isTriggered = 0;
+		return 1;
+	}
+	if ( data->isTriggered )
+	{
+		data->isTriggered = 0;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+  * @brief  Счетчик времени: такты DWT на устройстве, нс на хосте.
+  */
+uint32_t schedCycles( void )
+{
+#if defined( __arm__ )
+	return DWT->CYCCNT;
+#else
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint32_t)( ts.tv_sec * 1000000000ULL + ts.tv_nsec );
+#endif
+}